@@ -0,0 +1,358 @@
+/* =============================================================
+ * micro.c - Microbenchmarks por kernel (ns/byte y ciclos/byte)
+ * -------------------------------------------------------------
+ * Mide cada kernel aislado, sin pipeline ni hilos, para saber si
+ * un cambio en un bucle caliente realmente ayudó:
+ *   rle_var, lzw (con y sin contexto), huffman+pred, predictor SUB,
+ *   delta16, vigenère y AES (si hay OpenSSL).
+ * - Se fija el proceso a un núcleo (sched_setaffinity, --cpu).
+ * - Tamaños de 4 KB a --max-mb (potencias de 4).
+ * - Cada medición se repite hasta sumar --min-ms (mínimo 3 veces)
+ *   y se reporta la mejor: es la menos contaminada por ruido.
+ * - Ciclos: contador TSC (rdtsc) en x86, que cuenta ciclos de
+ *   referencia a frecuencia constante; en otras arquitecturas solo
+ *   se reporta ns/byte.
+ * La preparación (ej: comprimir antes de medir la descompresión)
+ * queda fuera de la medición.
+ * Se compila con -O2 y sin sanitizers: make micro.
+ * ============================================================= */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "rle_var.h"
+#include "lzw.h"
+#include "huffman_predictor.h"
+#include "vigenere.h"
+#include "aes_simple.h"
+#include "codec.h"
+#include <getopt.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+static uint64_t cycles_now(void) { return __rdtsc(); }
+#else
+#define HAVE_TSC 0
+static uint64_t cycles_now(void) { return 0; }
+#endif
+
+#define MICRO_KEY "micro-bench-key"
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* ---------- Datos de entrada ---------- */
+
+/* Texto tipo log determinista (LCG), compresible pero no trivial */
+static void fill_text(uint8_t* b, size_t n) {
+    static const char* const W[] = { "INFO ", "WARN ", "request ", "id=", "latency ",
+                                     "ms ", "user ", "GET ", "/api/v1/", "ok\n",
+                                     "error ", "cache ", "hit ", "miss ", "0", "1" };
+    uint32_t s = 12345;
+    size_t i = 0;
+    while (i < n) {
+        s = s * 1103515245u + 12345u;
+        const char* w = W[(s >> 16) & 15];
+        for (size_t k = 0; w[k] && i < n; k++) b[i++] = (uint8_t)w[k];
+    }
+}
+
+/* Repite el archivo -i hasta llenar n bytes */
+static int fill_file(uint8_t* b, size_t n, const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return -1;
+    size_t got = fread(b, 1, n, f);
+    fclose(f);
+    if (got == 0) return -1;
+    for (size_t i = got; i < n; i++) b[i] = b[i - got];
+    return 0;
+}
+
+/* ---------- Kernels ---------- */
+typedef struct {
+    const uint8_t* src;   /* entrada original (no se modifica) */
+    size_t n;
+    uint8_t* work;        /* copia para kernels en el lugar */
+    uint8_t* aux;         /* entrada preparada (ej: datos comprimidos) */
+    size_t aux_len;
+    lzw_ctx* lzw;
+    hp_ctx* hp;
+} Fixture;
+
+typedef int (*comp_fn)(const uint8_t*, size_t, uint8_t**, size_t*);
+
+/* Prepara aux = comp(src) para medir la descompresión */
+static int prep_with(Fixture* f, comp_fn comp) {
+    return comp(f->src, f->n, &f->aux, &f->aux_len);
+}
+static int prep_rle(Fixture* f)  { return prep_with(f, rle_var_compress); }
+static int prep_lzw(Fixture* f)  { return prep_with(f, lzw_compress); }
+static int prep_hp(Fixture* f)   { return prep_with(f, hp_compress_buffer); }
+static int prep_aes(Fixture* f) {
+    return aes_encrypt_buffer(f->src, f->n, MICRO_KEY, &f->aux, &f->aux_len);
+}
+static int prep_ctx(Fixture* f) {
+    f->lzw = lzw_ctx_create();
+    return f->lzw ? 0 : -1;
+}
+static int prep_lzw_ctx(Fixture* f) {
+    return (prep_ctx(f) == 0 && prep_lzw(f) == 0) ? 0 : -1;
+}
+static int prep_hp_ctx(Fixture* f) {
+    f->hp = hp_ctx_create();
+    return f->hp ? 0 : -1;
+}
+static int prep_hp_dctx(Fixture* f) {
+    return (prep_hp_ctx(f) == 0 && prep_hp(f) == 0) ? 0 : -1;
+}
+
+/* Ejecuta fn y libera su salida */
+static int run_out(comp_fn fn, const uint8_t* in, size_t n) {
+    uint8_t* out = NULL;
+    size_t out_len = 0;
+    int rc = fn(in, n, &out, &out_len);
+    free(out);
+    return rc;
+}
+
+static int k_rle_c(Fixture* f)  { return run_out(rle_var_compress, f->src, f->n); }
+static int k_rle_d(Fixture* f)  { return run_out(rle_var_decompress, f->aux, f->aux_len); }
+static int k_lzw_c(Fixture* f)  { return run_out(lzw_compress, f->src, f->n); }
+static int k_lzw_d(Fixture* f)  { return run_out(lzw_decompress, f->aux, f->aux_len); }
+static int k_hp_c(Fixture* f)   { return run_out(hp_compress_buffer, f->src, f->n); }
+static int k_hp_d(Fixture* f)   { return run_out(hp_decompress_buffer, f->aux, f->aux_len); }
+
+static int k_lzw_ctx(Fixture* f) {
+    uint8_t* out = NULL;
+    size_t out_len = 0;
+    int rc = lzw_compress_ctx(f->lzw, f->src, f->n, &out, &out_len);
+    free(out);
+    return rc;
+}
+static int k_lzw_dctx(Fixture* f) {
+    uint8_t* out = NULL;
+    size_t out_len = 0;
+    int rc = lzw_decompress_ctx(f->lzw, f->aux, f->aux_len, &out, &out_len);
+    free(out);
+    return rc;
+}
+static int k_hp_ctx(Fixture* f) {
+    uint8_t* out = NULL;
+    size_t out_len = 0;
+    int rc = hp_compress_ctx(f->hp, f->src, f->n, &out, &out_len);
+    free(out);
+    return rc;
+}
+static int k_hp_dctx(Fixture* f) {
+    uint8_t* out = NULL;
+    size_t out_len = 0;
+    int rc = hp_decompress_ctx(f->hp, f->aux, f->aux_len, &out, &out_len);
+    free(out);
+    return rc;
+}
+
+/* En el lugar sobre la copia de trabajo (una sola fila de n bytes) */
+static int k_sub_f(Fixture* f) { codec_sub_forward(f->work, (int)f->n, 1, 1); return 0; }
+static int k_sub_i(Fixture* f) { codec_sub_inverse(f->work, (int)f->n, 1, 1); return 0; }
+static int k_d16_f(Fixture* f) { codec_delta16_forward((int16_t*)f->work, f->n / 4, 2); return 0; }
+static int k_d16_i(Fixture* f) { codec_delta16_inverse((int16_t*)f->work, f->n / 4, 2); return 0; }
+static int k_vig_e(Fixture* f) {
+    vigenere_encrypt(f->work, f->n, (const uint8_t*)MICRO_KEY, strlen(MICRO_KEY));
+    return 0;
+}
+static int k_vig_d(Fixture* f) {
+    vigenere_decrypt(f->work, f->n, (const uint8_t*)MICRO_KEY, strlen(MICRO_KEY));
+    return 0;
+}
+static int k_aes_e(Fixture* f) {
+    uint8_t* out = NULL;
+    size_t out_len = 0;
+    int rc = aes_encrypt_buffer(f->src, f->n, MICRO_KEY, &out, &out_len);
+    free(out);
+    return rc;
+}
+static int k_aes_d(Fixture* f) {
+    uint8_t* out = NULL;
+    size_t out_len = 0;
+    int rc = aes_decrypt_buffer(f->aux, f->aux_len, MICRO_KEY, &out, &out_len);
+    free(out);
+    return rc;
+}
+
+typedef struct {
+    const char* name;
+    int (*prep)(Fixture*);   /* opcional */
+    int (*run)(Fixture*);
+} Kernel;
+
+static const Kernel KERNELS[] = {
+    { "rle_var_compress",     NULL,         k_rle_c    },
+    { "rle_var_decompress",   prep_rle,     k_rle_d    },
+    { "lzw_compress",         NULL,         k_lzw_c    },
+    { "lzw_compress_ctx",     prep_ctx,     k_lzw_ctx  },
+    { "lzw_decompress",       prep_lzw,     k_lzw_d    },
+    { "lzw_decompress_ctx",   prep_lzw_ctx, k_lzw_dctx },
+    { "hp_compress_buffer",   NULL,         k_hp_c     },
+    { "hp_compress_ctx",      prep_hp_ctx,  k_hp_ctx   },
+    { "hp_decompress_buffer", prep_hp,      k_hp_d     },
+    { "hp_decompress_ctx",    prep_hp_dctx, k_hp_dctx  },
+    { "predictor_sub",        NULL,         k_sub_f    },
+    { "predictor_unsub",      NULL,         k_sub_i    },
+    { "delta16_forward",      NULL,         k_d16_f    },
+    { "delta16_inverse",      NULL,         k_d16_i    },
+    { "vigenere_encrypt",     NULL,         k_vig_e    },
+    { "vigenere_decrypt",     NULL,         k_vig_d    },
+#ifndef NO_OPENSSL
+    { "aes_encrypt",          NULL,         k_aes_e    },
+    { "aes_decrypt",          prep_aes,     k_aes_d    },
+#endif
+};
+#define N_KERNELS (sizeof(KERNELS) / sizeof(KERNELS[0]))
+
+/* ¿name aparece en la lista separada por comas? (NULL = todos) */
+static int selected(const char* list, const char* name) {
+    if (!list) return 1;
+    size_t n = strlen(name);
+    for (const char* p = list; *p; ) {
+        const char* end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len == n && strncmp(p, name, n) == 0) return 1;
+        if (!end) break;
+        p = end + 1;
+    }
+    return 0;
+}
+
+/* Fija el proceso a 'cpu' (-1 = primer CPU permitido). Devuelve el CPU usado. */
+static int pin_cpu(int cpu) {
+    cpu_set_t set;
+    if (cpu < 0) {
+        if (sched_getaffinity(0, sizeof(set), &set) != 0) return -1;
+        for (int i = 0; i < CPU_SETSIZE; i++) if (CPU_ISSET(i, &set)) { cpu = i; break; }
+        if (cpu < 0) return -1;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0 ? cpu : -1;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+        "Uso: bench/micro [opciones]\n"
+        "  --kernel L     kernels separados por comas (default: todos)\n"
+        "  --max-mb N     tamaño máximo de entrada (default 16, hasta 256)\n"
+        "  --min-ms N     tiempo mínimo de medición por punto (default 200)\n"
+        "  --cpu N        núcleo donde fijar el proceso (default: el primero permitido)\n"
+        "  -i archivo     datos de entrada (se repiten); default: texto tipo log\n"
+        "  --list         lista los kernels\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* only = NULL;
+    const char* input = NULL;
+    long max_mb = 16, min_ms = 200;
+    int cpu = -1;
+
+    static struct option long_opts[] = {
+        {"kernel", required_argument, 0, 1},
+        {"max-mb", required_argument, 0, 2},
+        {"min-ms", required_argument, 0, 3},
+        {"cpu",    required_argument, 0, 4},
+        {"list",   no_argument,       0, 5},
+        {0,0,0,0}
+    };
+    int opt, idx = 0;
+    while ((opt = getopt_long(argc, argv, "i:", long_opts, &idx)) != -1) {
+        switch (opt) {
+            case 'i': input = optarg; break;
+            case 1: only = optarg; break;
+            case 2: max_mb = atol(optarg); break;
+            case 3: min_ms = atol(optarg); break;
+            case 4: cpu = atoi(optarg); break;
+            case 5:
+                for (size_t k = 0; k < N_KERNELS; k++) printf("%s\n", KERNELS[k].name);
+                return 0;
+            default: usage(); return 1;
+        }
+    }
+    if (max_mb < 1 || max_mb > 256 || min_ms < 1) { usage(); return 1; }
+
+    int pinned = pin_cpu(cpu);
+    if (pinned < 0) fprintf(stderr, "Aviso: no se pudo fijar el proceso a un núcleo\n");
+
+    size_t max_bytes = (size_t)max_mb * 1024 * 1024;
+    uint8_t* data = malloc(max_bytes);
+    uint8_t* work = malloc(max_bytes);
+    if (!data || !work) { fprintf(stderr, "Sin memoria\n"); return 1; }
+    if (input) {
+        if (fill_file(data, max_bytes, input) != 0) { fprintf(stderr, "No se pudo leer %s\n", input); return 1; }
+    } else {
+        fill_text(data, max_bytes);
+    }
+
+    printf("CPU fijado: %d  ciclos: %s  min-ms: %ld  datos: %s\n\n",
+           pinned, HAVE_TSC ? "rdtsc (referencia)" : "n/d", min_ms, input ? input : "texto sintético");
+    printf("%-22s %10s %8s %10s %10s %10s\n", "kernel", "bytes", "iters", "ns/byte", "cyc/byte", "MB/s");
+    printf("--------------------------------------------------------------------------\n");
+
+    int failed = 0;
+    for (size_t k = 0; k < N_KERNELS; k++) {
+        const Kernel* K = &KERNELS[k];
+        if (!selected(only, K->name)) continue;
+
+        for (size_t n = 4096; n <= max_bytes; n *= 4) {
+            Fixture f = { .src = data, .n = n, .work = work };
+            memcpy(work, data, n);
+            if (K->prep && K->prep(&f) != 0) {
+                printf("%-22s %10zu  (preparación falló)\n", K->name, n);
+                failed = 1;
+                free(f.aux);
+                lzw_ctx_destroy(f.lzw);
+                hp_ctx_destroy(f.hp);
+                continue;
+            }
+
+            /* una corrida de calentamiento (caches, páginas, tablas) */
+            if (K->run(&f) != 0) failed = 1;
+
+            uint64_t best_ns = UINT64_MAX, best_cyc = UINT64_MAX, total = 0;
+            long iters = 0;
+            while (iters < 3 || (total < (uint64_t)min_ms * 1000000ull && iters < 100000)) {
+                uint64_t c0 = cycles_now(), t0 = now_ns();
+                if (K->run(&f) != 0) failed = 1;
+                uint64_t t1 = now_ns(), c1 = cycles_now();
+                uint64_t dt = t1 - t0;
+                if (dt < best_ns) best_ns = dt;
+                if (c1 - c0 < best_cyc) best_cyc = c1 - c0;
+                total += dt;
+                iters++;
+            }
+
+            double nspb = (double)best_ns / (double)n;
+            double mbs = best_ns ? ((double)n / (1024.0 * 1024.0)) / ((double)best_ns / 1e9) : 0.0;
+            if (HAVE_TSC)
+                printf("%-22s %10zu %8ld %10.3f %10.3f %10.1f\n", K->name, n, iters, nspb,
+                       (double)best_cyc / (double)n, mbs);
+            else
+                printf("%-22s %10zu %8ld %10.3f %10s %10.1f\n", K->name, n, iters, nspb, "-", mbs);
+            fflush(stdout);
+
+            free(f.aux);
+            lzw_ctx_destroy(f.lzw);
+            hp_ctx_destroy(f.hp);
+        }
+    }
+
+    free(data);
+    free(work);
+    return failed ? 1 : 0;
+}
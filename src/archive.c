@@ -0,0 +1,670 @@
+/* =============================================================
+ * archive.c - Contenedor sólido multi-archivo con índice central
+ * -------------------------------------------------------------
+ * En modo carpeta normal cada archivo se comprime por separado:
+ * con archivos pequeños eso reinicia el diccionario LZW o la tabla
+ * Huffman una y otra vez y gasta un inodo por archivo. Aquí todos
+ * los archivos van a un único contenedor:
+ *
+ *   [cabecera 24 B] "GSEAARC1" | u32 versión | u32 alg | u64 block_bytes
+ *   [bloques]       datos comprimidos, uno tras otro
+ *   [directorio]    "GSEADIR1"
+ *                   u64 n_bloques, por bloque:
+ *                       u64 offset | u64 comp_len | u64 raw_len | u32 crc
+ *                   u64 n_archivos, por archivo:
+ *                       u16 len_nombre | nombre | u64 bloque | u64 offset
+ *                       | u64 tamaño | u32 alg | u32 crc
+ *   [cola 24 B]     u64 offset_dir | u64 len_dir | "GSEAEND1"
+ *
+ * Todo en little-endian. Reglas de empaquetado:
+ *   - Un archivo que cabe en un bloque nunca se parte: si no entra
+ *     en el espacio restante se abre un bloque nuevo.
+ *   - Un archivo mayor que un bloque empieza en bloque nuevo y
+ *     ocupa bloques consecutivos (offset 0 en los siguientes).
+ *   - Los archivos se ordenan por extensión y ruta para que tipos
+ *     parecidos compartan bloque (mejor ratio).
+ * Los bloques se comprimen en paralelo por ventanas de 2*hilos y se
+ * escriben en orden. Para extraer un archivo basta leer la cola, el
+ * directorio y sus bloques (pread): no se recorre el resto.
+ * ============================================================= */
+#include "archive.h"
+#include "walk.h"
+#include "thread_pool.h"
+#include "crc32.h"
+#include "fs.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ARC_VERSION     1
+#define ARC_HEADER_LEN  24
+#define ARC_TRAILER_LEN 24
+#define ARC_DIR_MAGIC   "GSEADIR1"
+#define ARC_END_MAGIC   "GSEAEND1"
+
+/* ---------- little-endian ---------- */
+static void wr16le(uint8_t* p, uint16_t v) { p[0] = v & 0xFF; p[1] = (v >> 8) & 0xFF; }
+static void wr32le(uint8_t* p, uint32_t v) { for (int i = 0; i < 4; i++) p[i] = (v >> (8*i)) & 0xFF; }
+static void wr64le(uint8_t* p, uint64_t v) { for (int i = 0; i < 8; i++) p[i] = (v >> (8*i)) & 0xFF; }
+static uint16_t rd16le(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t rd32le(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+static uint64_t rd64le(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+/* ---------- E/S con reintentos ---------- */
+static int write_all(int fd, const uint8_t* buf, size_t len) {
+    size_t off = 0;
+    while (off < len) {
+        ssize_t w = write(fd, buf + off, len - off);
+        if (w <= 0) return -1;
+        off += (size_t)w;
+    }
+    return 0;
+}
+
+static int pread_all(int fd, uint8_t* buf, size_t len, uint64_t pos) {
+    size_t off = 0;
+    while (off < len) {
+        ssize_t r = pread(fd, buf + off, len - off, (off_t)(pos + off));
+        if (r <= 0) return -1;
+        off += (size_t)r;
+    }
+    return 0;
+}
+
+/* Crea las carpetas intermedias de 'path' (como mkdir -p del padre) */
+static void mkdirs_for(const char* path) {
+    char* tmp = strdup(path);
+    if (!tmp) return;
+    for (char* p = tmp + 1; *p; p++) {
+        if (*p == '/') { *p = '\0'; mkdir(tmp, 0755); *p = '/'; }
+    }
+    free(tmp);
+}
+
+/* Nombre de entrada que se puede unir a la carpeta de salida: relativo,
+ * sin NUL y sin componentes vacíos, "." ni "..". Un contenedor armado a
+ * mano podría traer "../x" o "/etc/x" y escribir fuera de -o. 1 = ok. */
+static int name_is_safe(const char* name, size_t len) {
+    if (len == 0 || name[0] == '/' || memchr(name, '\0', len)) return 0;
+    for (size_t s = 0; s <= len; ) {
+        size_t e = s;
+        while (e < len && name[e] != '/') e++;
+        size_t n = e - s;
+        if (n == 0) return 0;
+        if (name[s] == '.' && (n == 1 || (n == 2 && name[s + 1] == '.'))) return 0;
+        s = e + 1;
+    }
+    return 1;
+}
+
+/* ---------- Índice en memoria ---------- */
+typedef struct {
+    uint64_t offset;
+    uint64_t comp_len;
+    uint64_t raw_len;
+    uint32_t crc;
+} BlockEntry;
+
+typedef struct {
+    char* name;
+    uint64_t block;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t alg;
+    uint32_t crc;
+} FileEntry;
+
+typedef struct {
+    CompAlg alg;
+    BlockEntry* blocks;
+    size_t n_blocks;
+    size_t cap_blocks;
+    FileEntry* files;
+    size_t n_files;
+    size_t cap_files;
+} ArcIndex;
+
+static void idx_free(ArcIndex* ix) {
+    for (size_t i = 0; i < ix->n_files; i++) free(ix->files[i].name);
+    free(ix->files);
+    free(ix->blocks);
+    memset(ix, 0, sizeof(*ix));
+}
+
+static int idx_push_block(ArcIndex* ix, BlockEntry b) {
+    if (ix->n_blocks == ix->cap_blocks) {
+        size_t nc = ix->cap_blocks ? ix->cap_blocks * 2 : 64;
+        BlockEntry* t = realloc(ix->blocks, nc * sizeof(BlockEntry));
+        if (!t) return -1;
+        ix->blocks = t; ix->cap_blocks = nc;
+    }
+    ix->blocks[ix->n_blocks++] = b;
+    return 0;
+}
+
+static int idx_push_file(ArcIndex* ix, FileEntry f) {
+    if (ix->n_files == ix->cap_files) {
+        size_t nc = ix->cap_files ? ix->cap_files * 2 : 64;
+        FileEntry* t = realloc(ix->files, nc * sizeof(FileEntry));
+        if (!t) return -1;
+        ix->files = t; ix->cap_files = nc;
+    }
+    ix->files[ix->n_files++] = f;
+    return 0;
+}
+
+/* Lee cola + directorio de un contenedor abierto. 0 = ok. */
+static int idx_load(int fd, ArcIndex* ix) {
+    memset(ix, 0, sizeof(*ix));
+    struct stat st;
+    if (fstat(fd, &st) != 0) return -1;
+    uint64_t fsize = (uint64_t)st.st_size;
+    if (fsize < ARC_HEADER_LEN + ARC_TRAILER_LEN) return -1;
+
+    uint8_t hdr[ARC_HEADER_LEN], tr[ARC_TRAILER_LEN];
+    if (pread_all(fd, hdr, sizeof(hdr), 0) != 0) return -1;
+    if (memcmp(hdr, ARCHIVE_MAGIC, 8) != 0) return -1;
+    ix->alg = (CompAlg)rd32le(hdr + 12);
+
+    if (pread_all(fd, tr, sizeof(tr), fsize - ARC_TRAILER_LEN) != 0) return -1;
+    if (memcmp(tr + 16, ARC_END_MAGIC, 8) != 0) return -1;
+    uint64_t dir_off = rd64le(tr), dir_len = rd64le(tr + 8);
+    if (dir_off + dir_len > fsize - ARC_TRAILER_LEN || dir_len < 24) return -1;
+
+    uint8_t* d = malloc(dir_len);
+    if (!d) return -1;
+    if (pread_all(fd, d, dir_len, dir_off) != 0 || memcmp(d, ARC_DIR_MAGIC, 8) != 0) { free(d); return -1; }
+
+    size_t p = 8;
+    uint64_t nb = rd64le(d + p); p += 8;
+    if (nb > (dir_len - p) / 28) { free(d); return -1; }
+    for (uint64_t i = 0; i < nb; i++) {
+        BlockEntry b = { rd64le(d + p), rd64le(d + p + 8), rd64le(d + p + 16), rd32le(d + p + 24) };
+        p += 28;
+        if (idx_push_block(ix, b) != 0) { free(d); idx_free(ix); return -1; }
+    }
+    if (p + 8 > dir_len) { free(d); idx_free(ix); return -1; }
+    uint64_t nf = rd64le(d + p); p += 8;
+    for (uint64_t i = 0; i < nf; i++) {
+        if (p + 2 > dir_len) { free(d); idx_free(ix); return -1; }
+        size_t nl = rd16le(d + p); p += 2;
+        if (p + nl + 32 > dir_len) { free(d); idx_free(ix); return -1; }
+        if (!name_is_safe((const char*)d + p, nl)) { free(d); idx_free(ix); return -1; }
+        FileEntry f;
+        f.name = strndup((const char*)d + p, nl); p += nl;
+        f.block  = rd64le(d + p);      f.offset = rd64le(d + p + 8);
+        f.size   = rd64le(d + p + 16); f.alg    = rd32le(d + p + 24);
+        f.crc    = rd32le(d + p + 28); p += 32;
+        if (!f.name || idx_push_file(ix, f) != 0) { free(f.name); free(d); idx_free(ix); return -1; }
+    }
+    free(d);
+    return 0;
+}
+
+/* ---------- Descubrimiento de archivos ---------- */
+typedef struct {
+    char* rel;
+    size_t size;
+} Found;
+
+typedef struct {
+    Found* items;
+    size_t count;
+    size_t cap;
+    pthread_mutex_t mtx;
+} FoundList;
+
+static void on_found(const char* rel, size_t size, void* ctx) {
+    FoundList* fl = ctx;
+    char* r = strdup(rel);
+    if (!r) return;
+    pthread_mutex_lock(&fl->mtx);
+    if (fl->count == fl->cap) {
+        size_t nc = fl->cap ? fl->cap * 2 : 256;
+        Found* t = realloc(fl->items, nc * sizeof(Found));
+        if (!t) { pthread_mutex_unlock(&fl->mtx); free(r); return; }
+        fl->items = t; fl->cap = nc;
+    }
+    fl->items[fl->count].rel = r;
+    fl->items[fl->count].size = size;
+    fl->count++;
+    pthread_mutex_unlock(&fl->mtx);
+}
+
+static const char* ext_of(const char* rel) {
+    const char* slash = strrchr(rel, '/');
+    const char* dot = strrchr(slash ? slash : rel, '.');
+    return dot ? dot : "";
+}
+
+/* Orden: extensión y luego ruta (tipos parecidos quedan juntos) */
+static int cmp_found(const void* a, const void* b) {
+    const Found* x = a; const Found* y = b;
+    int c = strcmp(ext_of(x->rel), ext_of(y->rel));
+    return c ? c : strcmp(x->rel, y->rel);
+}
+
+/* ---------- Compresión de bloques por ventanas ---------- */
+typedef struct {
+    CompAlg alg;
+    uint8_t* raw;
+    size_t raw_len;
+    uint8_t* comp;
+    size_t comp_len;
+    uint32_t crc;
+    int err;
+} BlockJob;
+
+static void block_compress_job(void* arg) {
+    BlockJob* j = arg;
+    j->crc = crc32_update(0, j->raw, j->raw_len);
+    j->err = codec_compress(j->alg, NULL, j->raw, j->raw_len, &j->comp, &j->comp_len);
+}
+
+/* Estado del escritor */
+typedef struct {
+    const ArchiveOptions* opt;
+    int fd;
+    uint64_t pos;          /* offset actual en el contenedor */
+    ThreadPool* tp;
+    BlockJob* win;         /* ventana de bloques listos para comprimir */
+    size_t win_n;
+    size_t win_cap;
+    uint8_t* cur;          /* bloque que se está llenando */
+    size_t fill;
+    ArcIndex ix;
+} ArcWriter;
+
+/* Comprime en paralelo la ventana y la escribe en orden */
+static int aw_flush_window(ArcWriter* w) {
+    if (w->win_n == 0) return 0;
+    for (size_t i = 0; i < w->win_n; i++) tp_submit(w->tp, block_compress_job, &w->win[i]);
+    tp_wait(w->tp);
+
+    int rc = 0;
+    for (size_t i = 0; i < w->win_n; i++) {
+        BlockJob* j = &w->win[i];
+        if (rc == 0 && j->err == 0 && write_all(w->fd, j->comp, j->comp_len) == 0) {
+            BlockEntry b = { w->pos, j->comp_len, j->raw_len, j->crc };
+            if (idx_push_block(&w->ix, b) != 0) rc = -1;
+            w->pos += j->comp_len;
+        } else {
+            rc = -1;
+        }
+        free(j->raw);
+        free(j->comp);
+    }
+    JLOG(w->opt->journal, "[JOURNAL] Archivo: %zu bloques escritos (total %zu)\n",
+         w->win_n, w->ix.n_blocks);
+    w->win_n = 0;
+    return rc;
+}
+
+/* Cierra el bloque actual (si tiene datos) y lo pasa a la ventana */
+static int aw_close_block(ArcWriter* w) {
+    if (w->fill == 0) return 0;
+    BlockJob* j = &w->win[w->win_n++];
+    memset(j, 0, sizeof(*j));
+    j->alg = w->opt->alg;
+    j->raw = w->cur;
+    j->raw_len = w->fill;
+    w->cur = NULL;
+    w->fill = 0;
+    if (w->win_n == w->win_cap) return aw_flush_window(w);
+    return 0;
+}
+
+/* Índice del bloque que se está llenando (los de la ventana aún no tienen entrada) */
+static size_t aw_cur_block(const ArcWriter* w) {
+    return w->ix.n_blocks + w->win_n;
+}
+
+static int aw_add_file(ArcWriter* w, const char* root, const Found* f) {
+    const size_t B = w->opt->block_bytes;
+
+    /* Reglas de empaquetado (ver cabecera) */
+    if (w->fill > 0 && (f->size > B || w->fill + f->size > B))
+        if (aw_close_block(w) != 0) return -1;
+
+    char* path = malloc(strlen(root) + strlen(f->rel) + 2);
+    if (!path) return -1;
+    sprintf(path, "%s/%s", root, f->rel);
+    int fd = open(path, O_RDONLY);
+    free(path);
+    if (fd < 0) return 0; /* desapareció: se omite */
+
+    FileEntry e;
+    e.name = strdup(f->rel);
+    e.block = aw_cur_block(w);
+    e.offset = w->fill;
+    e.alg = (uint32_t)w->opt->alg;
+    e.crc = 0;
+    e.size = 0;
+
+    size_t remaining = f->size;
+    while (remaining > 0) {
+        if (!w->cur) {
+            w->cur = malloc(B);
+            if (!w->cur) { close(fd); free(e.name); return -1; }
+        }
+        size_t n = B - w->fill;
+        if (n > remaining) n = remaining;
+        ssize_t r = read(fd, w->cur + w->fill, n);
+        if (r <= 0) break; /* archivo truncado mientras se leía */
+        e.crc = crc32_update(e.crc, w->cur + w->fill, (size_t)r);
+        w->fill += (size_t)r;
+        e.size += (uint64_t)r;
+        remaining -= (size_t)r;
+        if (w->fill == B && aw_close_block(w) != 0) { close(fd); free(e.name); return -1; }
+    }
+    close(fd);
+    if (!e.name || idx_push_file(&w->ix, e) != 0) { free(e.name); return -1; }
+    return 0;
+}
+
+static int aw_write_directory(ArcWriter* w) {
+    size_t len = 8 + 8 + w->ix.n_blocks * 28 + 8;
+    for (size_t i = 0; i < w->ix.n_files; i++) len += 2 + strlen(w->ix.files[i].name) + 32;
+
+    uint8_t* d = malloc(len + ARC_TRAILER_LEN);
+    if (!d) return -1;
+    size_t p = 0;
+    memcpy(d, ARC_DIR_MAGIC, 8); p += 8;
+    wr64le(d + p, w->ix.n_blocks); p += 8;
+    for (size_t i = 0; i < w->ix.n_blocks; i++) {
+        const BlockEntry* b = &w->ix.blocks[i];
+        wr64le(d + p, b->offset); wr64le(d + p + 8, b->comp_len);
+        wr64le(d + p + 16, b->raw_len); wr32le(d + p + 24, b->crc);
+        p += 28;
+    }
+    wr64le(d + p, w->ix.n_files); p += 8;
+    for (size_t i = 0; i < w->ix.n_files; i++) {
+        const FileEntry* f = &w->ix.files[i];
+        size_t nl = strlen(f->name);
+        wr16le(d + p, (uint16_t)nl); p += 2;
+        memcpy(d + p, f->name, nl); p += nl;
+        wr64le(d + p, f->block); wr64le(d + p + 8, f->offset);
+        wr64le(d + p + 16, f->size); wr32le(d + p + 24, f->alg);
+        wr32le(d + p + 28, f->crc); p += 32;
+    }
+    /* cola */
+    wr64le(d + p, w->pos); wr64le(d + p + 8, len);
+    memcpy(d + p + 16, ARC_END_MAGIC, 8);
+
+    int rc = write_all(w->fd, d, len + ARC_TRAILER_LEN);
+    w->pos += len + ARC_TRAILER_LEN;
+    free(d);
+    return rc;
+}
+
+int archive_create(const char* in_dir, const char* out_file,
+                   const ArchiveOptions* opt, ArchiveStats* st)
+{
+    if (!in_dir || !out_file || !opt || opt->block_bytes == 0) return -1;
+    if (opt->alg == COMP_DELTA16_LZW || opt->alg == COMP_DELTA16_HUFF) return -1;
+
+    FoundList fl = { NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER };
+    WalkOptions wo = { .in_root = in_dir, .nthreads = opt->nthreads < 8 ? opt->nthreads : 8,
+                       .on_file = on_found, .ctx = &fl };
+    if (walk_tree(&wo, NULL, NULL) != 0) return -1;
+    qsort(fl.items, fl.count, sizeof(Found), cmp_found);
+
+    ArcWriter w;
+    memset(&w, 0, sizeof(w));
+    w.opt = opt;
+    w.win_cap = opt->nthreads * 2;
+    if (w.win_cap < 1) w.win_cap = 1;
+    w.win = calloc(w.win_cap, sizeof(BlockJob));
+    w.tp = tp_create(opt->nthreads ? opt->nthreads : 1);
+    w.fd = open(out_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    int rc = (w.win && w.tp && w.fd >= 0) ? 0 : -1;
+
+    if (rc == 0) {
+        uint8_t hdr[ARC_HEADER_LEN];
+        memcpy(hdr, ARCHIVE_MAGIC, 8);
+        wr32le(hdr + 8, ARC_VERSION);
+        wr32le(hdr + 12, (uint32_t)opt->alg);
+        wr64le(hdr + 16, opt->block_bytes);
+        rc = write_all(w.fd, hdr, sizeof(hdr));
+        w.pos = ARC_HEADER_LEN;
+    }
+
+    uint64_t raw = 0;
+    for (size_t i = 0; rc == 0 && i < fl.count; i++) {
+        rc = aw_add_file(&w, in_dir, &fl.items[i]);
+        raw += fl.items[i].size;
+    }
+    if (rc == 0) rc = aw_close_block(&w);
+    if (rc == 0) rc = aw_flush_window(&w);
+    if (rc == 0) rc = aw_write_directory(&w);
+
+    if (st) {
+        st->n_files = w.ix.n_files;
+        st->n_blocks = w.ix.n_blocks;
+        st->raw_bytes = raw;
+        st->arc_bytes = w.pos;
+    }
+
+    /* limpieza (también en error) */
+    for (size_t i = 0; i < w.win_n; i++) { free(w.win[i].raw); free(w.win[i].comp); }
+    free(w.win);
+    free(w.cur);
+    if (w.tp) tp_destroy(w.tp);
+    if (w.fd >= 0 && close(w.fd) != 0) rc = -1;
+    idx_free(&w.ix);
+    for (size_t i = 0; i < fl.count; i++) free(fl.items[i].rel);
+    free(fl.items);
+    return rc;
+}
+
+int archive_is_archive(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    uint8_t m[8];
+    int ok = (pread_all(fd, m, 8, 0) == 0 && memcmp(m, ARCHIVE_MAGIC, 8) == 0);
+    close(fd);
+    return ok;
+}
+
+int archive_list(const char* arc_path, FILE* out) {
+    int fd = open(arc_path, O_RDONLY);
+    if (fd < 0) return -1;
+    ArcIndex ix;
+    if (idx_load(fd, &ix) != 0) { close(fd); return -1; }
+    fprintf(out, "%-40s %12s %6s %10s %-12s %8s\n", "Nombre", "Tamaño", "Bloque", "Offset", "Alg", "CRC32");
+    for (size_t i = 0; i < ix.n_files; i++) {
+        const FileEntry* f = &ix.files[i];
+        fprintf(out, "%-40s %12llu %6llu %10llu %-12s %08x\n", f->name,
+                (unsigned long long)f->size, (unsigned long long)f->block,
+                (unsigned long long)f->offset, codec_name((CompAlg)f->alg), f->crc);
+    }
+    fprintf(out, "%zu archivos en %zu bloques\n", ix.n_files, ix.n_blocks);
+    idx_free(&ix);
+    close(fd);
+    return 0;
+}
+
+/* Lee y descomprime el bloque b, verificando tamaño y CRC */
+static int load_block(int fd, const ArcIndex* ix, size_t b, uint8_t** out, size_t* out_len) {
+    if (b >= ix->n_blocks) return -1;
+    const BlockEntry* be = &ix->blocks[b];
+    uint8_t* comp = malloc(be->comp_len ? be->comp_len : 1);
+    if (!comp) return -1;
+    if (pread_all(fd, comp, be->comp_len, be->offset) != 0) { free(comp); return -1; }
+    int rc = codec_decompress(ix->alg, comp, be->comp_len, out, out_len);
+    free(comp);
+    if (rc != 0) return -1;
+    if (*out_len != be->raw_len || crc32_update(0, *out, *out_len) != be->crc) {
+        free(*out); *out = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int archive_extract_file(const char* arc_path, const char* name, const char* out_path) {
+    if (!name_is_safe(name, strlen(name))) return -1;
+    int fd = open(arc_path, O_RDONLY);
+    if (fd < 0) return -1;
+    ArcIndex ix;
+    if (idx_load(fd, &ix) != 0) { close(fd); return -1; }
+
+    const FileEntry* f = NULL;
+    for (size_t i = 0; i < ix.n_files && !f; i++)
+        if (strcmp(ix.files[i].name, name) == 0) f = &ix.files[i];
+
+    int rc = -1;
+    uint8_t* data = f ? malloc(f->size ? f->size : 1) : NULL;
+    if (data) {
+        /* Solo los bloques que contienen el archivo */
+        uint64_t done = 0, off = f->offset;
+        size_t b = (size_t)f->block;
+        rc = 0;
+        while (rc == 0 && done < f->size) {
+            uint8_t* blk = NULL; size_t blen = 0;
+            if (load_block(fd, &ix, b, &blk, &blen) != 0 || off > blen) { free(blk); rc = -1; break; }
+            uint64_t n = blen - off;
+            if (n > f->size - done) n = f->size - done;
+            memcpy(data + done, blk + off, n);
+            done += n; off = 0; b++;
+            free(blk);
+        }
+        if (rc == 0 && crc32_update(0, data, f->size) != f->crc) rc = -1;
+        if (rc == 0) rc = write_file(out_path, data, f->size);
+        free(data);
+    }
+    idx_free(&ix);
+    close(fd);
+    return rc;
+}
+
+/* ---------- Extracción completa (bloques en paralelo, archivos en streaming) ---------- */
+typedef struct {
+    int fd;
+    const ArcIndex* ix;
+    size_t b;
+    uint8_t* out;
+    size_t out_len;
+    int err;
+} LoadJob;
+
+static void load_block_job(void* arg) {
+    LoadJob* j = arg;
+    j->err = load_block(j->fd, j->ix, j->b, &j->out, &j->out_len);
+}
+
+/* Estado del archivo de salida en curso */
+typedef struct {
+    size_t fi;          /* índice del archivo actual */
+    uint64_t done;      /* bytes ya escritos */
+    uint32_t crc;
+    int ofd;            /* -1 = aún no abierto */
+} ExtractCursor;
+
+static int cursor_open(ExtractCursor* c, const ArcIndex* ix, const char* out_dir) {
+    const FileEntry* f = &ix->files[c->fi];
+    if (!name_is_safe(f->name, strlen(f->name))) return -1;   /* ya se validó al cargar */
+    size_t n = strlen(out_dir) + strlen(f->name) + 2;
+    char* path = malloc(n);
+    if (!path) return -1;
+    snprintf(path, n, "%s/%s", out_dir, f->name);
+    mkdirs_for(path);
+    c->ofd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    free(path);
+    c->done = 0;
+    c->crc = 0;
+    return c->ofd >= 0 ? 0 : -1;
+}
+
+static int cursor_finish(ExtractCursor* c, const ArcIndex* ix) {
+    int rc = (close(c->ofd) == 0 && c->crc == ix->files[c->fi].crc) ? 0 : -1;
+    c->ofd = -1;
+    c->fi++;
+    return rc;
+}
+
+int archive_extract_all(const char* arc_path, const char* out_dir,
+                        const ArchiveOptions* opt, ArchiveStats* st)
+{
+    int fd = open(arc_path, O_RDONLY);
+    if (fd < 0) return -1;
+    ArcIndex ix;
+    if (idx_load(fd, &ix) != 0) { close(fd); return -1; }
+    mkdir(out_dir, 0755);
+
+    size_t nth = (opt && opt->nthreads) ? opt->nthreads : 1;
+    size_t W = nth * 2;
+    ThreadPool* tp = tp_create(nth);
+    LoadJob* jobs = calloc(W, sizeof(LoadJob));
+    int rc = (tp && jobs) ? 0 : -1;
+
+    ExtractCursor c = { 0, 0, 0, -1 };
+    uint64_t raw = 0;
+
+    for (size_t b0 = 0; rc == 0 && b0 < ix.n_blocks; b0 += W) {
+        size_t nb = ix.n_blocks - b0 < W ? ix.n_blocks - b0 : W;
+        for (size_t i = 0; i < nb; i++) {
+            jobs[i] = (LoadJob){ fd, &ix, b0 + i, NULL, 0, 0 };
+            tp_submit(tp, load_block_job, &jobs[i]);
+        }
+        tp_wait(tp);
+        if (opt) JLOG(opt->journal, "[JOURNAL] Archivo: bloques %zu..%zu descomprimidos\n", b0, b0 + nb - 1);
+
+        for (size_t i = 0; i < nb && rc == 0; i++) {
+            size_t b = b0 + i;
+            if (jobs[i].err) { rc = -1; break; }
+            /* Repartir el bloque entre los archivos que lo ocupan */
+            while (rc == 0 && c.fi < ix.n_files) {
+                const FileEntry* f = &ix.files[c.fi];
+                if (c.ofd < 0) {
+                    if (f->block > b && f->size > 0) break;   /* empieza más adelante */
+                    if (f->block < b && f->size > 0) { rc = -1; break; } /* índice inconsistente */
+                    if (cursor_open(&c, &ix, out_dir) != 0) { rc = -1; break; }
+                }
+                if (f->size == 0) { rc = cursor_finish(&c, &ix); continue; }
+                /* posición del archivo dentro del bloque b */
+                uint64_t off = (c.done == 0) ? f->offset : 0;
+                if (off > jobs[i].out_len) { rc = -1; break; }
+                uint64_t n = jobs[i].out_len - off;
+                if (n > f->size - c.done) n = f->size - c.done;
+                const uint8_t* src = jobs[i].out + off;
+                if (write_all(c.ofd, src, n) != 0) { rc = -1; break; }
+                c.crc = crc32_update(c.crc, src, n);
+                c.done += n;
+                raw += n;
+                if (c.done < f->size) break;               /* sigue en el bloque b+1 */
+                rc = cursor_finish(&c, &ix);
+            }
+        }
+        for (size_t i = 0; i < nb; i++) { free(jobs[i].out); jobs[i].out = NULL; }
+    }
+    /* Archivos vacíos al final (sin bloque propio) */
+    while (rc == 0 && c.fi < ix.n_files && ix.files[c.fi].size == 0) {
+        if (cursor_open(&c, &ix, out_dir) != 0 || cursor_finish(&c, &ix) != 0) rc = -1;
+    }
+    if (c.ofd >= 0) close(c.ofd);
+    if (rc == 0 && c.fi != ix.n_files) rc = -1;
+
+    if (st) {
+        st->n_files = c.fi;
+        st->n_blocks = ix.n_blocks;
+        st->raw_bytes = raw;
+        struct stat sst;
+        st->arc_bytes = (fstat(fd, &sst) == 0) ? (uint64_t)sst.st_size : 0;
+    }
+
+    free(jobs);
+    if (tp) tp_destroy(tp);
+    idx_free(&ix);
+    close(fd);
+    return rc;
+}
@@ -0,0 +1,61 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "codec.h"
+#include "journal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Contenedor "sólido" para carpetas completas (ver archive.c para el formato).
+ * - Los archivos pequeños se concatenan en bloques compartidos de block_bytes,
+ *   así el diccionario LZW / la tabla Huffman se aprovecha entre archivos.
+ * - Un directorio central al final guarda nombre, bloque, offset, tamaño,
+ *   algoritmo y CRC-32 de cada archivo.
+ * - Cualquier archivo se puede extraer leyendo solo sus bloques.
+ */
+
+#define ARCHIVE_MAGIC "GSEAARC1"
+
+typedef struct {
+    CompAlg alg;           /* algoritmo por bloque (no delta16) */
+    size_t block_bytes;    /* tamaño de bloque sólido sin comprimir */
+    size_t nthreads;       /* hilos para comprimir / descomprimir bloques */
+    const Journal* journal;
+} ArchiveOptions;
+
+typedef struct {
+    size_t n_files;
+    size_t n_blocks;
+    uint64_t raw_bytes;    /* suma de tamaños originales */
+    uint64_t arc_bytes;    /* tamaño del contenedor */
+} ArchiveStats;
+
+/* Empaqueta todos los archivos de in_dir (recursivo) en out_file. 0 = ok. */
+int archive_create(const char* in_dir, const char* out_file,
+                   const ArchiveOptions* opt, ArchiveStats* st);
+
+/* 1 si path empieza con ARCHIVE_MAGIC, 0 si no. */
+int archive_is_archive(const char* path);
+
+/* Escribe el índice (una línea por archivo) en 'out'. 0 = ok. */
+int archive_list(const char* arc_path, FILE* out);
+
+/* Extrae todo en out_dir (replicando subcarpetas). 0 = ok. */
+int archive_extract_all(const char* arc_path, const char* out_dir,
+                        const ArchiveOptions* opt, ArchiveStats* st);
+
+/* Extrae un único archivo 'name' (ruta relativa como en archive_list)
+ * descomprimiendo solo los bloques que lo contienen. 0 = ok. */
+int archive_extract_file(const char* arc_path, const char* name,
+                         const char* out_path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ARCHIVE_H */
@@ -0,0 +1,104 @@
+/* =============================================================
+ * arena.c - Arena "bump pointer" para temporales de los codecs
+ * -------------------------------------------------------------
+ * Reservar es sumar al puntero del bloque actual; liberar es volver
+ * a una marca. Si una reserva no cabe se encadena un bloque nuevo
+ * (al menos el doble del anterior). Al volver a la arena vacía, la
+ * capacidad de esos bloques extra se junta en uno solo: tras el
+ * primer chunk, los siguientes del mismo tamaño caben en un bloque
+ * y ya no llaman a malloc. Así los hilos de trabajo no compiten
+ * dentro de malloc por buffers que viven lo que dura un chunk.
+ * ============================================================= */
+#include "arena.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+#define ARENA_ALIGN     16
+#define ARENA_MIN_BLOCK (64 * 1024)
+
+struct ArenaBlock {
+    ArenaBlock* prev;
+    size_t cap;
+    size_t used;
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+void arena_init(Arena* a) {
+    a->head = NULL;
+    a->spill = 0;
+}
+
+void arena_free(Arena* a) {
+    while (a->head) {
+        ArenaBlock* p = a->head->prev;
+        free(a->head);
+        a->head = p;
+    }
+    a->spill = 0;
+}
+
+static ArenaBlock* block_new(size_t cap, ArenaBlock* prev) {
+    if (cap > SIZE_MAX - sizeof(ArenaBlock)) return NULL;
+    ArenaBlock* b = malloc(sizeof(ArenaBlock) + cap);
+    if (!b) return NULL;
+    b->prev = prev;
+    b->cap = cap;
+    b->used = 0;
+    return b;
+}
+
+void* arena_alloc(Arena* a, size_t n) {
+    if (!a) return NULL;
+    if (n > SIZE_MAX - ARENA_ALIGN) return NULL;
+    n = (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    ArenaBlock* b = a->head;
+    if (!b || b->cap - b->used < n) {
+        size_t cap = b ? b->cap * 2 : ARENA_MIN_BLOCK;
+        if (cap < n) cap = n;
+        b = block_new(cap, a->head);
+        if (!b) return NULL;
+        a->head = b;
+    }
+    void* p = b->data + b->used;
+    b->used += n;
+    return p;
+}
+
+ArenaMark arena_mark(const Arena* a) {
+    ArenaMark m = { a->head, a->head ? a->head->used : 0 };
+    return m;
+}
+
+void arena_release(Arena* a, ArenaMark m) {
+    /* Los bloques creados después de la marca se liberan; el primero se
+     * conserva siempre para la próxima tarea. */
+    while (a->head && a->head != m.block && a->head->prev) {
+        ArenaBlock* p = a->head->prev;
+        a->spill += a->head->cap;
+        free(a->head);
+        a->head = p;
+    }
+    if (!a->head) return;
+    a->head->used = (a->head == m.block) ? m.used : 0;
+
+    /* Arena vacía: un solo bloque con toda la capacidad que hizo falta */
+    if (a->head->used == 0 && !a->head->prev && a->spill) {
+        ArenaBlock* b = block_new(a->head->cap + a->spill, NULL);
+        if (b) {
+            free(a->head);
+            a->head = b;
+        }
+        a->spill = 0;
+    }
+}
+
+void arena_trim(Arena* a, size_t keep) {
+    if (!a->head || a->head->used || a->head->prev) return;
+    if (a->head->cap > keep) arena_free(a);
+}
+
+size_t arena_capacity(const Arena* a) {
+    size_t c = 0;
+    for (const ArenaBlock* b = a->head; b; b = b->prev) c += b->cap;
+    return c;
+}
@@ -0,0 +1,48 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Arena "bump pointer" para temporales de vida corta (ver arena.c).
+ * - arena_alloc solo avanza un puntero; no hay free individual.
+ * - arena_mark / arena_release liberan todo lo reservado desde la marca
+ *   (en orden LIFO), así una tarea o una función anidada limpia lo suyo
+ *   sin tocar lo de quien la llamó.
+ * Una arena pertenece a un solo hilo. */
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock* head;    /* bloque actual; los anteriores por ->prev */
+    size_t spill;        /* capacidad de bloques extra ya liberados */
+} Arena;
+
+typedef struct {
+    ArenaBlock* block;
+    size_t used;
+} ArenaMark;
+
+void arena_init(Arena* a);
+void arena_free(Arena* a);
+
+/* n bytes alineados a 16; NULL si no hay memoria. */
+void* arena_alloc(Arena* a, size_t n);
+
+ArenaMark arena_mark(const Arena* a);
+void arena_release(Arena* a, ArenaMark m);
+
+/* Si la arena está vacía y retiene más de 'keep' bytes, devuelve sus
+ * bloques a malloc; la próxima reserva vuelve a pedir uno. */
+void arena_trim(Arena* a, size_t keep);
+
+/* Bytes reservados en bloques (capacidad total de la arena). */
+size_t arena_capacity(const Arena* a);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ARENA_H */
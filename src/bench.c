@@ -0,0 +1,1026 @@
+/* =============================================================
+ * bench.c - Subcomando "gsea bench"
+ * -------------------------------------------------------------
+ * Mide el pipeline completo (chunks + cifrado) sin tocar disco:
+ *   - El corpus (-i archivo o carpeta) se carga una vez en memoria.
+ *   - Para cada combinación comp-alg × enc-alg × workers ×
+ *     inner-workers × chunk-mb se hacen --warmup corridas que no
+ *     cuentan y luego --reps corridas medidas.
+ *   - Cada corrida comprime (+cifra) todos los archivos con un pool
+ *     de 'workers' hilos, luego descifra + descomprime y verifica
+ *     que el resultado sea idéntico al original.
+ *   - MB/s usa la mediana de las corridas; las latencias por chunk
+ *     (p50/p99) vienen del aviso on_chunk de chunked.c.
+ *   - RSS pico: se reinicia con /proc/self/clear_refs antes de cada
+ *     combinación y se lee VmHWM (si no se puede, ru_maxrss).
+ *   - Con make MEMTRACK=1 además: pico del heap por encima de lo que ya
+ *     estaba vivo (el corpus) y número de reservas (memtrack.c).
+ * Los modos delta16 solo se aplican a los WAV del corpus.
+ * Cada fila se desglosa además por tipo de dato: la carpeta de primer
+ * nivel del corpus (text/, audio/, image/, bin/, small/ en el de
+ * gen-corpus), con su ratio y MB/s por archivo.
+ * Resultado: tabla en stdout y, con --json, un documento JSON.
+ * Ese JSON sirve de baseline (--save-baseline) y --compare lo contrasta
+ * con la corrida actual (ver bench_baseline.c); con regresiones el
+ * proceso sale con código 2.
+ *
+ * Con --scaling se barre en cambio el número de hilos (1, 2, 4, ..., N)
+ * en dos escenarios: pool externo (todo el corpus, inner = 1) y pool de
+ * chunks (solo el archivo más grande, workers = 1). Para cada N se
+ * reporta speedup y eficiencia respecto a N = 1 y, con los contadores de
+ * thread_pool.c, qué parte del tiempo de hilo se fue en los codecs, en
+ * espera del mutex de la cola o dormido sin trabajo.
+ * ============================================================= */
+#include "bench.h"
+#include "bench_baseline.h"
+#include "codec.h"
+#include "chunked.h"
+#include "vigenere.h"
+#include "aes_simple.h"
+#include "audio_wav.h"
+#include "thread_pool.h"
+#include "cpu_count.h"
+#include "walk.h"
+#include "perfctr.h"
+#include "memtrack.h"
+#include "fs.h"
+#include "journal.h"
+#include "corpus.h"
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define BENCH_MAX_LIST 16
+#define BENCH_MAX_GROUPS 16
+#define SCALE_MIN_CHUNK  (64 * 1024)    /* chunk mínimo del barrido inner */
+#define BENCH_KEY      "gsea-bench-key"
+
+/* Cifrados (mismos nombres que --enc-alg) */
+typedef enum { BENCH_ENC_NONE, BENCH_ENC_VIG, BENCH_ENC_AES } BenchEnc;
+static const char* enc_name(int e) {
+    return e == BENCH_ENC_VIG ? "vigenere" : e == BENCH_ENC_AES ? "aes" : "none";
+}
+
+/* ---------- Corpus en memoria ---------- */
+typedef struct {
+    char* name;
+    uint8_t* data;
+    size_t len;
+    int is_wav;
+    size_t group;       /* índice en Corpus.groups */
+} BenchFile;
+
+typedef struct {
+    BenchFile* f;
+    size_t n, cap;
+    uint64_t bytes;
+    const char* root;
+    pthread_mutex_t mtx;
+    char groups[BENCH_MAX_GROUPS][32];  /* tipos de dato (ver corpus_group) */
+    size_t n_groups;
+} Corpus;
+
+static int corpus_add(Corpus* c, const char* path, const char* name) {
+    BenchFile bf = {0};
+    if (read_file(path, &bf.data, &bf.len) != 0) return -1;
+    bf.name = strdup(name);
+    bf.is_wav = wav_is_riff_wave(bf.data, bf.len);
+    pthread_mutex_lock(&c->mtx);
+    if (c->n == c->cap) {
+        size_t nc = c->cap ? c->cap * 2 : 64;
+        BenchFile* t = realloc(c->f, nc * sizeof(BenchFile));
+        if (!t) { pthread_mutex_unlock(&c->mtx); free(bf.data); free(bf.name); return -1; }
+        c->f = t; c->cap = nc;
+    }
+    c->f[c->n++] = bf;
+    c->bytes += bf.len;
+    pthread_mutex_unlock(&c->mtx);
+    return 0;
+}
+
+static void on_corpus_file(const char* rel, size_t size, void* ctx) {
+    (void)size;
+    Corpus* c = (Corpus*)ctx;
+    if (strcmp(rel, CORPUS_MANIFEST) == 0) return;   /* metadatos de gen-corpus */
+    size_t n = strlen(c->root) + strlen(rel) + 2;
+    char* path = malloc(n);
+    if (!path) return;
+    snprintf(path, n, "%s/%s", c->root, rel);
+    corpus_add(c, path, rel);
+    free(path);
+}
+
+static int cmp_file_name(const void* a, const void* b) {
+    return strcmp(((const BenchFile*)a)->name, ((const BenchFile*)b)->name);
+}
+
+/* Tipo de dato = carpeta de primer nivel; los archivos sueltos en la raíz
+ * van a ".". Si hay más de BENCH_MAX_GROUPS carpetas, las últimas se
+ * juntan en "otros". */
+static void corpus_group(Corpus* c) {
+    for (size_t i = 0; i < c->n; i++) {
+        const char* name = c->f[i].name;
+        const char* slash = strchr(name, '/');
+        char g[32];
+        if (slash) snprintf(g, sizeof(g), "%.*s", (int)(slash - name), name);
+        else snprintf(g, sizeof(g), ".");
+        size_t k = 0;
+        while (k < c->n_groups && strcmp(c->groups[k], g) != 0) k++;
+        if (k == c->n_groups) {
+            if (k >= BENCH_MAX_GROUPS - 1) { k = BENCH_MAX_GROUPS - 1; snprintf(g, sizeof(g), "otros"); }
+            snprintf(c->groups[k], sizeof(c->groups[k]), "%s", g);
+            if (k == c->n_groups) c->n_groups++;
+        }
+        c->f[i].group = k;
+    }
+}
+
+static int corpus_load(Corpus* c, const char* path) {
+    memset(c, 0, sizeof(*c));
+    pthread_mutex_init(&c->mtx, NULL);
+    c->root = path;
+    struct stat st;
+    if (stat(path, &st) != 0) return -1;
+    if (S_ISDIR(st.st_mode)) {
+        WalkOptions wo = { .in_root = path, .nthreads = 4, .on_file = on_corpus_file, .ctx = c };
+        if (walk_tree(&wo, NULL, NULL) != 0) return -1;
+        /* orden estable: el recorrido paralelo no garantiza orden */
+        qsort(c->f, c->n, sizeof(BenchFile), cmp_file_name);
+        corpus_group(c);
+    } else if (corpus_add(c, path, path) != 0) {
+        return -1;
+    } else {
+        snprintf(c->groups[0], sizeof(c->groups[0]), ".");
+        c->n_groups = 1;
+    }
+    return c->n ? 0 : -1;
+}
+
+static void corpus_free(Corpus* c) {
+    for (size_t i = 0; i < c->n; i++) { free(c->f[i].data); free(c->f[i].name); }
+    free(c->f);
+    pthread_mutex_destroy(&c->mtx);
+}
+
+/* ---------- Latencias por chunk ---------- */
+typedef struct {
+    pthread_mutex_t mtx;
+    uint64_t* v;
+    size_t n, cap;
+    int on;            /* 0 durante el calentamiento */
+} LatVec;
+
+static void lat_push(LatVec* l, uint64_t ns) {
+    if (!l->on) return;
+    pthread_mutex_lock(&l->mtx);
+    if (l->n == l->cap) {
+        size_t nc = l->cap ? l->cap * 2 : 256;
+        uint64_t* t = realloc(l->v, nc * sizeof(uint64_t));
+        if (t) { l->v = t; l->cap = nc; }
+    }
+    if (l->n < l->cap) l->v[l->n++] = ns;
+    pthread_mutex_unlock(&l->mtx);
+}
+
+static void on_chunk_done(size_t chunk, size_t raw_len, size_t comp_len, uint64_t ns, void* ctx) {
+    (void)chunk; (void)raw_len; (void)comp_len;
+    lat_push((LatVec*)ctx, ns);
+}
+
+static int cmp_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/* Percentil p (0..1) por rango más cercano, en ms. El vector se ordena. */
+static double lat_pct_ms(LatVec* l, double p) {
+    if (l->n == 0) return 0.0;
+    qsort(l->v, l->n, sizeof(uint64_t), cmp_u64);
+    size_t k = (size_t)(p * (double)l->n + 0.999999);
+    if (k < 1) k = 1;
+    if (k > l->n) k = l->n;
+    return (double)l->v[k - 1] / 1e6;
+}
+
+/* ---------- RSS pico ---------- */
+static void rss_reset(void) {
+    /* "5" reinicia VmHWM (Linux >= 4.0); si falla se usa ru_maxrss */
+    FILE* f = fopen("/proc/self/clear_refs", "w");
+    if (f) { fputs("5", f); fclose(f); }
+}
+
+static long rss_peak_kb(void) {
+    FILE* f = fopen("/proc/self/status", "r");
+    if (f) {
+        char line[256];
+        long kb = -1;
+        while (fgets(line, sizeof(line), f))
+            if (strncmp(line, "VmHWM:", 6) == 0) { kb = atol(line + 6); break; }
+        fclose(f);
+        if (kb >= 0) return kb;
+    }
+    struct rusage ru;
+    return getrusage(RUSAGE_SELF, &ru) == 0 ? ru.ru_maxrss : 0;
+}
+
+/* ---------- Una combinación ---------- */
+typedef struct {
+    CompAlg comp;
+    int enc;
+    size_t workers;
+    size_t inner;
+    size_t chunk_bytes;
+} BenchCase;
+
+/* Desglose de una combinación por tipo de dato */
+typedef struct {
+    size_t files;
+    uint64_t raw_bytes;
+    uint64_t out_bytes;
+    uint64_t run_bytes;     /* bytes procesados en las corridas medidas */
+    uint64_t c_ns, d_ns;    /* tiempo sumado por archivo en esas corridas */
+} BenchGroup;
+
+typedef struct {
+    BenchCase c;
+    size_t files;
+    uint64_t raw_bytes;
+    uint64_t out_bytes;
+    double c_mbs, d_mbs;
+    double c_p50, c_p99, d_p50, d_p99;
+    long rss_kb;
+    int64_t heap_peak;      /* MEMTRACK: pico de heap sobre el inicio */
+    uint64_t allocs;        /* MEMTRACK: reservas en todas las corridas */
+    int ok;
+    uint64_t med_ns;        /* mediana de (compresión + descompresión) */
+    uint64_t wall_ns;       /* suma de las corridas medidas */
+    ThreadPoolStats pool;   /* pools creados en las corridas medidas */
+    double c_samp[BASELINE_MAX_SAMPLES];  /* MB/s por corrida medida */
+    double d_samp[BASELINE_MAX_SAMPLES];
+    size_t n_samp;
+    BenchGroup by_group[BENCH_MAX_GROUPS];
+} BenchResult;
+
+/* Trabajo por archivo dentro de una corrida */
+typedef struct {
+    const BenchCase* c;
+    const BenchFile* f;
+    LatVec* clat;
+    LatVec* dlat;
+    uint8_t* packed;
+    size_t packed_len;
+    uint64_t c_ns, d_ns;    /* pared de este archivo en la última corrida */
+    int err;
+} FileJob;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int is_delta16(CompAlg a) { return a == COMP_DELTA16_LZW || a == COMP_DELTA16_HUFF; }
+
+static void job_compress(void* arg) {
+    FileJob* j = (FileJob*)arg;
+    const BenchCase* c = j->c;
+    uint8_t* out = NULL;
+    size_t out_len = 0;
+    uint64_t t_file = now_ns();
+
+    if (is_delta16(c->comp)) {
+        /* sin chunks: el archivo completo cuenta como un chunk */
+        uint64_t t0 = now_ns();
+        if (codec_wav_compress(c->comp, j->f->data, j->f->len, &out, &out_len) != 0) { j->err = 1; return; }
+        lat_push(j->clat, now_ns() - t0);
+    } else {
+        ChunkedOptions co = {
+            .alg = c->comp,
+            .chunk_bytes = c->chunk_bytes,
+            .nthreads = (j->f->len > c->chunk_bytes) ? c->inner : 1,
+            .on_chunk = on_chunk_done,
+            .chunk_ctx = j->clat
+        };
+        if (chunked_compress(&co, j->f->data, j->f->len, &out, &out_len) != 0) { j->err = 1; return; }
+    }
+
+    if (c->enc == BENCH_ENC_VIG) {
+        vigenere_encrypt(out, out_len, (const uint8_t*)BENCH_KEY, strlen(BENCH_KEY));
+    } else if (c->enc == BENCH_ENC_AES) {
+        uint8_t* enc = NULL;
+        size_t enc_len = 0;
+        int rc = aes_encrypt_buffer(out, out_len, BENCH_KEY, &enc, &enc_len);
+        free(out);
+        if (rc != 0) { j->err = 1; return; }
+        out = enc;
+        out_len = enc_len;
+    }
+    j->packed = out;
+    j->packed_len = out_len;
+    j->c_ns = now_ns() - t_file;
+}
+
+static void job_decompress(void* arg) {
+    FileJob* j = (FileJob*)arg;
+    const BenchCase* c = j->c;
+    if (j->err || !j->packed) { j->err = 1; return; }
+
+    uint8_t* buf = j->packed;
+    size_t len = j->packed_len;
+    uint8_t* plain = NULL;      /* buffer propio si AES crea uno nuevo */
+    uint64_t t_file = now_ns();
+
+    if (c->enc == BENCH_ENC_VIG) {
+        vigenere_decrypt(buf, len, (const uint8_t*)BENCH_KEY, strlen(BENCH_KEY));
+    } else if (c->enc == BENCH_ENC_AES) {
+        if (aes_decrypt_buffer(buf, len, BENCH_KEY, &plain, &len) != 0) { j->err = 1; return; }
+        buf = plain;
+    }
+
+    uint8_t* out = NULL;
+    size_t out_len = 0;
+    int rc;
+    if (is_delta16(c->comp)) {
+        uint64_t t0 = now_ns();
+        rc = codec_wav_decompress(c->comp, buf, len, &out, &out_len);
+        if (rc == 0) lat_push(j->dlat, now_ns() - t0);
+    } else {
+        ChunkedOptions co = {
+            .nthreads = c->inner,
+            .on_chunk = on_chunk_done,
+            .chunk_ctx = j->dlat
+        };
+        rc = chunked_decompress(&co, buf, len, &out, &out_len);
+    }
+    free(plain);
+    j->d_ns = now_ns() - t_file;
+
+    if (rc != 0 || out_len != j->f->len || memcmp(out, j->f->data, out_len) != 0)
+        j->err = 1;
+    free(out);
+}
+
+/* Corre todos los jobs con un pool de 'workers' hilos; devuelve ns de pared */
+static uint64_t run_phase(FileJob* jobs, size_t n, size_t workers, tp_work_fn fn) {
+    uint64_t t0 = now_ns();
+    ThreadPool* tp = (workers > 1) ? tp_create(workers) : NULL;
+    for (size_t i = 0; i < n; i++) {
+        /* los más grandes primero, como en el modo carpeta */
+        if (!tp || tp_submit_prio(tp, fn, &jobs[i], jobs[i].f->len) != 0) fn(&jobs[i]);
+    }
+    if (tp) { tp_wait(tp); tp_destroy(tp); }
+    return now_ns() - t0;
+}
+
+static void run_case(const Corpus* cp, const BenchCase* bc, int warmup, int reps, BenchResult* r) {
+    memset(r, 0, sizeof(*r));
+    r->c = *bc;
+    r->ok = 1;
+
+    FileJob* jobs = calloc(cp->n, sizeof(FileJob));
+    uint64_t* c_ns = calloc((size_t)reps, sizeof(uint64_t));
+    uint64_t* d_ns = calloc((size_t)reps, sizeof(uint64_t));
+    uint64_t* t_ns = calloc((size_t)reps, sizeof(uint64_t));
+    if (!jobs || !c_ns || !d_ns || !t_ns) {
+        free(jobs); free(c_ns); free(d_ns); free(t_ns);
+        r->ok = 0;
+        return;
+    }
+
+    LatVec clat = {0}, dlat = {0};
+    pthread_mutex_init(&clat.mtx, NULL);
+    pthread_mutex_init(&dlat.mtx, NULL);
+
+    /* archivos que aplican (delta16 solo WAV) */
+    size_t n = 0;
+    for (size_t i = 0; i < cp->n; i++) {
+        if (is_delta16(bc->comp) && !cp->f[i].is_wav) continue;
+        jobs[n].c = bc;
+        jobs[n].f = &cp->f[i];
+        jobs[n].clat = &clat;
+        jobs[n].dlat = &dlat;
+        r->raw_bytes += cp->f[i].len;
+        r->by_group[cp->f[i].group].files++;
+        r->by_group[cp->f[i].group].raw_bytes += cp->f[i].len;
+        n++;
+    }
+    r->files = n;
+
+    rss_reset();
+    MemTotals m0, m1;
+    memtrack_reset_peak();
+    memtrack_get(&m0);
+    for (int it = 0; n > 0 && it < warmup + reps; it++) {
+        int measured = it >= warmup;
+        clat.on = dlat.on = measured;
+        for (size_t i = 0; i < n; i++) { jobs[i].err = 0; jobs[i].packed = NULL; jobs[i].packed_len = 0; }
+
+        ThreadPoolStats s0, s1;
+        tp_get_stats(NULL, &s0);
+        uint64_t tc = run_phase(jobs, n, bc->workers, job_compress);
+        uint64_t out_bytes = 0;
+        for (size_t i = 0; i < n; i++) out_bytes += jobs[i].packed_len;
+        uint64_t td = run_phase(jobs, n, bc->workers, job_decompress);
+        tp_get_stats(NULL, &s1);
+
+        for (size_t i = 0; i < n; i++) {
+            if (jobs[i].err) r->ok = 0;
+            free(jobs[i].packed);
+        }
+        if (measured) {
+            c_ns[it - warmup] = tc;
+            d_ns[it - warmup] = td;
+            t_ns[it - warmup] = tc + td;
+            if (r->n_samp < BASELINE_MAX_SAMPLES) {
+                double mb = (double)r->raw_bytes / (1024.0 * 1024.0);
+                r->c_samp[r->n_samp] = tc ? mb / ((double)tc / 1e9) : 0.0;
+                r->d_samp[r->n_samp] = td ? mb / ((double)td / 1e9) : 0.0;
+                r->n_samp++;
+            }
+            r->out_bytes = out_bytes;
+            r->wall_ns += tc + td;
+            r->pool.tasks        += s1.tasks - s0.tasks;
+            r->pool.task_ns      += s1.task_ns - s0.task_ns;
+            r->pool.lock_wait_ns += s1.lock_wait_ns - s0.lock_wait_ns;
+            r->pool.idle_ns      += s1.idle_ns - s0.idle_ns;
+            for (size_t g = 0; g < BENCH_MAX_GROUPS; g++) r->by_group[g].out_bytes = 0;
+            for (size_t i = 0; i < n; i++) {
+                BenchGroup* g = &r->by_group[jobs[i].f->group];
+                g->out_bytes += jobs[i].packed_len;
+                g->run_bytes += jobs[i].f->len;
+                g->c_ns += jobs[i].c_ns;
+                g->d_ns += jobs[i].d_ns;
+            }
+        }
+    }
+    r->rss_kb = rss_peak_kb();
+    memtrack_get(&m1);
+    r->heap_peak = m1.peak - m0.live;
+    r->allocs = m1.allocs - m0.allocs;
+
+    if (n > 0) {
+        qsort(t_ns, (size_t)reps, sizeof(uint64_t), cmp_u64);
+        r->med_ns = t_ns[reps / 2];
+        qsort(c_ns, (size_t)reps, sizeof(uint64_t), cmp_u64);
+        qsort(d_ns, (size_t)reps, sizeof(uint64_t), cmp_u64);
+        double mb = (double)r->raw_bytes / (1024.0 * 1024.0);
+        uint64_t cm = c_ns[reps / 2], dm = d_ns[reps / 2];
+        r->c_mbs = cm ? mb / ((double)cm / 1e9) : 0.0;
+        r->d_mbs = dm ? mb / ((double)dm / 1e9) : 0.0;
+        r->c_p50 = lat_pct_ms(&clat, 0.50);
+        r->c_p99 = lat_pct_ms(&clat, 0.99);
+        r->d_p50 = lat_pct_ms(&dlat, 0.50);
+        r->d_p99 = lat_pct_ms(&dlat, 0.99);
+    }
+
+    free(clat.v);
+    free(dlat.v);
+    pthread_mutex_destroy(&clat.mtx);
+    pthread_mutex_destroy(&dlat.mtx);
+    free(jobs);
+    free(c_ns);
+    free(d_ns);
+    free(t_ns);
+}
+
+/* ---------- Opciones ---------- */
+typedef struct {
+    const char* in_path;
+    const char* json_path;
+    const char* save_path;      /* --save-baseline */
+    const char* compare_path;   /* --compare */
+    double tolerance;           /* % para --compare */
+    int reps;
+    int warmup;
+    CompAlg comp[BENCH_MAX_LIST]; size_t n_comp;
+    int enc[BENCH_MAX_LIST];      size_t n_enc;
+    size_t workers[BENCH_MAX_LIST]; size_t n_workers;
+    size_t inner[BENCH_MAX_LIST];   size_t n_inner;
+    size_t chunk_mb[BENCH_MAX_LIST]; size_t n_chunk;
+    int comp_given, enc_given;
+    int scaling;            /* --scaling: barrido de hilos */
+    size_t max_threads;     /* N del barrido (default: CPUs disponibles) */
+} BenchConfig;
+
+static int parse_comp(const char* s, CompAlg* out) {
+    for (int a = COMP_RLEVAR; a <= COMP_DELTA16_HUFF; a++)
+        if (strcmp(s, codec_name((CompAlg)a)) == 0) { *out = (CompAlg)a; return 0; }
+    return -1;
+}
+
+static int parse_enc(const char* s, int* out) {
+    if (strcmp(s, "none") == 0)     { *out = BENCH_ENC_NONE; return 0; }
+    if (strcmp(s, "vigenere") == 0) { *out = BENCH_ENC_VIG; return 0; }
+#ifndef NO_OPENSSL
+    if (strcmp(s, "aes") == 0)      { *out = BENCH_ENC_AES; return 0; }
+#endif
+    return -1;
+}
+
+/* "1,4,auto" -> lista de hilos (auto = CPUs disponibles). Los repetidos
+ * (ej: auto = 1 en una máquina de 1 CPU) se descartan: cada fila de la
+ * matriz tiene que ser única o --compare las confunde. */
+static int parse_sizes(const char* s, size_t* out, size_t* n, int allow_auto) {
+    char* dup = strdup(s);
+    if (!dup) return -1;
+    *n = 0;
+    int rc = 0;
+    for (char* save = NULL, *tok = strtok_r(dup, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        if (*n == BENCH_MAX_LIST) { rc = -1; break; }
+        long v;
+        if (allow_auto && strcmp(tok, "auto") == 0) v = cpu_count_available();
+        else v = atol(tok);
+        if (v < 1) { rc = -1; break; }
+        size_t k = 0;
+        while (k < *n && out[k] != (size_t)v) k++;
+        if (k == *n) out[(*n)++] = (size_t)v;
+    }
+    free(dup);
+    return (rc == 0 && *n > 0) ? 0 : -1;
+}
+
+static int parse_names(const char* s, BenchConfig* bc, int is_comp) {
+    char* dup = strdup(s);
+    if (!dup) return -1;
+    int rc = 0;
+    size_t* n = is_comp ? &bc->n_comp : &bc->n_enc;
+    *n = 0;
+    for (char* save = NULL, *tok = strtok_r(dup, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        if (*n == BENCH_MAX_LIST) { rc = -1; break; }
+        int ok = is_comp ? parse_comp(tok, &bc->comp[*n]) : parse_enc(tok, &bc->enc[*n]);
+        if (ok != 0) { fprintf(stderr, "bench: algoritmo desconocido: %s\n", tok); rc = -1; break; }
+        size_t k = 0;   /* repetidos: una sola vez (ver parse_sizes) */
+        while (k < *n && (is_comp ? bc->comp[k] != bc->comp[*n] : bc->enc[k] != bc->enc[*n])) k++;
+        if (k == *n) (*n)++;
+    }
+    free(dup);
+    return (rc == 0 && *n > 0) ? 0 : -1;
+}
+
+static void bench_usage(void) {
+    fprintf(stderr,
+        "Uso: gsea bench -i <corpus> [opciones]\n"
+        "  --comp-alg L       lista separada por comas (default: todos)\n"
+        "  --enc-alg L        none,vigenere,aes (default: todos los disponibles)\n"
+        "  --workers L        hilos externos, ej: 1,4,auto (default: 1,auto)\n"
+        "  --inner-workers L  hilos por archivo para chunks (default: 1,auto)\n"
+        "  --chunk-mb L       tamaños de chunk en MB (default: 4,32)\n"
+        "  --reps N           corridas medidas (default: 3)\n"
+        "  --warmup N         corridas de calentamiento (default: 1)\n"
+        "  --json <archivo>   guarda resultados en JSON (\"-\" = stdout)\n"
+        "  --scaling          barrido de hilos 1,2,4..N: speedup, eficiencia y\n"
+        "                     tiempo en codecs / mutex del pool (default: lzw, none)\n"
+        "  --max-threads N    N del barrido (default: CPUs disponibles)\n"
+        "  --save-baseline F  guarda el JSON (commit, CPU, ajustes, muestras) como baseline\n"
+        "  --compare F        compara con un baseline; sale con 2 si hay regresión\n"
+        "  --tolerance PCT    caída tolerada en MB/s o ratio (default: 5)\n"
+        "  --perf-counters    IPC y fallos de caché / saltos por byte de cada codec\n");
+}
+
+static int bench_parse(int argc, char* argv[], BenchConfig* bc) {
+    memset(bc, 0, sizeof(*bc));
+    bc->reps = 3;
+    bc->warmup = 1;
+    bc->tolerance = 5.0;
+    parse_names("rlevar,lzw,lzw-pred,huffman-pred,delta16-lzw,delta16-huff", bc, 1);
+#ifdef NO_OPENSSL
+    parse_names("none,vigenere", bc, 0);
+#else
+    parse_names("none,vigenere,aes", bc, 0);
+#endif
+    parse_sizes("1,auto", bc->workers, &bc->n_workers, 1);
+    parse_sizes("1,auto", bc->inner, &bc->n_inner, 1);
+    parse_sizes("4,32", bc->chunk_mb, &bc->n_chunk, 0);
+
+    static struct option long_opts[] = {
+        {"comp-alg",      required_argument, 0, 1},
+        {"enc-alg",       required_argument, 0, 2},
+        {"workers",       required_argument, 0, 3},
+        {"inner-workers", required_argument, 0, 4},
+        {"chunk-mb",      required_argument, 0, 5},
+        {"reps",          required_argument, 0, 6},
+        {"warmup",        required_argument, 0, 7},
+        {"json",          required_argument, 0, 8},
+        {"scaling",       no_argument,       0, 9},
+        {"max-threads",   required_argument, 0, 10},
+        {"save-baseline", required_argument, 0, 11},
+        {"compare",       required_argument, 0, 12},
+        {"tolerance",     required_argument, 0, 13},
+        {"perf-counters", no_argument,       0, 14},
+        {0,0,0,0}
+    };
+
+    optind = 1;
+    int opt, idx = 0;
+    while ((opt = getopt_long(argc, argv, "i:", long_opts, &idx)) != -1) {
+        int rc = 0;
+        switch (opt) {
+            case 'i': bc->in_path = optarg; break;
+            case 1: rc = parse_names(optarg, bc, 1); bc->comp_given = 1; break;
+            case 2: rc = parse_names(optarg, bc, 0); bc->enc_given = 1; break;
+            case 3: rc = parse_sizes(optarg, bc->workers, &bc->n_workers, 1); break;
+            case 4: rc = parse_sizes(optarg, bc->inner, &bc->n_inner, 1); break;
+            case 5: rc = parse_sizes(optarg, bc->chunk_mb, &bc->n_chunk, 0); break;
+            case 6: bc->reps = atoi(optarg); rc = (bc->reps < 1) ? -1 : 0; break;
+            case 7: bc->warmup = atoi(optarg); rc = (bc->warmup < 0) ? -1 : 0; break;
+            case 8: bc->json_path = optarg; break;
+            case 9: bc->scaling = 1; break;
+            case 10: {
+                size_t v[BENCH_MAX_LIST], nv = 0;
+                rc = parse_sizes(optarg, v, &nv, 1);
+                if (rc == 0) bc->max_threads = v[nv - 1];
+                break;
+            }
+            case 11: bc->save_path = optarg; break;
+            case 12: bc->compare_path = optarg; break;
+            case 13: bc->tolerance = atof(optarg); rc = (bc->tolerance < 0) ? -1 : 0; break;
+            case 14: perfctr_enable(); break;
+            default: rc = -1; break;
+        }
+        if (rc != 0) { bench_usage(); return -1; }
+    }
+    if (!bc->in_path) { bench_usage(); return -1; }
+    if (bc->scaling) {
+        /* el barrido multiplica las corridas: por defecto una sola combinación */
+        if (!bc->comp_given) parse_names("lzw", bc, 1);
+        if (!bc->enc_given) parse_names("none", bc, 0);
+        if (bc->max_threads == 0) bc->max_threads = (size_t)cpu_count_available();
+    }
+    return 0;
+}
+
+/* ---------- Salida ---------- */
+static double group_mbs(const BenchGroup* g, uint64_t ns) {
+    return ns ? (double)g->run_bytes / (1024.0 * 1024.0) / ((double)ns / 1e9) : 0.0;
+}
+
+static void print_row(const Corpus* cp, const BenchResult* r) {
+    char chunk[16];
+    if (is_delta16(r->c.comp)) snprintf(chunk, sizeof(chunk), "-");
+    else snprintf(chunk, sizeof(chunk), "%zu", r->c.chunk_bytes / (1024 * 1024));
+    double ratio = r->out_bytes ? (double)r->raw_bytes / (double)r->out_bytes : 0.0;
+    printf("%-13s %-9s %3zu %3zu %5s | %8.2f %8.2f %6.2f | %8.3f %8.3f %8.3f %8.3f | %8.1f %s\n",
+           codec_name(r->c.comp), enc_name(r->c.enc), r->c.workers, r->c.inner, chunk,
+           r->c_mbs, r->d_mbs, ratio,
+           r->c_p50, r->c_p99, r->d_p50, r->d_p99,
+           r->rss_kb / 1024.0, r->ok ? "" : "ERROR");
+    if (memtrack_on())
+        printf("%45s heap: pico %.2f MB, %llu reservas\n", "",
+               (double)r->heap_peak / (1024.0 * 1024.0), (unsigned long long)r->allocs);
+    /* desglose por tipo (MB/s por archivo: sin el paralelismo entre archivos) */
+    for (size_t k = 0; cp->n_groups > 1 && k < cp->n_groups; k++) {
+        const BenchGroup* g = &r->by_group[k];
+        if (g->files == 0) continue;
+        printf("%45s %-8s %4zu arch %9.2f MB  ratio %6.2f  C %8.2f  D %8.2f MB/s\n", "",
+               cp->groups[k], g->files, g->raw_bytes / (1024.0 * 1024.0),
+               g->out_bytes ? (double)g->raw_bytes / (double)g->out_bytes : 0.0,
+               group_mbs(g, g->c_ns), group_mbs(g, g->d_ns));
+    }
+}
+
+static void write_samples(FILE* f, const char* key, const double* v, size_t n) {
+    fprintf(f, "\"%s\": [", key);
+    for (size_t i = 0; i < n; i++) fprintf(f, "%s%.3f", i ? ", " : "", v[i]);
+    fprintf(f, "]");
+}
+
+/* Línea de cabecera "key": "valor", con el valor escapado */
+static void write_str(FILE* f, const char* key, const char* v) {
+    char esc[4096];
+    json_escape(esc, sizeof(esc), v);
+    fprintf(f, "  \"%s\": \"%s\",\n", key, esc);
+}
+
+static void write_groups(FILE* f, const Corpus* cp, const BenchResult* r) {
+    fprintf(f, "\"by_type\": [");
+    int first = 1;
+    for (size_t k = 0; k < cp->n_groups; k++) {
+        const BenchGroup* g = &r->by_group[k];
+        if (g->files == 0) continue;
+        char esc[128];
+        json_escape(esc, sizeof(esc), cp->groups[k]);
+        fprintf(f, "%s{\"type\": \"%s\", \"files\": %zu, \"raw_bytes\": %llu, \"out_bytes\": %llu, "
+                "\"ratio\": %.4f, \"compress_mbs\": %.3f, \"decompress_mbs\": %.3f}",
+                first ? "" : ", ", esc, g->files,
+                (unsigned long long)g->raw_bytes, (unsigned long long)g->out_bytes,
+                g->out_bytes ? (double)g->raw_bytes / (double)g->out_bytes : 0.0,
+                group_mbs(g, g->c_ns), group_mbs(g, g->d_ns));
+        first = 0;
+    }
+    fprintf(f, "]");
+}
+
+static void write_json(FILE* f, const BenchConfig* bc, const BaselineMeta* host,
+                       const Corpus* cp, const BenchResult* rs, size_t n) {
+    fprintf(f, "{\n");
+    write_str(f, "commit", host->commit);
+    write_str(f, "cpu_model", host->cpu_model);
+    write_str(f, "corpus", bc->in_path);
+    fprintf(f, "  \"files\": %zu,\n", cp->n);
+    fprintf(f, "  \"bytes\": %llu,\n", (unsigned long long)cp->bytes);
+    fprintf(f, "  \"reps\": %d,\n  \"warmup\": %d,\n", bc->reps, bc->warmup);
+    fprintf(f, "  \"cpus\": %d,\n", cpu_count_available());
+    fprintf(f, "  \"results\": [\n");
+    for (size_t i = 0; i < n; i++) {
+        const BenchResult* r = &rs[i];
+        double ratio = r->out_bytes ? (double)r->raw_bytes / (double)r->out_bytes : 0.0;
+        fprintf(f,
+            "    {\"comp\": \"%s\", \"enc\": \"%s\", \"workers\": %zu, \"inner_workers\": %zu, "
+            "\"chunk_mb\": %zu, \"files\": %zu, \"raw_bytes\": %llu, \"out_bytes\": %llu, "
+            "\"ratio\": %.4f, \"compress_mbs\": %.3f, \"decompress_mbs\": %.3f, "
+            "\"chunk_ms\": {\"compress_p50\": %.4f, \"compress_p99\": %.4f, "
+            "\"decompress_p50\": %.4f, \"decompress_p99\": %.4f}, "
+            "\"peak_rss_kb\": %ld, \"ok\": %s, ",
+            codec_name(r->c.comp), enc_name(r->c.enc), r->c.workers, r->c.inner,
+            r->c.chunk_bytes / (1024 * 1024), r->files,
+            (unsigned long long)r->raw_bytes, (unsigned long long)r->out_bytes,
+            ratio, r->c_mbs, r->d_mbs, r->c_p50, r->c_p99, r->d_p50, r->d_p99,
+            r->rss_kb, r->ok ? "true" : "false");
+        if (memtrack_on())
+            fprintf(f, "\"heap_peak_bytes\": %lld, \"allocs\": %llu, ",
+                    (long long)r->heap_peak, (unsigned long long)r->allocs);
+        write_samples(f, "compress_samples_mbs", r->c_samp, r->n_samp);
+        fprintf(f, ", ");
+        write_samples(f, "decompress_samples_mbs", r->d_samp, r->n_samp);
+        fprintf(f, ", ");
+        write_groups(f, cp, r);
+        fprintf(f, "}%s\n", (i + 1 < n) ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+/* ---------- Barrido de hilos (--scaling) ---------- */
+typedef struct {
+    const char* scenario;   /* "outer" (pool de archivos) o "inner" (chunks) */
+    size_t threads;
+    BenchResult r;
+    double speedup, efficiency;
+} ScalePoint;
+
+/* 1, 2, 4, ... < max y luego max */
+static size_t scaling_counts(size_t max, size_t* out, size_t cap) {
+    size_t n = 0;
+    for (size_t t = 1; t < max && n + 1 < cap; t *= 2) out[n++] = t;
+    out[n++] = max;
+    return n;
+}
+
+/* Fracción del tiempo de hilo (pared × T) que el pool pasó en x. */
+static double pool_share(const ScalePoint* p, unsigned long long x) {
+    double total = (double)p->r.wall_ns * (double)p->threads;
+    return (p->threads > 1 && total > 0) ? 100.0 * (double)x / total : 0.0;
+}
+
+static void print_scale_row(const ScalePoint* p) {
+    const BenchResult* r = &p->r;
+    double mb = (double)r->raw_bytes / (1024.0 * 1024.0);
+    double ms = (double)r->med_ns / 1e6;
+    printf("%-6s %-13s %-9s %4zu | %10.2f %8.2f %7.2fx %6.1f%% | ",
+           p->scenario, codec_name(r->c.comp), enc_name(r->c.enc), p->threads,
+           ms, ms > 0 ? mb / (ms / 1e3) : 0.0, p->speedup, 100.0 * p->efficiency);
+    if (p->threads > 1)
+        printf("%6.1f%% %6.1f%% %6.1f%%", pool_share(p, r->pool.task_ns),
+               pool_share(p, r->pool.lock_wait_ns), pool_share(p, r->pool.idle_ns));
+    else
+        printf("%7s %7s %7s", "-", "-", "-");
+    printf(" %s\n", r->ok ? "" : "ERROR");
+}
+
+static void write_scaling_json(FILE* f, const BenchConfig* bc, const Corpus* cp,
+                               const ScalePoint* ps, size_t n) {
+    fprintf(f, "{\n");
+    write_str(f, "corpus", bc->in_path);
+    fprintf(f, "  \"files\": %zu,\n", cp->n);
+    fprintf(f, "  \"bytes\": %llu,\n", (unsigned long long)cp->bytes);
+    fprintf(f, "  \"reps\": %d,\n  \"warmup\": %d,\n", bc->reps, bc->warmup);
+    fprintf(f, "  \"cpus\": %d,\n", cpu_count_available());
+    fprintf(f, "  \"scaling\": [\n");
+    for (size_t i = 0; i < n; i++) {
+        const ScalePoint* p = &ps[i];
+        const BenchResult* r = &p->r;
+        fprintf(f,
+            "    {\"scenario\": \"%s\", \"comp\": \"%s\", \"enc\": \"%s\", \"threads\": %zu, "
+            "\"chunk_kb\": %zu, \"files\": %zu, \"raw_bytes\": %llu, \"median_ms\": %.3f, "
+            "\"speedup\": %.4f, \"efficiency\": %.4f, "
+            "\"pool\": {\"tasks\": %llu, \"task_ns\": %llu, \"lock_wait_ns\": %llu, \"idle_ns\": %llu}, "
+            "\"codec_pct\": %.2f, \"lock_wait_pct\": %.2f, \"idle_pct\": %.2f, \"ok\": %s}%s\n",
+            p->scenario, codec_name(r->c.comp), enc_name(r->c.enc), p->threads,
+            r->c.chunk_bytes / 1024, r->files, (unsigned long long)r->raw_bytes,
+            (double)r->med_ns / 1e6, p->speedup, p->efficiency,
+            r->pool.tasks, r->pool.task_ns, r->pool.lock_wait_ns, r->pool.idle_ns,
+            pool_share(p, r->pool.task_ns), pool_share(p, r->pool.lock_wait_ns),
+            pool_share(p, r->pool.idle_ns), r->ok ? "true" : "false", (i + 1 < n) ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+static int run_scaling(const BenchConfig* bc, const Corpus* cp) {
+    size_t counts[64];
+    size_t nc = scaling_counts(bc->max_threads, counts, 64);
+    size_t max_points = 2 * nc * bc->n_comp * bc->n_enc;
+    ScalePoint* ps = calloc(max_points, sizeof(ScalePoint));
+    if (!ps) return 1;
+
+    /* inner: el archivo más grande tiene que dar al menos max_threads
+     * chunks o el pool interno no tiene qué repartir. Si --chunk-mb no
+     * alcanza se achica el chunk (múltiplos de 64 KB); si ni así, el
+     * archivo es demasiado chico y no hay filas inner. */
+    size_t big = 0;
+    for (size_t i = 1; i < cp->n; i++) if (cp->f[i].len > cp->f[big].len) big = i;
+    size_t big_len = cp->f[big].len;
+    size_t inner_chunk = bc->chunk_mb[0] * 1024 * 1024;
+    size_t T = bc->max_threads;
+    if ((big_len + inner_chunk - 1) / inner_chunk < T) {
+        inner_chunk = (big_len / T) & ~(size_t)(SCALE_MIN_CHUNK - 1);
+        if (inner_chunk < SCALE_MIN_CHUNK) {
+            inner_chunk = 0;
+            fprintf(stderr, "bench: el archivo más grande (%s, %.2f MB) no llega a %zu chunks de %d KB; "
+                    "se omiten las filas inner\n", cp->f[big].name, big_len / (1024.0 * 1024.0),
+                    T, SCALE_MIN_CHUNK / 1024);
+        }
+    }
+
+    printf("Corpus: %s (%zu archivos, %.2f MB)  reps=%d warmup=%d  chunk=%zu MB\n",
+           bc->in_path, cp->n, cp->bytes / (1024.0 * 1024.0), bc->reps, bc->warmup, bc->chunk_mb[0]);
+    printf("outer: pool de archivos (inner = 1)\n");
+    if (inner_chunk)
+        printf("inner: pool de chunks de %s (%.2f MB, %zu chunks de %zu KB)\n", cp->f[big].name,
+               big_len / (1024.0 * 1024.0), (big_len + inner_chunk - 1) / inner_chunk, inner_chunk / 1024);
+    printf("codec/mutex/idle: %% del tiempo de hilo (pared x T) en tareas, esperando el mutex y sin trabajo\n\n");
+    printf("%-6s %-13s %-9s %4s | %10s %8s %8s %7s | %7s %7s %7s\n",
+           "modo", "comp", "enc", "T", "med ms", "MB/s", "speedup", "efic",
+           "codec", "mutex", "idle");
+    printf("------------------------------------------------------------------------"
+           "-----------------------------\n");
+
+    size_t n = 0;
+    int failed = 0;
+    for (size_t a = 0; a < bc->n_comp; a++)
+    for (size_t e = 0; e < bc->n_enc; e++)
+    for (int inner = 0; inner < 2; inner++) {
+        Corpus one;
+        const Corpus* use = cp;
+        if (inner) {
+            /* delta16 no parte en chunks: no hay pool interno que medir */
+            if (is_delta16(bc->comp[a]) || !inner_chunk) continue;
+            memset(&one, 0, sizeof(one));
+            one.f = &cp->f[big];
+            one.n = 1;
+            one.bytes = cp->f[big].len;
+            use = &one;
+        }
+        size_t base = n;
+        for (size_t k = 0; k < nc; k++) {
+            BenchCase c = {
+                .comp = bc->comp[a],
+                .enc = bc->enc[e],
+                .workers = inner ? 1 : counts[k],
+                .inner = inner ? counts[k] : 1,
+                .chunk_bytes = inner ? inner_chunk : bc->chunk_mb[0] * 1024 * 1024
+            };
+            ScalePoint* p = &ps[n];
+            p->scenario = inner ? "inner" : "outer";
+            p->threads = counts[k];
+            run_case(use, &c, bc->warmup, bc->reps, &p->r);
+            if (p->r.files == 0) break;
+            p->speedup = p->r.med_ns ? (double)ps[base].r.med_ns / (double)p->r.med_ns : 0.0;
+            p->efficiency = p->speedup / (double)p->threads;
+            if (!p->r.ok) failed = 1;
+            print_scale_row(p);
+            fflush(stdout);
+            n++;
+        }
+    }
+
+    if (bc->json_path) {
+        FILE* f = strcmp(bc->json_path, "-") == 0 ? stdout : fopen(bc->json_path, "w");
+        if (!f) {
+            fprintf(stderr, "bench: no se pudo escribir %s\n", bc->json_path);
+            failed = 1;
+        } else {
+            write_scaling_json(f, bc, cp, ps, n);
+            if (f != stdout) { fclose(f); printf("\nJSON: %s\n", bc->json_path); }
+        }
+    }
+    free(ps);
+    return failed ? 1 : 0;
+}
+
+/* ---------- Baseline (--compare) ---------- */
+/* Devuelve el número de regresiones o -1 si no se pudo leer el baseline. */
+static int compare_baseline(const BenchConfig* bc, const BaselineMeta* host,
+                            const BenchResult* rs, size_t n) {
+    BaselineMeta bm;
+    BaselineEntry* base = NULL;
+    size_t nb = 0;
+    if (baseline_load(bc->compare_path, &bm, &base, &nb) != 0) {
+        fprintf(stderr, "bench: no se pudo leer el baseline %s\n", bc->compare_path);
+        return -1;
+    }
+    BaselineEntry* cur = calloc(n ? n : 1, sizeof(BaselineEntry));
+    if (!cur) { free(base); return -1; }
+    for (size_t i = 0; i < n; i++) {
+        const BenchResult* r = &rs[i];
+        BaselineEntry* e = &cur[i];
+        snprintf(e->comp, sizeof(e->comp), "%s", codec_name(r->c.comp));
+        snprintf(e->enc, sizeof(e->enc), "%s", enc_name(r->c.enc));
+        e->workers = r->c.workers;
+        e->inner = r->c.inner;
+        e->chunk_mb = r->c.chunk_bytes / (1024 * 1024);
+        e->ratio = r->out_bytes ? (double)r->raw_bytes / (double)r->out_bytes : 0.0;
+        memcpy(e->c_mbs, r->c_samp, r->n_samp * sizeof(double));
+        memcpy(e->d_mbs, r->d_samp, r->n_samp * sizeof(double));
+        e->n_c = e->n_d = r->n_samp;
+    }
+    int reg = baseline_compare(&bm, base, nb, host, cur, n, bc->tolerance);
+    free(cur);
+    free(base);
+    return reg;
+}
+
+int bench_main(int argc, char* argv[]) {
+    BenchConfig bc;
+    if (bench_parse(argc, argv, &bc) != 0) return 1;
+
+    Corpus cp;
+    if (corpus_load(&cp, bc.in_path) != 0) {
+        fprintf(stderr, "bench: no se pudo cargar el corpus %s\n", bc.in_path);
+        corpus_free(&cp);
+        return 1;
+    }
+
+    if (bc.scaling) {
+        int rc = run_scaling(&bc, &cp);
+        corpus_free(&cp);
+        return rc;
+    }
+
+    size_t max_cases = bc.n_comp * bc.n_enc * bc.n_workers * bc.n_inner * bc.n_chunk;
+    BenchResult* rs = calloc(max_cases ? max_cases : 1, sizeof(BenchResult));
+    if (!rs) { corpus_free(&cp); return 1; }
+
+    printf("Corpus: %s (%zu archivos, %.2f MB)  reps=%d warmup=%d\n\n",
+           bc.in_path, cp.n, cp.bytes / (1024.0 * 1024.0), bc.reps, bc.warmup);
+    printf("%-13s %-9s %3s %3s %5s | %8s %8s %6s | %8s %8s %8s %8s | %8s\n",
+           "comp", "enc", "W", "IW", "chMB", "C MB/s", "D MB/s", "ratio",
+           "c p50ms", "c p99ms", "d p50ms", "d p99ms", "RSS MB");
+    printf("---------------------------------------------------------------------------"
+           "--------------------------------------------\n");
+
+    size_t n = 0;
+    int failed = 0;
+    for (size_t a = 0; a < bc.n_comp; a++)
+    for (size_t e = 0; e < bc.n_enc; e++)
+    for (size_t w = 0; w < bc.n_workers; w++)
+    for (size_t iw = 0; iw < bc.n_inner; iw++)
+    for (size_t ch = 0; ch < bc.n_chunk; ch++) {
+        /* delta16 no usa chunks: una sola fila por (workers, inner) */
+        if (is_delta16(bc.comp[a]) && ch > 0) continue;
+        BenchCase c = {
+            .comp = bc.comp[a],
+            .enc = bc.enc[e],
+            .workers = bc.workers[w],
+            .inner = bc.inner[iw],
+            .chunk_bytes = bc.chunk_mb[ch] * 1024 * 1024
+        };
+        run_case(&cp, &c, bc.warmup, bc.reps, &rs[n]);
+        if (rs[n].files == 0) continue; /* ej: delta16 sin WAV en el corpus */
+        if (!rs[n].ok) failed = 1;
+        print_row(&cp, &rs[n]);
+        fflush(stdout);
+        n++;
+    }
+
+    BaselineMeta host = {0};
+    baseline_host(&host);
+    snprintf(host.corpus, sizeof(host.corpus), "%s", bc.in_path);
+    host.bytes = (unsigned long long)cp.bytes;
+    host.reps = bc.reps;
+    host.warmup = bc.warmup;
+
+    const char* outs[2] = { bc.json_path, bc.save_path };
+    for (int o = 0; o < 2; o++) {
+        if (!outs[o]) continue;
+        FILE* f = strcmp(outs[o], "-") == 0 ? stdout : fopen(outs[o], "w");
+        if (!f) {
+            fprintf(stderr, "bench: no se pudo escribir %s\n", outs[o]);
+            failed = 1;
+        } else {
+            write_json(f, &bc, &host, &cp, rs, n);
+            if (f != stdout) { fclose(f); printf("\n%s: %s\n", o ? "Baseline" : "JSON", outs[o]); }
+        }
+    }
+
+    int regressions = 0;
+    if (bc.compare_path) regressions = compare_baseline(&bc, &host, rs, n);
+
+    free(rs);
+    corpus_free(&cp);
+    if (failed || regressions < 0) return 1;
+    return regressions > 0 ? 2 : 0;
+}
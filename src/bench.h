@@ -0,0 +1,18 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Subcomando "gsea bench": recorre la matriz algoritmo de compresión ×
+ * cifrado × workers × inner-workers × chunk-mb sobre un corpus y reporta
+ * MB/s, ratio, latencia p50/p99 por chunk y RSS pico (tabla + JSON).
+ * argv[0] es "bench". Devuelve el código de salida del proceso. */
+int bench_main(int argc, char* argv[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BENCH_H */
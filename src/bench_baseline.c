@@ -0,0 +1,280 @@
+/* =============================================================
+ * bench_baseline.c - Baselines de "gsea bench" y comparación
+ * -------------------------------------------------------------
+ * Un baseline es el mismo JSON que escribe "gsea bench --json":
+ * lleva commit, modelo de CPU y ajustes (corpus, reps, warmup) y por
+ * cada combinación las MB/s de cada corrida medida. "--compare"
+ * lo vuelve a leer y, fila por fila (misma comp, enc, workers,
+ * inner-workers y chunk-mb), decide si hay regresión:
+ *   - MB/s: la media baja más de la tolerancia Y un t-test de Welch
+ *     unilateral al 95 % dice que la baja no es ruido (con 1 sola
+ *     corrida por lado solo se aplica la tolerancia).
+ *   - ratio: es determinista, basta con la tolerancia.
+ * El lector no es un parser JSON general: espera una fila por línea,
+ * como la escribe bench.c.
+ * ============================================================= */
+#include "bench_baseline.h"
+#include "fs.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ---------- Máquina actual ---------- */
+static void chomp(char* s) {
+    size_t n = strlen(s);
+    while (n > 0 && (s[n - 1] == '\n' || s[n - 1] == '\r' || s[n - 1] == ' ')) s[--n] = '\0';
+}
+
+void baseline_host(BaselineMeta* m) {
+    snprintf(m->commit, sizeof(m->commit), "unknown");
+    snprintf(m->cpu_model, sizeof(m->cpu_model), "unknown");
+
+    const char* env = getenv("GSEA_COMMIT");
+    if (env && *env) {
+        snprintf(m->commit, sizeof(m->commit), "%s", env);
+    } else {
+        FILE* p = popen("git rev-parse --short HEAD 2>/dev/null", "r");
+        if (p) {
+            char line[64];
+            if (fgets(line, sizeof(line), p)) {
+                chomp(line);
+                if (*line) snprintf(m->commit, sizeof(m->commit), "%s", line);
+            }
+            pclose(p);
+        }
+    }
+
+    FILE* f = fopen("/proc/cpuinfo", "r");
+    if (f) {
+        char line[256];
+        while (fgets(line, sizeof(line), f)) {
+            if (strncmp(line, "model name", 10) != 0) continue;
+            char* v = strchr(line, ':');
+            if (!v) continue;
+            v++;
+            while (*v == ' ' || *v == '\t') v++;
+            chomp(v);
+            snprintf(m->cpu_model, sizeof(m->cpu_model), "%s", v);
+            break;
+        }
+        fclose(f);
+    }
+}
+
+/* ---------- Lectura del JSON (una fila por línea) ---------- */
+/* Devuelve el valor de "key": dentro de la línea, o NULL. */
+static const char* json_val(const char* s, const char* key) {
+    char pat[64];
+    snprintf(pat, sizeof(pat), "\"%s\":", key);
+    const char* p = strstr(s, pat);
+    if (!p) return NULL;
+    p += strlen(pat);
+    while (*p == ' ') p++;
+    return p;
+}
+
+static int json_str(const char* s, const char* key, char* out, size_t cap) {
+    const char* p = json_val(s, key);
+    if (!p || *p != '"') return -1;
+    p++;
+    size_t n = 0;
+    while (*p && *p != '"' && n + 1 < cap) {
+        if (*p == '\\' && p[1]) p++;   /* \" y \\ de json_escape */
+        out[n++] = *p++;
+    }
+    out[n] = '\0';
+    return 0;
+}
+
+static double json_num(const char* s, const char* key, double def) {
+    const char* p = json_val(s, key);
+    return p ? strtod(p, NULL) : def;
+}
+
+static size_t json_arr(const char* s, const char* key, double* out, size_t max) {
+    const char* p = json_val(s, key);
+    if (!p || *p != '[') return 0;
+    p++;
+    size_t n = 0;
+    while (*p && *p != ']' && n < max) {
+        char* end;
+        double v = strtod(p, &end);
+        if (end == p) break;
+        out[n++] = v;
+        p = end;
+        while (*p == ',' || *p == ' ') p++;
+    }
+    return n;
+}
+
+int baseline_load(const char* path, BaselineMeta* meta, BaselineEntry** out, size_t* n) {
+    uint8_t* buf = NULL;
+    size_t len = 0;
+    *out = NULL;
+    *n = 0;
+    memset(meta, 0, sizeof(*meta));
+    if (read_file(path, &buf, &len) != 0) return -1;
+
+    char* text = malloc(len + 1);
+    if (!text) { free(buf); return -1; }
+    memcpy(text, buf, len);
+    text[len] = '\0';
+    free(buf);
+
+    BaselineEntry* v = NULL;
+    size_t cnt = 0, cap = 0;
+    int rc = 0;
+    for (char* save = NULL, *line = strtok_r(text, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        if (!json_val(line, "comp")) {
+            /* cabecera: una clave por línea */
+            json_str(line, "commit", meta->commit, sizeof(meta->commit));
+            json_str(line, "cpu_model", meta->cpu_model, sizeof(meta->cpu_model));
+            json_str(line, "corpus", meta->corpus, sizeof(meta->corpus));
+            if (json_val(line, "bytes")) meta->bytes = (unsigned long long)json_num(line, "bytes", 0);
+            if (json_val(line, "reps")) meta->reps = (int)json_num(line, "reps", 0);
+            if (json_val(line, "warmup")) meta->warmup = (int)json_num(line, "warmup", 0);
+            continue;
+        }
+        if (cnt == cap) {
+            size_t nc = cap ? cap * 2 : 32;
+            BaselineEntry* t = realloc(v, nc * sizeof(BaselineEntry));
+            if (!t) { rc = -1; break; }
+            v = t;
+            cap = nc;
+        }
+        BaselineEntry* e = &v[cnt];
+        memset(e, 0, sizeof(*e));
+        json_str(line, "comp", e->comp, sizeof(e->comp));
+        json_str(line, "enc", e->enc, sizeof(e->enc));
+        e->workers = (size_t)json_num(line, "workers", 0);
+        e->inner = (size_t)json_num(line, "inner_workers", 0);
+        e->chunk_mb = (size_t)json_num(line, "chunk_mb", 0);
+        e->ratio = json_num(line, "ratio", 0);
+        e->n_c = json_arr(line, "compress_samples_mbs", e->c_mbs, BASELINE_MAX_SAMPLES);
+        e->n_d = json_arr(line, "decompress_samples_mbs", e->d_mbs, BASELINE_MAX_SAMPLES);
+        /* JSON sin muestras (versión anterior): la mediana como única muestra */
+        if (e->n_c == 0) { e->c_mbs[0] = json_num(line, "compress_mbs", 0); e->n_c = 1; }
+        if (e->n_d == 0) { e->d_mbs[0] = json_num(line, "decompress_mbs", 0); e->n_d = 1; }
+        cnt++;
+    }
+    free(text);
+    if (rc != 0 || cnt == 0) { free(v); return -1; }
+    *out = v;
+    *n = cnt;
+    return 0;
+}
+
+/* ---------- Estadística ---------- */
+static double dsqrt(double x) {
+    if (x <= 0) return 0.0;
+    double r = x > 1 ? x : 1.0;
+    for (int i = 0; i < 64; i++) {
+        double nr = 0.5 * (r + x / r);
+        if (nr == r) break;
+        r = nr;
+    }
+    return r;
+}
+
+static void mean_var(const double* x, size_t n, double* mean, double* var) {
+    double s = 0;
+    for (size_t i = 0; i < n; i++) s += x[i];
+    *mean = n ? s / (double)n : 0.0;
+    double q = 0;
+    for (size_t i = 0; i < n; i++) q += (x[i] - *mean) * (x[i] - *mean);
+    *var = n > 1 ? q / (double)(n - 1) : 0.0;
+}
+
+/* t crítico unilateral al 95 % para df grados de libertad (tabla). */
+static double t_crit_95(double df) {
+    static const double tab[] = {
+        0, 6.314, 2.920, 2.353, 2.132, 2.015, 1.943, 1.895, 1.860, 1.833, 1.812,
+        1.796, 1.782, 1.771, 1.761, 1.753, 1.746, 1.740, 1.734, 1.729, 1.725
+    };
+    if (df < 1) return tab[1];
+    if (df <= 20) return tab[(int)df];
+    if (df <= 30) return 1.697;
+    if (df <= 60) return 1.671;
+    return 1.645;
+}
+
+/* ¿La media de 'cur' es significativamente menor que la de 'base'?
+ * Welch: no asume varianzas iguales. */
+static int welch_slower(const double* base, size_t nb, const double* cur, size_t nc) {
+    if (nb < 2 || nc < 2) return 1;     /* sin varianza: decide la tolerancia */
+    double mb, vb, mc, vc;
+    mean_var(base, nb, &mb, &vb);
+    mean_var(cur, nc, &mc, &vc);
+    double sb = vb / (double)nb, sc = vc / (double)nc;
+    double se2 = sb + sc;
+    if (se2 <= 0) return mc < mb;
+    double t = (mb - mc) / dsqrt(se2);
+    double df = se2 * se2 / (sb * sb / (double)(nb - 1) + sc * sc / (double)(nc - 1));
+    return t > t_crit_95(df);
+}
+
+static double mean_of(const double* x, size_t n) {
+    double m, v;
+    mean_var(x, n, &m, &v);
+    return m;
+}
+
+static double pct(double base, double cur) {
+    return base > 0 ? 100.0 * (cur - base) / base : 0.0;
+}
+
+/* ---------- Comparación ---------- */
+static const BaselineEntry* find_entry(const BaselineEntry* v, size_t n, const BaselineEntry* k) {
+    for (size_t i = 0; i < n; i++) {
+        if (strcmp(v[i].comp, k->comp) == 0 && strcmp(v[i].enc, k->enc) == 0 &&
+            v[i].workers == k->workers && v[i].inner == k->inner && v[i].chunk_mb == k->chunk_mb)
+            return &v[i];
+    }
+    return NULL;
+}
+
+int baseline_compare(const BaselineMeta* bm, const BaselineEntry* base, size_t nb,
+                     const BaselineMeta* cm, const BaselineEntry* cur, size_t nc,
+                     double tol_pct) {
+    printf("\nBaseline: commit %s, CPU %s\n", bm->commit, bm->cpu_model);
+    printf("Actual:   commit %s, CPU %s\n", cm->commit, cm->cpu_model);
+    if (strcmp(bm->cpu_model, cm->cpu_model) != 0)
+        printf("aviso: CPU distinta, los MB/s no son comparables directamente\n");
+    if (bm->bytes != cm->bytes || strcmp(bm->corpus, cm->corpus) != 0)
+        printf("aviso: corpus distinto (%s, %llu B vs %s, %llu B)\n",
+               bm->corpus, bm->bytes, cm->corpus, cm->bytes);
+    printf("Tolerancia: %.1f %%  (MB/s: t-test de Welch unilateral 95 %%)\n\n", tol_pct);
+    printf("%-13s %-9s %3s %3s %5s | %9s %9s | %9s %9s | %8s | %s\n",
+           "comp", "enc", "W", "IW", "chMB", "C base", "C dif%", "D base", "D dif%", "ratio%", "estado");
+
+    int regressions = 0;
+    double tol = tol_pct / 100.0;
+    for (size_t i = 0; i < nc; i++) {
+        const BaselineEntry* c = &cur[i];
+        const BaselineEntry* b = find_entry(base, nb, c);
+        if (!b) {
+            printf("%-13s %-9s %3zu %3zu %5zu | (sin fila en el baseline)\n",
+                   c->comp, c->enc, c->workers, c->inner, c->chunk_mb);
+            continue;
+        }
+        double cb = mean_of(b->c_mbs, b->n_c), cc = mean_of(c->c_mbs, c->n_c);
+        double db = mean_of(b->d_mbs, b->n_d), dc = mean_of(c->d_mbs, c->n_d);
+
+        char why[64] = "";
+        if (cc < cb * (1.0 - tol) && welch_slower(b->c_mbs, b->n_c, c->c_mbs, c->n_c))
+            strcat(why, " compresión");
+        if (dc < db * (1.0 - tol) && welch_slower(b->d_mbs, b->n_d, c->d_mbs, c->n_d))
+            strcat(why, " descompresión");
+        if (c->ratio < b->ratio * (1.0 - tol))
+            strcat(why, " ratio");
+        if (*why) regressions++;
+
+        printf("%-13s %-9s %3zu %3zu %5zu | %9.2f %+8.1f%% | %9.2f %+8.1f%% | %+7.1f%% | %s%s\n",
+               c->comp, c->enc, c->workers, c->inner, c->chunk_mb,
+               cb, pct(cb, cc), db, pct(db, dc), pct(b->ratio, c->ratio),
+               *why ? "REGRESIÓN:" : "ok", why);
+    }
+    printf("\n%d regresión(es)\n", regressions);
+    return regressions;
+}
@@ -0,0 +1,57 @@
+#ifndef BENCH_BASELINE_H
+#define BENCH_BASELINE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Muestras guardadas por combinación (una por corrida medida). */
+#define BASELINE_MAX_SAMPLES 64
+
+/* Datos de la corrida que identifican un baseline. */
+typedef struct {
+    char commit[64];        /* git rev-parse --short HEAD (o $GSEA_COMMIT) */
+    char cpu_model[128];    /* "model name" de /proc/cpuinfo */
+    char corpus[256];
+    unsigned long long bytes;
+    int reps;
+    int warmup;
+} BaselineMeta;
+
+/* Una fila de "gsea bench": clave (comp, enc, workers, inner, chunk_mb)
+ * + ratio + MB/s de cada corrida medida. */
+typedef struct {
+    char comp[24];
+    char enc[16];
+    size_t workers;
+    size_t inner;
+    size_t chunk_mb;
+    double ratio;
+    double c_mbs[BASELINE_MAX_SAMPLES];
+    size_t n_c;
+    double d_mbs[BASELINE_MAX_SAMPLES];
+    size_t n_d;
+} BaselineEntry;
+
+/* Rellena commit y cpu_model de la máquina actual ("unknown" si no hay). */
+void baseline_host(BaselineMeta* m);
+
+/* Lee un JSON escrito por "gsea bench --json/--save-baseline".
+ * *out se reserva con malloc. 0 = ok, -1 = error. */
+int baseline_load(const char* path, BaselineMeta* meta, BaselineEntry** out, size_t* n);
+
+/* Compara la corrida actual con el baseline e imprime un reporte.
+ * Regresión = la media de MB/s baja más de tol_pct % y el t-test de
+ * Welch (unilateral, 95 %) la confirma, o el ratio baja más de tol_pct %.
+ * Devuelve el número de regresiones encontradas. */
+int baseline_compare(const BaselineMeta* bm, const BaselineEntry* base, size_t nb,
+                     const BaselineMeta* cm, const BaselineEntry* cur, size_t nc,
+                     double tol_pct);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BENCH_BASELINE_H */
@@ -0,0 +1,105 @@
+/* =============================================================
+ * bigbuf.c - Buffers grandes con huge pages y ubicación NUMA
+ * -------------------------------------------------------------
+ * Con chunks de 100 MB+ los bucles de los codecs recorren cientos de
+ * miles de páginas de 4 KB: la TLB no alcanza y cada fallo es un
+ * recorrido de la tabla de páginas. Aquí:
+ *   - bigbuf_alloc alinea a 2 MB (posix_memalign; glibc lo sirve con
+ *     mmap a partir de este tamaño) y marca el rango con MADV_HUGEPAGE,
+ *     así con THP en modo "madvise" el kernel usa páginas de 2 MB.
+ *     Las páginas no se tocan al reservar: la primera escritura la
+ *     hace el worker que procesa cada chunk (first touch), y con la
+ *     política por defecto quedan en su nodo NUMA.
+ *   - --numa: además, antes de escribir su parte, el worker hace mbind
+ *     del rango a su nodo (MPOL_PREFERRED + MPOL_MF_MOVE): vale también
+ *     para memoria reciclada que ya tocó otro hilo en otro socket.
+ * Se libera con free(), así los buffers siguen pasando entre módulos
+ * como cualquier malloc. Si mbind falla (kernel sin NUMA, seccomp) se
+ * avisa una vez y --numa queda apagado.
+ * ============================================================= */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "bigbuf.h"
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#endif
+
+#define HUGE_PAGE ((size_t)2 * 1024 * 1024)
+
+static atomic_int g_numa;
+
+void* bigbuf_alloc(size_t n) {
+    if (n < BIGBUF_MIN) return malloc(n ? n : 1);
+    void* p = NULL;
+    if (posix_memalign(&p, HUGE_PAGE, n) != 0) return NULL;
+#ifdef MADV_HUGEPAGE
+    /* sin THP (o en modo "never") es solo un aviso que se ignora */
+    size_t len = n & ~(HUGE_PAGE - 1);
+    if (len) madvise(p, len, MADV_HUGEPAGE);
+#endif
+    return p;
+}
+
+void bigbuf_set_numa(int on) {
+    atomic_store(&g_numa, on ? 1 : 0);
+}
+
+int bigbuf_numa_on(void) {
+    return atomic_load_explicit(&g_numa, memory_order_relaxed);
+}
+
+void bigbuf_bind_local(void* p, size_t n) {
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_getcpu)
+    if (!bigbuf_numa_on() || !p) return;
+    /* mbind trabaja con páginas enteras: solo las que caen dentro */
+    uintptr_t pg = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t a = ((uintptr_t)p + pg - 1) & ~(pg - 1);
+    uintptr_t b = ((uintptr_t)p + n) & ~(pg - 1);
+    if (b <= a) return;
+
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0) return;
+    unsigned long mask[16];
+    if (node >= sizeof(mask) * 8) return;
+    memset(mask, 0, sizeof(mask));
+    mask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+
+    if (syscall(SYS_mbind, (void*)a, (unsigned long)(b - a), MPOL_PREFERRED,
+                mask, (unsigned long)(sizeof(mask) * 8), MPOL_MF_MOVE) != 0) {
+        int err = errno;
+        if (atomic_exchange(&g_numa, 0))
+            fprintf(stderr, "aviso: --numa: mbind no disponible (%s), se desactiva\n", strerror(err));
+    }
+#else
+    (void)p; (void)n;
+#endif
+}
+
+const char* bigbuf_thp_mode(void) {
+    static const char* modes[] = { "always", "madvise", "never" };
+    char line[128];
+    FILE* f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (!f) return "n/d";
+    const char* r = "n/d";
+    if (fgets(line, sizeof(line), f)) {
+        /* el modo activo va entre corchetes: "always [madvise] never" */
+        for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+            char pat[16];
+            snprintf(pat, sizeof(pat), "[%s]", modes[i]);
+            if (strstr(line, pat)) { r = modes[i]; break; }
+        }
+    }
+    fclose(f);
+    return r;
+}
@@ -0,0 +1,38 @@
+#ifndef BIGBUF_H
+#define BIGBUF_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Buffers grandes (entrada de un archivo, región de chunks, salida de
+ * la descompresión) alineados a huge page y con MADV_HUGEPAGE, y
+ * ubicación opcional en el nodo NUMA del hilo que los procesa (--numa).
+ * Ver bigbuf.c. */
+
+/* Desde este tamaño se usa la ruta de huge pages (una huge page x86). */
+#define BIGBUF_MIN ((size_t)2 * 1024 * 1024)
+
+/* Como malloc: se libera con free() y admite realloc. Por debajo de
+ * BIGBUF_MIN es un malloc normal. */
+void* bigbuf_alloc(size_t n);
+
+/* Activa mbind al nodo del hilo que llama en bigbuf_bind_local. */
+void bigbuf_set_numa(int on);
+int  bigbuf_numa_on(void);
+
+/* Con --numa: las páginas de [p, p+n) prefieren el nodo NUMA del hilo
+ * actual y las ya tocadas se mueven. Sin --numa no hace nada. Llamar
+ * desde el worker antes de escribir el rango. */
+void bigbuf_bind_local(void* p, size_t n);
+
+/* Modo de THP del sistema ("always", "madvise", "never" o "n/d"). */
+const char* bigbuf_thp_mode(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BIGBUF_H */
@@ -0,0 +1,237 @@
+/* =============================================================
+ * bufpool.c - Pool de buffers grandes por clase de tamaño
+ * -------------------------------------------------------------
+ * En modo carpeta cada archivo pide y suelta buffers del orden de
+ * chunk_bytes (lectura, región de chunks, salida de descompresión).
+ * glibc sirve esos tamaños con mmap y los devuelve con munmap al
+ * liberarlos, así el archivo siguiente vuelve a pagar un fallo de
+ * página (y a poner en cero) por cada página: con 100 MB son 25 600
+ * fallos por buffer, en todos los hilos a la vez.
+ * Aquí los buffers devueltos se guardan por clase de tamaño:
+ *   - Clases: 4 por potencia de dos (2^k, 1,25·2^k, 1,5·2^k, 1,75·2^k)
+ *     desde BIGBUF_MIN, así un buffer nunca sobra más de un 25 %.
+ *   - Cada clase guarda a lo sumo per_class buffers tibios y el pool
+ *     entero a lo sumo max_bytes; lo que no entra se libera.
+ *   - Los buffers entregados se anotan (puntero -> clase) en una tabla
+ *     hash para que bufpool_put sepa a qué clase vuelven sin recorrer
+ *     todos los vivos; un puntero desconocido se libera con free(), así
+ *     el pipeline puede soltar con bufpool_put cualquier buffer sin
+ *     saber de dónde vino.
+ * Un mutex global basta: hay pocas operaciones por archivo y cada una
+ * mueve megabytes. Los fallos de clase van a bigbuf_alloc (huge pages).
+ * ============================================================= */
+#include "bufpool.h"
+#include "bigbuf.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BP_MIN_SHIFT 21                 /* log2(BIGBUF_MIN) */
+#define BP_MAX_SHIFT 47                 /* clases hasta 128 TB (de sobra) */
+#define BP_CLASSES   ((BP_MAX_SHIFT - BP_MIN_SHIFT + 1) * 4)
+#define BP_KEEP      8                  /* tope duro de buffers tibios por clase */
+
+typedef struct {
+    void* free[BP_KEEP];
+    size_t n_free;
+    uint64_t gets, hits;
+} BpClass;
+
+typedef struct {
+    void* p;                            /* NULL = hueco */
+    int cls;
+} BpLive;
+
+static BpClass g_cls[BP_CLASSES];
+/* Buffers entregados: hash abierto con sondeo lineal, potencia de dos y
+ * a lo sumo medio lleno. g_pending cuenta las altas ya aseguradas de
+ * bufpool_get que esperan a bigbuf_alloc fuera del candado. */
+static BpLive* g_live;
+static size_t g_n_live, g_pending, g_cap_live;
+static size_t g_per_class = 4;
+static uint64_t g_max_bytes = 1ull << 30;
+static BufPoolStats g_st;
+static pthread_mutex_t g_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/* Clase para n bytes (-1 = fuera de rango) y su tamaño en *size */
+static int class_of(size_t n, size_t* size) {
+    if (n < BIGBUF_MIN) return -1;
+    int k = 63 - __builtin_clzll((unsigned long long)n);
+    size_t base = (size_t)1 << k, step = base >> 2;
+    size_t j = (n - base + step - 1) / step;
+    if (j == 4) { k++; j = 0; base <<= 1; step <<= 1; }
+    if (k > BP_MAX_SHIFT) return -1;
+    *size = base + j * step;
+    return (k - BP_MIN_SHIFT) * 4 + (int)j;
+}
+
+static size_t class_size(int c) {
+    size_t base = (size_t)1 << (BP_MIN_SHIFT + c / 4);
+    return base + (size_t)(c % 4) * (base >> 2);
+}
+
+static size_t live_hash(const void* p) {
+    uint64_t h = (uint64_t)(uintptr_t)p * 0x9E3779B97F4A7C15ull;
+    return (size_t)(h >> 32) & (g_cap_live - 1);
+}
+
+/* Posición de p en la tabla, o -1 */
+static long live_find(const void* p) {
+    if (!g_cap_live) return -1;
+    for (size_t i = live_hash(p); g_live[i].p; i = (i + 1) & (g_cap_live - 1))
+        if (g_live[i].p == p) return (long)i;
+    return -1;
+}
+
+static void live_insert(void* p, int cls) {
+    size_t i = live_hash(p);
+    while (g_live[i].p) i = (i + 1) & (g_cap_live - 1);
+    g_live[i].p = p;
+    g_live[i].cls = cls;
+    g_n_live++;
+}
+
+/* Baja con corrimiento hacia atrás: sin lápidas, las búsquedas siguen
+ * cortando en el primer hueco. */
+static void live_remove(size_t i) {
+    size_t mask = g_cap_live - 1;
+    for (size_t j = (i + 1) & mask; g_live[j].p; j = (j + 1) & mask) {
+        size_t h = live_hash(g_live[j].p);
+        /* j se puede mover a i si su posición ideal no cae en (i, j] */
+        if (((j - h) & mask) >= ((j - i) & mask)) {
+            g_live[i] = g_live[j];
+            i = j;
+        }
+    }
+    g_live[i].p = NULL;
+    g_n_live--;
+}
+
+/* Asegura lugar para una alta más (con g_mtx tomado). -1 sin memoria. */
+static int live_reserve(void) {
+    if ((g_n_live + g_pending + 1) * 2 <= g_cap_live) {
+        g_pending++;
+        return 0;
+    }
+    size_t nc = g_cap_live ? g_cap_live * 2 : 64;
+    BpLive* t = calloc(nc, sizeof(BpLive));
+    if (!t) return -1;
+    BpLive* old = g_live;
+    size_t oc = g_cap_live;
+    g_live = t;
+    g_cap_live = nc;
+    g_n_live = 0;
+    for (size_t i = 0; i < oc; i++)
+        if (old[i].p) live_insert(old[i].p, old[i].cls);
+    free(old);
+    g_pending++;
+    return 0;
+}
+
+void* bufpool_get(size_t n) {
+    size_t size;
+    int c = class_of(n, &size);
+    if (c < 0) return n < BIGBUF_MIN ? malloc(n ? n : 1) : bigbuf_alloc(n);
+
+    pthread_mutex_lock(&g_mtx);
+    BpClass* k = &g_cls[c];
+    g_st.gets++;
+    k->gets++;
+    void* p = NULL;
+    if (k->n_free) {
+        p = k->free[--k->n_free];
+        k->hits++;
+        g_st.hits++;
+        g_st.reused_bytes += size;
+        g_st.warm_bytes -= size;
+    }
+    if (live_reserve() != 0) {
+        if (p) { k->free[k->n_free++] = p; g_st.warm_bytes += size; }
+        pthread_mutex_unlock(&g_mtx);
+        return NULL;
+    }
+    if (p) {
+        g_pending--;
+        live_insert(p, c);
+        pthread_mutex_unlock(&g_mtx);
+        return p;
+    }
+    pthread_mutex_unlock(&g_mtx);
+
+    /* la reserva nueva fuera del candado: puede tardar. El lugar en la
+     * tabla ya está asegurado, así otro hilo no lo puede ocupar. */
+    p = bigbuf_alloc(size);
+
+    pthread_mutex_lock(&g_mtx);
+    g_pending--;
+    if (p) live_insert(p, c);
+    pthread_mutex_unlock(&g_mtx);
+    return p;
+}
+
+void bufpool_put(void* p) {
+    if (!p) return;
+    pthread_mutex_lock(&g_mtx);
+    long i = live_find(p);
+    if (i < 0) {                        /* no es del pool */
+        pthread_mutex_unlock(&g_mtx);
+        free(p);
+        return;
+    }
+    int c = g_live[i].cls;
+    live_remove((size_t)i);
+    g_st.puts++;
+
+    BpClass* k = &g_cls[c];
+    size_t size = class_size(c);
+    if (k->n_free < g_per_class && g_st.warm_bytes + size <= g_max_bytes) {
+        k->free[k->n_free++] = p;
+        g_st.warm_bytes += size;
+        if (g_st.warm_bytes > g_st.warm_peak) g_st.warm_peak = g_st.warm_bytes;
+        p = NULL;
+    } else {
+        g_st.dropped++;
+    }
+    pthread_mutex_unlock(&g_mtx);
+    free(p);
+}
+
+int bufpool_owns(const void* p) {
+    if (!p) return 0;
+    pthread_mutex_lock(&g_mtx);
+    int r = live_find(p) >= 0;
+    pthread_mutex_unlock(&g_mtx);
+    return r;
+}
+
+void bufpool_set_limits(size_t per_class, uint64_t max_bytes) {
+    pthread_mutex_lock(&g_mtx);
+    if (per_class) g_per_class = per_class < BP_KEEP ? per_class : BP_KEEP;
+    if (max_bytes) g_max_bytes = max_bytes;
+    pthread_mutex_unlock(&g_mtx);
+}
+
+void bufpool_trim(void) {
+    pthread_mutex_lock(&g_mtx);
+    for (int c = 0; c < BP_CLASSES; c++) {
+        BpClass* k = &g_cls[c];
+        while (k->n_free) free(k->free[--k->n_free]);
+    }
+    g_st.warm_bytes = 0;
+    pthread_mutex_unlock(&g_mtx);
+}
+
+void bufpool_stats(BufPoolStats* st) {
+    pthread_mutex_lock(&g_mtx);
+    *st = g_st;
+    pthread_mutex_unlock(&g_mtx);
+}
+
+void bufpool_each_class(void (*fn)(size_t size, uint64_t gets, uint64_t hits, void* ctx), void* ctx) {
+    BpClass snap[BP_CLASSES];
+    pthread_mutex_lock(&g_mtx);
+    memcpy(snap, g_cls, sizeof(snap));
+    pthread_mutex_unlock(&g_mtx);
+    for (int c = 0; c < BP_CLASSES; c++)
+        if (snap[c].gets) fn(class_size(c), snap[c].gets, snap[c].hits, ctx);
+}
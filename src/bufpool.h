@@ -0,0 +1,53 @@
+#ifndef BUFPOOL_H
+#define BUFPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Pool de buffers grandes por clase de tamaño, compartido por todos los
+ * hilos del pipeline (ver bufpool.c). Un buffer devuelto queda "tibio"
+ * (páginas ya mapeadas) para el próximo archivo de una clase parecida. */
+
+/* Buffer de al menos n bytes. Desde BIGBUF_MIN sale del pool (o de
+ * bigbuf_alloc si la clase está vacía); por debajo es un malloc. */
+void* bufpool_get(size_t n);
+
+/* Devuelve un buffer. Acepta también punteros que no salieron del pool
+ * (los libera con free), así sirve en lugar de free() en el pipeline.
+ * Un buffer del pool no se puede pasar a free() ni a realloc(). */
+void bufpool_put(void* p);
+
+/* 1 si p es un buffer del pool entregado y aún no devuelto. */
+int bufpool_owns(const void* p);
+
+/* Límites: buffers tibios por clase y bytes tibios en total (0 = no
+ * cambiar). Por defecto 4 por clase y 1 GB. */
+void bufpool_set_limits(size_t per_class, uint64_t max_bytes);
+
+/* Libera todos los buffers tibios. */
+void bufpool_trim(void);
+
+typedef struct {
+    uint64_t gets;        /* pedidos desde BIGBUF_MIN */
+    uint64_t hits;        /* servidos con un buffer tibio */
+    uint64_t puts;        /* devueltos */
+    uint64_t dropped;     /* devueltos con la clase o el total lleno (free) */
+    uint64_t reused_bytes;/* bytes servidos por aciertos */
+    uint64_t warm_bytes;  /* bytes tibios ahora */
+    uint64_t warm_peak;
+} BufPoolStats;
+
+void bufpool_stats(BufPoolStats* st);
+
+/* Por clase con actividad: fn(tamaño de la clase, pedidos, aciertos, ctx). */
+void bufpool_each_class(void (*fn)(size_t size, uint64_t gets, uint64_t hits, void* ctx), void* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BUFPOOL_H */
@@ -0,0 +1,491 @@
+/* =============================================================
+ * chunked.c - Formato por chunks con índice y acceso aleatorio
+ * -------------------------------------------------------------
+ * Antes los chunks comprimidos se concatenaban sin marcas: para
+ * leer cualquier byte había que descomprimir todo el archivo (y
+ * con más de un chunk no había forma de saber dónde empezaba el
+ * siguiente). Ahora la salida lleva un índice al principio:
+ *
+ *   [cabecera 40 B] "GSEACHK1" | u32 versión | u32 alg
+ *                   | u64 chunk_bytes | u64 raw_len | u64 n_chunks
+ *   [índice]        por chunk: u64 comp_len | u64 raw_len | u32 crc
+ *   [datos]         chunks comprimidos, uno tras otro
+ *
+ * Todo en little-endian. Los offsets de cada chunk (comprimido y
+ * original) salen de sumar los tamaños del índice. Con eso:
+ *   - La descompresión completa reparte los chunks entre hilos y
+ *     cada uno escribe directo en su posición del buffer final.
+ *   - Un rango [offset, offset+len) solo descomprime los chunks que
+ *     lo cubren; sobre un archivo se leen con pread, sin tocar el
+ *     resto (1 MB de un archivo de 50 GB = 1-2 chunks).
+ * Cada chunk lleva CRC-32 de sus bytes originales.
+ * Al comprimir, cada chunk se escribe en su propio hueco de una sola
+ * región y el resultado sale como iovec para writev (ver
+ * chunked_compress_iov): no hay buffer intermedio por chunk ni copia
+ * para juntarlos.
+ * ============================================================= */
+#include "chunked.h"
+#include "thread_pool.h"
+#include "crc32.h"
+#include "bigbuf.h"
+#include "bufpool.h"
+#include "membudget.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CHK_VERSION    1
+#define CHK_HEADER_LEN 40
+#define CHK_ENTRY_LEN  20
+
+/* ---------- little-endian ---------- */
+static void wr32le(uint8_t* p, uint32_t v) { for (int i = 0; i < 4; i++) p[i] = (v >> (8*i)) & 0xFF; }
+static void wr64le(uint8_t* p, uint64_t v) { for (int i = 0; i < 8; i++) p[i] = (v >> (8*i)) & 0xFF; }
+static uint32_t rd32le(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+static uint64_t rd64le(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+static int pread_all(int fd, uint8_t* buf, size_t len, uint64_t pos) {
+    size_t off = 0;
+    while (off < len) {
+        ssize_t r = pread(fd, buf + off, len - off, (off_t)(pos + off));
+        if (r <= 0) return -1;
+        off += (size_t)r;
+    }
+    return 0;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Ejecuta n tareas: en línea si hay un solo hilo o una sola tarea
+ * (archivos pequeños no pagan la creación de un pool). */
+static void run_jobs(void (*fn)(void*), void* tasks, size_t task_size,
+                     size_t n, size_t nthreads) {
+    if (nthreads > n) nthreads = n;
+    ThreadPool* tp = (nthreads > 1) ? tp_create(nthreads) : NULL;
+    for (size_t i = 0; i < n; i++) {
+        void* t = (uint8_t*)tasks + i * task_size;
+        if (!tp || tp_submit(tp, fn, t) != 0) fn(t);
+    }
+    if (tp) { tp_wait(tp); tp_destroy(tp); }
+}
+
+/* ---------- Índice en memoria ---------- */
+typedef struct {
+    uint64_t offset;     /* posición absoluta de los datos comprimidos */
+    uint64_t comp_len;
+    uint64_t raw_off;    /* posición en el archivo original */
+    uint64_t raw_len;
+    uint32_t crc;
+} ChunkEntry;
+
+typedef struct {
+    CompAlg alg;
+    uint64_t raw_len;
+    size_t n;
+    ChunkEntry* e;
+} ChunkIndex;
+
+/* Valida la cabecera; devuelve n_chunks en *n. 0 = ok. */
+static int parse_header(const uint8_t* h, ChunkIndex* ix, size_t* n) {
+    if (memcmp(h, CHUNKED_MAGIC, 8) != 0) return -1;
+    if (rd32le(h + 8) != CHK_VERSION) return -1;
+    uint32_t alg = rd32le(h + 12);
+    if (alg > COMP_HUFFMANPRED) return -1;
+    ix->alg = (CompAlg)alg;
+    ix->raw_len = rd64le(h + 24);
+    uint64_t nc = rd64le(h + 32);
+    if (nc > SIZE_MAX / sizeof(ChunkEntry)) return -1;
+    *n = (size_t)nc;
+    return 0;
+}
+
+/* Construye las entradas desde los bytes del índice y comprueba que
+ * todo cae dentro de un archivo de 'total' bytes. 0 = ok. */
+static int parse_entries(const uint8_t* p, size_t n, uint64_t total, ChunkIndex* ix) {
+    ix->n = n;
+    ix->e = calloc(n ? n : 1, sizeof(ChunkEntry));
+    if (!ix->e) return -1;
+    uint64_t off = CHK_HEADER_LEN + (uint64_t)n * CHK_ENTRY_LEN, raw = 0;
+    for (size_t i = 0; i < n; i++, p += CHK_ENTRY_LEN) {
+        ChunkEntry* c = &ix->e[i];
+        c->comp_len = rd64le(p);
+        c->raw_len  = rd64le(p + 8);
+        c->crc      = rd32le(p + 16);
+        c->offset   = off;
+        c->raw_off  = raw;
+        if (c->comp_len > total || off > total - c->comp_len) goto bad;
+        off += c->comp_len;
+        raw += c->raw_len;
+    }
+    if (raw != ix->raw_len) goto bad;
+    return 0;
+bad:
+    free(ix->e); ix->e = NULL;
+    return -1;
+}
+
+/* Primer chunk que contiene el byte original 'pos' (búsqueda binaria) */
+static size_t find_chunk(const ChunkIndex* ix, uint64_t pos) {
+    size_t lo = 0, hi = ix->n;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ix->e[mid].raw_off <= pos) lo = mid; else hi = mid;
+    }
+    return lo;
+}
+
+/* ---------- Compresión ---------- */
+/* Cada chunk se comprime directo en su hueco de la región de salida
+ * (codec_compress_into): el hueco mide codec_compress_bound(len), así
+ * siempre cabe, y la parte que no se usa nunca se toca. La salida queda
+ * como una lista de iovec lista para writev, sin juntar los chunks. */
+typedef struct {
+    const ChunkedOptions* opt;
+    size_t chunk;
+    lzw_ctx* lzw;
+    const uint8_t* in;
+    size_t len;
+    uint8_t* out;       /* hueco dentro de la región */
+    size_t cap;
+    size_t out_len;
+    uint32_t crc;
+    int err;
+} CompTask;
+
+static void comp_job(void* arg) {
+    CompTask* t = (CompTask*)arg;
+    const ChunkedOptions* o = t->opt;
+    uint64_t t0 = journal_stage_begin();
+    /* --mem-budget: los temporales del codec (copia del predictor,
+     * buffers de huffman) no pasan del tamaño del chunk */
+    membudget_acquire_chunk(t->len);
+    bigbuf_bind_local(t->out, t->cap);      /* --numa: el hueco en el nodo de este hilo */
+    journal_scope_set(o->journal, o->name, (long)t->chunk);
+    t->crc = crc32_update(0, t->in, t->len);
+    t->err = codec_compress_into(o->alg, t->lzw, t->in, t->len, t->out, t->cap, &t->out_len);
+    journal_scope_set(NULL, NULL, -1);
+    membudget_release_chunk(t->len);
+    if (t->err == 0) {
+        journal_stage(o->journal, o->name, "compress", (long)t->chunk, t->len, t->out_len, t0);
+        if (o->on_chunk) o->on_chunk(t->chunk, t->len, t->out_len, now_ns() - t0, o->chunk_ctx);
+    }
+}
+
+int chunked_compress_iov(const ChunkedOptions* opt,
+                         const uint8_t* in, size_t in_len,
+                         ChunkedBuf* cb) {
+    if (!opt || !cb || opt->chunk_bytes == 0) return -1;
+    memset(cb, 0, sizeof(*cb));
+    if (opt->alg == COMP_DELTA16_LZW || opt->alg == COMP_DELTA16_HUFF) return -1;
+
+    const size_t CH = opt->chunk_bytes;
+    size_t n = (in_len + CH - 1) / CH;
+    CompTask* tasks = calloc(n ? n : 1, sizeof(CompTask));
+    struct iovec* iov = malloc((n + 1) * sizeof(struct iovec));
+    if (!tasks || !iov) { free(tasks); free(iov); return -1; }
+
+    /* cabecera + índice, y después un hueco por chunk */
+    size_t head = CHK_HEADER_LEN + n * CHK_ENTRY_LEN;
+    size_t region = head;
+    for (size_t i = 0; i < n; i++) {
+        size_t off = i * CH;
+        tasks[i].opt = opt;
+        tasks[i].chunk = i;
+        tasks[i].lzw = (n == 1) ? opt->lzw : NULL; /* el ctx no es compartible */
+        tasks[i].in  = in + off;
+        tasks[i].len = (in_len - off < CH) ? in_len - off : CH;
+        tasks[i].cap = codec_compress_bound(opt->alg, tasks[i].len);
+        region += tasks[i].cap;
+    }
+    /* huge pages; cada hueco lo toca su worker */
+    uint8_t* base = opt->pooled ? bufpool_get(region) : bigbuf_alloc(region);
+    if (!base) { free(tasks); free(iov); return -1; }
+    uint8_t* slot = base + head;
+    for (size_t i = 0; i < n; i++) {
+        tasks[i].out = slot;
+        slot += tasks[i].cap;
+    }
+
+    if (n > 1)
+        JLOG(opt->journal, "[JOURNAL] Paralelo: %zu chunks con %zu hilos\n",
+             n, opt->nthreads < n ? opt->nthreads : n);
+    run_jobs(comp_job, tasks, sizeof(CompTask), n, opt->nthreads);
+
+    int rc = 0;
+    for (size_t i = 0; i < n; i++)
+        if (tasks[i].err) rc = -1;
+
+    if (rc == 0) {
+        memcpy(base, CHUNKED_MAGIC, 8);
+        wr32le(base + 8, CHK_VERSION);
+        wr32le(base + 12, (uint32_t)opt->alg);
+        wr64le(base + 16, CH);
+        wr64le(base + 24, in_len);
+        wr64le(base + 32, n);
+        uint8_t* e = base + CHK_HEADER_LEN;
+        iov[0].iov_base = base;
+        iov[0].iov_len = head;
+        cb->total = head;
+        for (size_t i = 0; i < n; i++, e += CHK_ENTRY_LEN) {
+            wr64le(e, tasks[i].out_len);
+            wr64le(e + 8, tasks[i].len);
+            wr32le(e + 16, tasks[i].crc);
+            iov[i + 1].iov_base = tasks[i].out;
+            iov[i + 1].iov_len = tasks[i].out_len;
+            cb->total += tasks[i].out_len;
+        }
+        cb->base = base;
+        cb->iov = iov;
+        cb->n_iov = n + 1;
+    } else {
+        bufpool_put(base);
+        free(iov);
+    }
+    free(tasks);
+    return rc;
+}
+
+int chunked_buf_flatten(ChunkedBuf* cb, uint8_t** out, size_t* out_len) {
+    if (!cb || !cb->base) return -1;
+    /* los huecos van en orden y cada chunk solo se mueve hacia atrás */
+    uint8_t* d = cb->base;
+    for (size_t i = 0; i < cb->n_iov; i++) {
+        if (cb->iov[i].iov_base != d) memmove(d, cb->iov[i].iov_base, cb->iov[i].iov_len);
+        d += cb->iov[i].iov_len;
+    }
+    /* un buffer del pool vuelve entero a su clase: no se achica */
+    uint8_t* shrink = bufpool_owns(cb->base) ? NULL : realloc(cb->base, cb->total ? cb->total : 1);
+    *out = shrink ? shrink : cb->base;
+    *out_len = cb->total;
+    free(cb->iov);
+    memset(cb, 0, sizeof(*cb));
+    return 0;
+}
+
+void chunked_buf_free(ChunkedBuf* cb) {
+    if (!cb) return;
+    bufpool_put(cb->base);
+    free(cb->iov);
+    memset(cb, 0, sizeof(*cb));
+}
+
+int chunked_compress(const ChunkedOptions* opt,
+                     const uint8_t* in, size_t in_len,
+                     uint8_t** out, size_t* out_len) {
+    if (!out || !out_len) return -1;
+    ChunkedBuf cb;
+    if (chunked_compress_iov(opt, in, in_len, &cb) != 0) return -1;
+    return chunked_buf_flatten(&cb, out, out_len);
+}
+
+/* ---------- Descompresión de chunks ---------- */
+
+/* Origen de los datos comprimidos: buffer en memoria o fd (pread) */
+typedef struct {
+    const uint8_t* mem;
+    int fd;
+} Source;
+
+typedef struct {
+    const Source* src;
+    const ChunkIndex* ix;
+    const ChunkedOptions* opt;  /* solo para on_chunk; puede ser NULL */
+    size_t chunk;
+    uint64_t skip;     /* bytes originales a saltar al inicio del chunk */
+    uint64_t take;     /* bytes originales a copiar */
+    uint8_t* dst;
+    int err;
+} DecTask;
+
+static void dec_job(void* arg) {
+    DecTask* t = (DecTask*)arg;
+    const ChunkEntry* c = &t->ix->e[t->chunk];
+    uint64_t t0 = journal_stage_begin();
+    int whole = (t->skip == 0 && t->take == c->raw_len);
+
+    /* Temporales del chunk en la arena del hilo; se sueltan al final.
+     * Con --mem-budget se reservan antes: lectura con pread y salida
+     * parcial (el chunk entero va directo al buffer del archivo). */
+    uint64_t charge = (t->src->mem ? 0 : c->comp_len) + (whole ? 0 : c->raw_len);
+    Arena* ar = codec_arena();
+    if (!ar) { t->err = -1; return; }
+    membudget_acquire_chunk(charge);
+    ArenaMark m = arena_mark(ar);
+
+    const uint8_t* comp = NULL;
+    if (t->src->mem) {
+        comp = t->src->mem + c->offset;
+    } else {
+        uint8_t* rd = arena_alloc(ar, c->comp_len ? c->comp_len : 1);
+        if (!rd || pread_all(t->src->fd, rd, c->comp_len, c->offset) != 0) {
+            codec_arena_release(ar, m); membudget_release_chunk(charge); t->err = -1; return;
+        }
+        comp = rd;
+    }
+
+    /* Chunk entero: directo a su posición final. Parcial (rangos): se
+     * descomprime en la arena y se copia solo lo pedido. */
+    bigbuf_bind_local(t->dst, t->take);
+    uint8_t* raw = whole ? t->dst : arena_alloc(ar, c->raw_len ? c->raw_len : 1);
+    size_t raw_len = 0;
+    const Journal* jr = t->opt ? t->opt->journal : NULL;
+    const char* name = t->opt ? t->opt->name : NULL;
+    journal_scope_set(jr, name, (long)t->chunk);
+    int rc = raw ? codec_decompress_into(t->ix->alg, comp, c->comp_len, raw, c->raw_len, &raw_len) : -1;
+    journal_scope_set(NULL, NULL, -1);
+    if (rc != 0 || raw_len != c->raw_len || crc32_update(0, raw, raw_len) != c->crc) {
+        codec_arena_release(ar, m); membudget_release_chunk(charge); t->err = -1; return;
+    }
+    if (!whole) memcpy(t->dst, raw + t->skip, t->take);
+    codec_arena_release(ar, m);
+    membudget_release_chunk(charge);
+    journal_stage(jr, name, "decompress", (long)t->chunk, c->comp_len, c->raw_len, t0);
+    if (t->opt && t->opt->on_chunk)
+        t->opt->on_chunk(t->chunk, c->raw_len, c->comp_len, now_ns() - t0, t->opt->chunk_ctx);
+}
+
+/* Descomprime los chunks que cubren [offset, offset+len) en un buffer nuevo */
+static int read_range_ix(const Source* src, const ChunkIndex* ix,
+                         const ChunkedOptions* opt, uint64_t offset, uint64_t len, size_t nthreads,
+                         uint8_t** out, size_t* out_len) {
+    if (offset > ix->raw_len) offset = ix->raw_len;
+    if (len > ix->raw_len - offset) len = ix->raw_len - offset;
+    if (len > SIZE_MAX - 1) return -1;
+
+    size_t blen = len ? (size_t)len : 1;
+    uint8_t* buf = (opt && opt->pooled) ? bufpool_get(blen) : bigbuf_alloc(blen);
+    if (!buf) return -1;
+    if (len == 0) { *out = buf; *out_len = 0; return 0; }
+
+    size_t first = find_chunk(ix, offset);
+    size_t last  = find_chunk(ix, offset + len - 1);
+    size_t n = last - first + 1;
+    DecTask* tasks = calloc(n, sizeof(DecTask));
+    if (!tasks) { bufpool_put(buf); return -1; }
+
+    uint64_t pos = offset, end = offset + len;
+    for (size_t i = 0; i < n; i++) {
+        const ChunkEntry* c = &ix->e[first + i];
+        uint64_t cend = c->raw_off + c->raw_len;
+        tasks[i].src   = src;
+        tasks[i].ix    = ix;
+        tasks[i].opt   = opt;
+        tasks[i].chunk = first + i;
+        tasks[i].skip  = pos - c->raw_off;
+        tasks[i].take  = ((cend < end) ? cend : end) - pos;
+        tasks[i].dst   = buf + (pos - offset);
+        pos += tasks[i].take;
+    }
+
+    run_jobs(dec_job, tasks, sizeof(DecTask), n, nthreads);
+
+    int rc = 0;
+    for (size_t i = 0; i < n; i++) if (tasks[i].err) rc = -1;
+    free(tasks);
+    if (rc != 0) { bufpool_put(buf); return -1; }
+
+    *out = buf;
+    *out_len = (size_t)len;
+    return 0;
+}
+
+/* Lee cabecera + índice de un buffer en memoria */
+static int load_index_mem(const uint8_t* in, size_t in_len, ChunkIndex* ix) {
+    size_t n = 0;
+    if (in_len < CHK_HEADER_LEN || parse_header(in, ix, &n) != 0) return -1;
+    if (n > (in_len - CHK_HEADER_LEN) / CHK_ENTRY_LEN) return -1;
+    return parse_entries(in + CHK_HEADER_LEN, n, in_len, ix);
+}
+
+int chunked_is_framed(const uint8_t* in, size_t in_len) {
+    ChunkIndex ix;
+    size_t n = 0;
+    if (!in || in_len < CHK_HEADER_LEN) return 0;
+    return parse_header(in, &ix, &n) == 0;
+}
+
+int chunked_file_raw_len(const char* path, uint64_t* raw_len) {
+    uint8_t hdr[CHK_HEADER_LEN];
+    ChunkIndex ix;
+    size_t n = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    int rc = (pread_all(fd, hdr, sizeof(hdr), 0) == 0 && parse_header(hdr, &ix, &n) == 0) ? 0 : -1;
+    close(fd);
+    if (rc == 0) *raw_len = ix.raw_len;
+    return rc;
+}
+
+int chunked_decompress(const ChunkedOptions* opt,
+                       const uint8_t* in, size_t in_len,
+                       uint8_t** out, size_t* out_len) {
+    ChunkIndex ix;
+    if (!out || !out_len || load_index_mem(in, in_len, &ix) != 0) return -1;
+
+    size_t nthreads = opt ? opt->nthreads : 1;
+    if (opt && ix.n > 1)
+        JLOG(opt->journal, "[JOURNAL] Descompresión: %zu chunks con %zu hilos\n",
+             ix.n, nthreads < ix.n ? nthreads : ix.n);
+
+    Source src = { in, -1 };
+    int rc = read_range_ix(&src, &ix, opt, 0, ix.raw_len, nthreads, out, out_len);
+    free(ix.e);
+    return rc;
+}
+
+int chunked_read_range(const uint8_t* in, size_t in_len,
+                       uint64_t offset, uint64_t len, size_t nthreads,
+                       uint8_t** out, size_t* out_len) {
+    ChunkIndex ix;
+    if (!out || !out_len || load_index_mem(in, in_len, &ix) != 0) return -1;
+    Source src = { in, -1 };
+    int rc = read_range_ix(&src, &ix, NULL, offset, len, nthreads, out, out_len);
+    free(ix.e);
+    return rc;
+}
+
+int chunked_read_range_file(const char* path,
+                            uint64_t offset, uint64_t len, size_t nthreads,
+                            uint8_t** out, size_t* out_len) {
+    if (!path || !out || !out_len) return -1;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    int rc = -1;
+    struct stat st;
+    uint8_t hdr[CHK_HEADER_LEN];
+    uint8_t* ent = NULL;
+    ChunkIndex ix;
+    ix.e = NULL;
+    size_t n = 0;
+
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < CHK_HEADER_LEN) goto done;
+    if (pread_all(fd, hdr, sizeof(hdr), 0) != 0 || parse_header(hdr, &ix, &n) != 0) goto done;
+    if (n > ((uint64_t)st.st_size - CHK_HEADER_LEN) / CHK_ENTRY_LEN) goto done;
+
+    ent = malloc(n ? n * CHK_ENTRY_LEN : 1);
+    if (!ent || pread_all(fd, ent, n * CHK_ENTRY_LEN, CHK_HEADER_LEN) != 0) goto done;
+    if (parse_entries(ent, n, (uint64_t)st.st_size, &ix) != 0) goto done;
+
+    Source src = { NULL, fd };
+    rc = read_range_ix(&src, &ix, NULL, offset, len, nthreads, out, out_len);
+
+done:
+    free(ent);
+    free(ix.e);
+    close(fd);
+    return rc;
+}
@@ -0,0 +1,101 @@
+#ifndef CHUNKED_H
+#define CHUNKED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include "codec.h"
+#include "journal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Formato por chunks con índice (ver chunked.c).
+ * - Cada chunk de chunk_bytes se comprime de forma independiente.
+ * - La cabecera guarda el tamaño comprimido/original y el CRC de cada
+ *   chunk, así se puede descomprimir en paralelo o extraer un rango
+ *   leyendo solo los chunks que lo cubren.
+ */
+
+#define CHUNKED_MAGIC "GSEACHK1"
+
+/* Aviso opcional por chunk terminado (se llama desde los hilos de trabajo,
+ * puede ser concurrente): índice, bytes originales, bytes comprimidos y
+ * duración en ns de la (des)compresión del chunk. */
+typedef void (*chunked_chunk_fn)(size_t chunk, size_t raw_len, size_t comp_len,
+                                 uint64_t ns, void* ctx);
+
+typedef struct {
+    CompAlg alg;           /* algoritmo por chunk (no delta16) */
+    size_t chunk_bytes;    /* tamaño de chunk sin comprimir */
+    size_t nthreads;       /* hilos para (des)comprimir chunks; <=1 = secuencial */
+    lzw_ctx* lzw;          /* contexto LZW para un solo chunk (NULL = el del hilo) */
+    const Journal* journal;
+    const char* name;      /* archivo, para los eventos por etapa del journal */
+    chunked_chunk_fn on_chunk; /* opcional */
+    void* chunk_ctx;
+    int pooled;            /* 1 = salida desde bufpool (liberar con bufpool_put) */
+} ChunkedOptions;
+
+/* Comprime in[0..in_len) en formato indexado. Salida malloc. 0 = ok. */
+int chunked_compress(const ChunkedOptions* opt,
+                     const uint8_t* in, size_t in_len,
+                     uint8_t** out, size_t* out_len);
+
+/* Salida de chunked_compress_iov: una región (base) con la cabecera y el
+ * índice al principio y un hueco de codec_compress_bound() bytes por chunk.
+ * iov[0] = cabecera + índice, iov[1 + i] = bytes comprimidos del chunk i;
+ * escritos en orden (writev) forman el mismo archivo que chunked_compress.
+ * total = suma de los iov_len. */
+typedef struct {
+    uint8_t* base;
+    struct iovec* iov;
+    size_t n_iov;
+    size_t total;
+} ChunkedBuf;
+
+/* Igual que chunked_compress pero sin juntar los chunks. 0 = ok; liberar
+ * con chunked_buf_free (o pasar a contiguo con chunked_buf_flatten). */
+int chunked_compress_iov(const ChunkedOptions* opt,
+                         const uint8_t* in, size_t in_len,
+                         ChunkedBuf* cb);
+
+/* Junta los chunks en el lugar (memmove dentro de la misma región) y
+ * entrega el buffer contiguo (del llamador: free, o bufpool_put si se
+ * comprimió con pooled). Deja *cb vacío. */
+int chunked_buf_flatten(ChunkedBuf* cb, uint8_t** out, size_t* out_len);
+
+void chunked_buf_free(ChunkedBuf* cb);
+
+/* 1 si el buffer empieza con una cabecera CHUNKED_MAGIC válida. */
+int chunked_is_framed(const uint8_t* in, size_t in_len);
+
+/* Tamaño original guardado en la cabecera de un archivo indexado (lee
+ * solo la cabecera). 0 = ok, -1 = no se pudo leer o no es el formato. */
+int chunked_file_raw_len(const char* path, uint64_t* raw_len);
+
+/* Descomprime un buffer indexado completo (algoritmo tomado de la
+ * cabecera; de opt solo se usan nthreads, journal, name, on_chunk y pooled).
+ * 0 = ok. */
+int chunked_decompress(const ChunkedOptions* opt,
+                       const uint8_t* in, size_t in_len,
+                       uint8_t** out, size_t* out_len);
+
+/* Extrae los bytes originales [offset, offset+len) de un buffer indexado.
+ * El rango se recorta al final del archivo (puede quedar vacío). 0 = ok. */
+int chunked_read_range(const uint8_t* in, size_t in_len,
+                       uint64_t offset, uint64_t len, size_t nthreads,
+                       uint8_t** out, size_t* out_len);
+
+/* Igual que chunked_read_range pero sobre un archivo: con pread solo se
+ * leen la cabecera, el índice y los chunks que cubren el rango. */
+int chunked_read_range_file(const char* path,
+                            uint64_t offset, uint64_t len, size_t nthreads,
+                            uint8_t** out, size_t* out_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CHUNKED_H */
@@ -0,0 +1,508 @@
+/* =============================================================
+ * codec.c - Despacho común de algoritmos de compresión por bloque
+ * -------------------------------------------------------------
+ * El mismo switch (RLE / LZW / LZW+SUB / Huffman+SUB) se usaba en
+ * varios sitios del pipeline. Aquí queda en un único lugar para que
+ * la compresión por chunks, los chunks paralelos y el contenedor de
+ * carpetas (archive.c) produzcan exactamente el mismo formato.
+ * Los modos delta16 (WAV) también viven aquí para que el pipeline y
+ * el benchmark (bench.c) compartan el mismo empaquetado.
+ * Sub-etapas (predictor, wav_decode, ...) se reportan con JSTAGE_* al
+ * journal por etapas si quien llama dejó un contexto en el hilo.
+ * Con --perf-counters cada llamada pública (codec_compress, ...) se
+ * mide con contadores de hardware (perfctr.c).
+ * Cada hilo tiene sus propios contextos LZW/Huffman y una arena para
+ * los temporales: en régimen estable, comprimir o descomprimir un chunk
+ * con las variantes _into no llama a malloc. Al terminar el hilo los
+ * contextos vuelven a una lista global y el próximo hilo los retoma, así
+ * los pools internos que chunked.c crea por archivo no vuelven a reservar
+ * la tabla LZW (4 MB), el hp_ctx y la arena en cada hilo. Con
+ * --mem-budget no se guarda nada: la memoria que el presupuesto ya dio
+ * por devuelta no queda residente en contextos sin dueño.
+ * ============================================================= */
+#include "codec.h"
+#include "rle_var.h"
+#include "huffman_predictor.h"
+#include "audio_wav.h"
+#include "journal.h"
+#include "perfctr.h"
+#include "membudget.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ---------- Contextos por hilo ---------- */
+typedef struct CodecScratch {
+    lzw_ctx* lzw;
+    hp_ctx* hp;
+    Arena arena;        /* temporales: copia con predictor, chunks parciales... */
+    struct CodecScratch* next;  /* en g_free */
+} CodecScratch;
+
+/* Con --mem-budget la arena no guarda entre chunks más que esto */
+#define CODEC_ARENA_KEEP (256 * 1024)
+
+static _Thread_local CodecScratch* t_sc;
+static pthread_key_t g_key;
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+
+/* Contextos de hilos ya terminados. Nunca hay más que el pico de hilos
+ * vivos a la vez; codec_scratch_trim los libera. */
+static pthread_mutex_t g_free_mtx = PTHREAD_MUTEX_INITIALIZER;
+static CodecScratch* g_free;
+
+static void scratch_destroy(CodecScratch* s) {
+    lzw_ctx_destroy(s->lzw);
+    hp_ctx_destroy(s->hp);
+    arena_free(&s->arena);
+    free(s);
+}
+
+/* Destructor del pthread_key: el contexto pasa a la lista global */
+static void scratch_release(void* p) {
+    CodecScratch* s = p;
+    if (membudget_on()) { scratch_destroy(s); return; }
+    pthread_mutex_lock(&g_free_mtx);
+    s->next = g_free;
+    g_free = s;
+    pthread_mutex_unlock(&g_free_mtx);
+}
+
+static void key_init(void) {
+    pthread_key_create(&g_key, scratch_release);
+}
+
+static CodecScratch* scratch(void) {
+    if (t_sc) return t_sc;
+    pthread_mutex_lock(&g_free_mtx);
+    CodecScratch* s = g_free;
+    if (s) g_free = s->next;
+    pthread_mutex_unlock(&g_free_mtx);
+    if (!s) {
+        s = calloc(1, sizeof(CodecScratch));
+        if (!s) return NULL;
+        arena_init(&s->arena);
+    }
+    s->next = NULL;
+    pthread_once(&g_once, key_init);
+    pthread_setspecific(g_key, s);
+    t_sc = s;
+    return s;
+}
+
+static lzw_ctx* thread_lzw(void) {
+    CodecScratch* s = scratch();
+    if (!s) return NULL;
+    if (!s->lzw) s->lzw = lzw_ctx_create();
+    return s->lzw;
+}
+
+static hp_ctx* thread_hp(void) {
+    CodecScratch* s = scratch();
+    if (!s) return NULL;
+    if (!s->hp) s->hp = hp_ctx_create();
+    return s->hp;
+}
+
+Arena* codec_arena(void) {
+    CodecScratch* s = scratch();
+    return s ? &s->arena : NULL;
+}
+
+void codec_arena_release(Arena* ar, ArenaMark m) {
+    arena_release(ar, m);
+    if (membudget_on()) arena_trim(ar, CODEC_ARENA_KEEP);
+}
+
+void codec_scratch_trim(void) {
+    pthread_mutex_lock(&g_free_mtx);
+    CodecScratch* s = g_free;
+    g_free = NULL;
+    pthread_mutex_unlock(&g_free_mtx);
+    while (s) {
+        CodecScratch* next = s->next;
+        scratch_destroy(s);
+        s = next;
+    }
+}
+
+/* Sin contexto disponible (sin memoria) se cae a las versiones que
+ * reservan por llamada. */
+static int lzw_comp(lzw_ctx* c, const uint8_t* in, size_t n, uint8_t** out, size_t* out_len) {
+    if (!c) c = thread_lzw();
+    return c ? lzw_compress_ctx(c, in, n, out, out_len) : lzw_compress(in, n, out, out_len);
+}
+
+static int lzw_decomp(const uint8_t* in, size_t n, uint8_t** out, size_t* out_len) {
+    lzw_ctx* c = thread_lzw();
+    return c ? lzw_decompress_ctx(c, in, n, out, out_len) : lzw_decompress(in, n, out, out_len);
+}
+
+static int hp_comp(const uint8_t* in, size_t n, uint8_t** out, size_t* out_len) {
+    hp_ctx* c = thread_hp();
+    return c ? hp_compress_ctx(c, in, n, out, out_len) : hp_compress_buffer(in, n, out, out_len);
+}
+
+static int lzw_comp_into(lzw_ctx* c, const uint8_t* in, size_t n,
+                         uint8_t* out, size_t cap, size_t* out_len) {
+    if (!c) c = thread_lzw();
+    return c ? lzw_compress_into_ctx(c, in, n, out, cap, out_len)
+             : lzw_compress_into(in, n, out, cap, out_len);
+}
+
+static int hp_comp_into(const uint8_t* in, size_t n, uint8_t* out, size_t cap, size_t* out_len) {
+    hp_ctx* c = thread_hp();
+    return c ? hp_compress_into_ctx(c, in, n, out, cap, out_len)
+             : hp_compress_into(in, n, out, cap, out_len);
+}
+
+static int hp_decomp(const uint8_t* in, size_t n, uint8_t** out, size_t* out_len) {
+    hp_ctx* c = thread_hp();
+    return c ? hp_decompress_ctx(c, in, n, out, out_len) : hp_decompress_buffer(in, n, out, out_len);
+}
+
+/* Predictor SUB: resta el pixel/byte anterior para generar diferencias */
+void codec_sub_forward(uint8_t* buf, int w, int h, int ch) {
+    /* Recorre la fila y reemplaza cada valor por (actual - anterior) */
+    if (!buf) return;
+    for (int y = 0; y < h; ++y) {
+        size_t base = (size_t)y * w * ch;
+        uint8_t left[4] = {0,0,0,0};
+        for (int x = 0; x < w; ++x) {
+            for (int c = 0; c < ch; ++c) {
+                size_t i = base + x*ch + c;
+                uint8_t cur = buf[i];
+                uint8_t pred = (uint8_t)(cur - left[c]);
+                buf[i] = pred;
+                left[c] = cur;
+            }
+        }
+    }
+}
+
+void codec_sub_inverse(uint8_t* buf, int w, int h, int ch) {
+    /* Reconstruye sumando el valor previo */
+    if (!buf) return;
+    for (int y = 0; y < h; ++y) {
+        size_t base = (size_t)y * w * ch;
+        uint8_t left[4] = {0,0,0,0};
+        for (int x = 0; x < w; ++x) {
+            for (int c = 0; c < ch; ++c) {
+                size_t i = base + x*ch + c;
+                uint8_t pred = buf[i];
+                uint8_t cur = (uint8_t)(pred + left[c]);
+                buf[i] = cur;
+                left[c] = cur;
+            }
+        }
+    }
+}
+
+static int compress_block(CompAlg alg, lzw_ctx* lzw,
+                          const uint8_t* in, size_t in_len,
+                          uint8_t** out, size_t* out_len)
+{
+    switch (alg) {
+        case COMP_RLEVAR:
+            return rle_var_compress(in, in_len, out, out_len);
+        case COMP_LZW:
+            return lzw_comp(lzw, in, in_len, out, out_len);
+        case COMP_LZWPRED:
+        case COMP_HUFFMANPRED: {
+            Arena* ar = codec_arena();
+            if (!ar) return -1;
+            ArenaMark m = arena_mark(ar);
+            uint8_t* tmp = arena_alloc(ar, in_len ? in_len : 1);
+            if (!tmp) return -1;
+            memcpy(tmp, in, in_len);
+            uint64_t t0 = JSTAGE_BEGIN();
+            codec_sub_forward(tmp, 1, 1, 1);
+            JSTAGE_END("predictor", in_len, in_len, t0);
+            int rc = (alg == COMP_LZWPRED) ? lzw_comp(lzw, tmp, in_len, out, out_len)
+                                           : hp_comp(tmp, in_len, out, out_len);
+            codec_arena_release(ar, m);
+            return rc;
+        }
+        default:
+            return -1;
+    }
+}
+
+int codec_compress(CompAlg alg, lzw_ctx* lzw,
+                   const uint8_t* in, size_t in_len,
+                   uint8_t** out, size_t* out_len)
+{
+    PerfSample ps;
+    perfctr_begin(&ps);
+    int rc = compress_block(alg, lzw, in, in_len, out, out_len);
+    if (rc == 0) perfctr_end(&ps, alg, 1, in_len);
+    return rc;
+}
+
+size_t codec_compress_bound(CompAlg alg, size_t in_len) {
+    switch (alg) {
+        case COMP_RLEVAR:      return rle_var_compress_bound(in_len);
+        case COMP_LZW:
+        case COMP_LZWPRED:     return lzw_compress_bound(in_len);
+        case COMP_HUFFMANPRED: return hp_compress_bound(in_len);
+        default:               return 0;
+    }
+}
+
+static int compress_block_into(CompAlg alg, lzw_ctx* lzw,
+                               const uint8_t* in, size_t in_len,
+                               uint8_t* out, size_t cap, size_t* out_len)
+{
+    switch (alg) {
+        case COMP_RLEVAR:
+            return rle_var_compress_into(in, in_len, out, cap, out_len);
+        case COMP_LZW:
+            return lzw_comp_into(lzw, in, in_len, out, cap, out_len);
+        case COMP_LZWPRED:
+        case COMP_HUFFMANPRED: {
+            Arena* ar = codec_arena();
+            if (!ar) return -1;
+            ArenaMark m = arena_mark(ar);
+            uint8_t* tmp = arena_alloc(ar, in_len ? in_len : 1);
+            if (!tmp) return -1;
+            memcpy(tmp, in, in_len);
+            uint64_t t0 = JSTAGE_BEGIN();
+            codec_sub_forward(tmp, 1, 1, 1);
+            JSTAGE_END("predictor", in_len, in_len, t0);
+            int rc = (alg == COMP_LZWPRED) ? lzw_comp_into(lzw, tmp, in_len, out, cap, out_len)
+                                           : hp_comp_into(tmp, in_len, out, cap, out_len);
+            codec_arena_release(ar, m);
+            return rc;
+        }
+        default:
+            return -1;
+    }
+}
+
+int codec_compress_into(CompAlg alg, lzw_ctx* lzw,
+                        const uint8_t* in, size_t in_len,
+                        uint8_t* out, size_t cap, size_t* out_len)
+{
+    PerfSample ps;
+    perfctr_begin(&ps);
+    int rc = compress_block_into(alg, lzw, in, in_len, out, cap, out_len);
+    if (rc == 0) perfctr_end(&ps, alg, 1, in_len);
+    return rc;
+}
+
+static int decompress_block(CompAlg alg,
+                            const uint8_t* in, size_t in_len,
+                            uint8_t** out, size_t* out_len)
+{
+    int rc;
+    switch (alg) {
+        case COMP_RLEVAR:      rc = rle_var_decompress(in, in_len, out, out_len); break;
+        case COMP_LZW:
+        case COMP_LZWPRED:     rc = lzw_decomp(in, in_len, out, out_len); break;
+        case COMP_HUFFMANPRED: rc = hp_decomp(in, in_len, out, out_len); break;
+        default: return -1;
+    }
+    if (rc == 0 && (alg == COMP_LZWPRED || alg == COMP_HUFFMANPRED)) {
+        uint64_t t0 = JSTAGE_BEGIN();
+        codec_sub_inverse(*out, 1, 1, 1);
+        JSTAGE_END("unpredict", *out_len, *out_len, t0);
+    }
+    return rc;
+}
+
+int codec_decompress(CompAlg alg,
+                     const uint8_t* in, size_t in_len,
+                     uint8_t** out, size_t* out_len)
+{
+    PerfSample ps;
+    perfctr_begin(&ps);
+    int rc = decompress_block(alg, in, in_len, out, out_len);
+    if (rc == 0) perfctr_end(&ps, alg, 0, in_len);
+    return rc;
+}
+
+static int decompress_block_into(CompAlg alg,
+                                 const uint8_t* in, size_t in_len,
+                                 uint8_t* out, size_t cap, size_t* out_len)
+{
+    int rc;
+    switch (alg) {
+        case COMP_RLEVAR:
+            rc = rle_var_decompress_into(in, in_len, out, cap, out_len);
+            break;
+        case COMP_LZW:
+        case COMP_LZWPRED: {
+            lzw_ctx* c = thread_lzw();
+            rc = c ? lzw_decompress_into_ctx(c, in, in_len, out, cap, out_len)
+                   : lzw_decompress_into(in, in_len, out, cap, out_len);
+            break;
+        }
+        case COMP_HUFFMANPRED: {
+            hp_ctx* c = thread_hp();
+            rc = c ? hp_decompress_into_ctx(c, in, in_len, out, cap, out_len)
+                   : hp_decompress_into(in, in_len, out, cap, out_len);
+            break;
+        }
+        default: return -1;
+    }
+    if (rc == 0 && (alg == COMP_LZWPRED || alg == COMP_HUFFMANPRED)) {
+        uint64_t t0 = JSTAGE_BEGIN();
+        codec_sub_inverse(out, 1, 1, 1);
+        JSTAGE_END("unpredict", *out_len, *out_len, t0);
+    }
+    return rc;
+}
+
+int codec_decompress_into(CompAlg alg,
+                          const uint8_t* in, size_t in_len,
+                          uint8_t* out, size_t cap, size_t* out_len)
+{
+    PerfSample ps;
+    perfctr_begin(&ps);
+    int rc = decompress_block_into(alg, in, in_len, out, cap, out_len);
+    if (rc == 0) perfctr_end(&ps, alg, 0, in_len);
+    return rc;
+}
+
+/* ---------- delta16 (WAV PCM16) ---------- */
+#define WAV_HEAD_LEN 18
+
+static void wr16le(uint8_t* p, uint16_t v) { p[0] = v & 0xFF; p[1] = (v >> 8) & 0xFF; }
+static void wr32le(uint8_t* p, uint32_t v) { for (int i = 0; i < 4; i++) p[i] = (v >> (8*i)) & 0xFF; }
+static uint16_t rd16le(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t rd32le(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void codec_delta16_forward(int16_t* s, size_t frames, int ch) {
+    /* Convierte muestras PCM16 a diferencias para mejorar compresión */
+    if (!s || frames == 0 || ch <= 0) return;
+    for (int c = 0; c < ch; ++c) {
+        int16_t prev = 0;
+        for (size_t i = 0; i < frames; ++i) {
+            size_t k = i * ch + c;
+            int16_t cur = s[k];
+            s[k] = (int16_t)(cur - prev);
+            prev = cur;
+        }
+    }
+}
+
+void codec_delta16_inverse(int16_t* s, size_t frames, int ch) {
+    /* Reconstruye muestras originales acumulando diferencias */
+    if (!s || frames == 0 || ch <= 0) return;
+    for (int c = 0; c < ch; ++c) {
+        int16_t acc = 0;
+        for (size_t i = 0; i < frames; ++i) {
+            size_t k = i * ch + c;
+            acc = (int16_t)(acc + s[k]);
+            s[k] = acc;
+        }
+    }
+}
+
+static int wav_compress(CompAlg alg, const uint8_t* in, size_t in_len,
+                        uint8_t** out, size_t* out_len)
+{
+    if (alg != COMP_DELTA16_LZW && alg != COMP_DELTA16_HUFF) return -1;
+    if (!wav_is_riff_wave(in, in_len)) return 1;
+
+    int16_t* samples = NULL;
+    size_t frames = 0;
+    int ch = 0, sr = 0;
+    uint64_t t0 = JSTAGE_BEGIN();
+    if (wav_decode_pcm16(in, in_len, &samples, &frames, &ch, &sr) != 0) return 1;
+
+    size_t n = frames * (size_t)ch * 2;
+    JSTAGE_END("wav_decode", in_len, n, t0);
+    t0 = JSTAGE_BEGIN();
+    codec_delta16_forward(samples, frames, ch);
+    JSTAGE_END("predictor", n, n, t0);
+
+    uint8_t* comp = NULL;
+    size_t clen = 0;
+    t0 = JSTAGE_BEGIN();
+    int rc = (alg == COMP_DELTA16_LZW)
+           ? lzw_comp(NULL, (const uint8_t*)samples, n, &comp, &clen)
+           : hp_comp((const uint8_t*)samples, n, &comp, &clen);
+    free(samples);
+    if (rc == 0) JSTAGE_END("compress", n, clen, t0);
+    if (rc != 0) return -1;
+
+    uint8_t* pack = malloc(WAV_HEAD_LEN + clen);
+    if (!pack) { free(comp); return -1; }
+    memcpy(pack, CODEC_WAV_MAGIC, 8);
+    wr16le(pack + 8, (uint16_t)ch);
+    wr32le(pack + 10, (uint32_t)sr);
+    wr32le(pack + 14, (uint32_t)frames);
+    memcpy(pack + WAV_HEAD_LEN, comp, clen);
+    free(comp);
+
+    *out = pack;
+    *out_len = WAV_HEAD_LEN + clen;
+    return 0;
+}
+
+int codec_wav_compress(CompAlg alg, const uint8_t* in, size_t in_len,
+                       uint8_t** out, size_t* out_len)
+{
+    PerfSample ps;
+    perfctr_begin(&ps);
+    int rc = wav_compress(alg, in, in_len, out, out_len);
+    if (rc == 0) perfctr_end(&ps, alg, 1, in_len);
+    return rc;
+}
+
+int codec_wav_is_packed(const uint8_t* in, size_t in_len) {
+    return in && in_len >= WAV_HEAD_LEN && memcmp(in, CODEC_WAV_MAGIC, 8) == 0;
+}
+
+static int wav_decompress(CompAlg alg, const uint8_t* in, size_t in_len,
+                          uint8_t** out, size_t* out_len)
+{
+    if (!codec_wav_is_packed(in, in_len)) return -1;
+    uint16_t ch = rd16le(in + 8);
+    uint32_t sr = rd32le(in + 10);
+    uint32_t fr = rd32le(in + 14);
+
+    uint8_t* raw = NULL;
+    size_t raw_len = 0;
+    uint64_t t0 = JSTAGE_BEGIN();
+    int rc = (alg == COMP_DELTA16_LZW)
+           ? lzw_decomp(in + WAV_HEAD_LEN, in_len - WAV_HEAD_LEN, &raw, &raw_len)
+           : hp_decomp(in + WAV_HEAD_LEN, in_len - WAV_HEAD_LEN, &raw, &raw_len);
+    if (rc != 0) return -1;
+    if (ch == 0 || raw_len < (size_t)fr * ch * 2) { free(raw); return -1; }
+    JSTAGE_END("decompress", in_len - WAV_HEAD_LEN, raw_len, t0);
+
+    t0 = JSTAGE_BEGIN();
+    codec_delta16_inverse((int16_t*)raw, fr, ch);
+    JSTAGE_END("unpredict", raw_len, raw_len, t0);
+    t0 = JSTAGE_BEGIN();
+    rc = wav_encode_pcm16((const int16_t*)raw, fr, ch, (int)sr, out, out_len);
+    free(raw);
+    if (rc == 0) JSTAGE_END("wav_encode", raw_len, *out_len, t0);
+    return rc == 0 ? 0 : -1;
+}
+
+int codec_wav_decompress(CompAlg alg, const uint8_t* in, size_t in_len,
+                         uint8_t** out, size_t* out_len)
+{
+    PerfSample ps;
+    perfctr_begin(&ps);
+    int rc = wav_decompress(alg, in, in_len, out, out_len);
+    if (rc == 0) perfctr_end(&ps, alg, 0, in_len);
+    return rc;
+}
+
+const char* codec_name(CompAlg alg) {
+    switch (alg) {
+        case COMP_RLEVAR:       return "rlevar";
+        case COMP_LZW:          return "lzw";
+        case COMP_LZWPRED:      return "lzw-pred";
+        case COMP_HUFFMANPRED:  return "huffman-pred";
+        case COMP_DELTA16_LZW:  return "delta16-lzw";
+        case COMP_DELTA16_HUFF: return "delta16-huff";
+    }
+    return "?";
+}
@@ -0,0 +1,94 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "lzw.h"
+#include "arena.h"
+
+/* Algoritmos de compresión disponibles */
+typedef enum {
+    COMP_RLEVAR,
+    COMP_LZW,
+    COMP_LZWPRED,
+    COMP_HUFFMANPRED,
+    COMP_DELTA16_LZW,
+    COMP_DELTA16_HUFF
+} CompAlg;
+
+/* Comprime un bloque con el algoritmo indicado (predictor incluido en
+ * los modos *-pred). Solo para algoritmos por bloques: los delta16 se
+ * aplican sobre muestras WAV en el pipeline y aquí devuelven -1.
+ * lzw: contexto LZW a usar (NULL = el del hilo, ver codec.c).
+ * Salida malloc en *out (el llamador libera). 0 = ok, -1 = error. */
+int codec_compress(CompAlg alg, lzw_ctx* lzw,
+                   const uint8_t* in, size_t in_len,
+                   uint8_t** out, size_t* out_len);
+
+/* Cota del tamaño comprimido de in_len bytes (0 si alg no es por bloques). */
+size_t codec_compress_bound(CompAlg alg, size_t in_len);
+
+/* Como codec_compress pero escribe en un buffer del llamador out[0..cap).
+ * Con cap >= codec_compress_bound(alg, in_len) siempre cabe; si no,
+ * puede fallar con -1. *out_len = bytes escritos. Mismo formato. */
+int codec_compress_into(CompAlg alg, lzw_ctx* lzw,
+                        const uint8_t* in, size_t in_len,
+                        uint8_t* out, size_t cap, size_t* out_len);
+
+/* Inverso de codec_compress (deshace el predictor si corresponde). */
+int codec_decompress(CompAlg alg,
+                     const uint8_t* in, size_t in_len,
+                     uint8_t** out, size_t* out_len);
+
+/* Como codec_decompress pero en un buffer del llamador out[0..cap) (el
+ * tamaño original sale del índice de chunks). -1 si no cabe o está
+ * corrupto. */
+int codec_decompress_into(CompAlg alg,
+                          const uint8_t* in, size_t in_len,
+                          uint8_t* out, size_t cap, size_t* out_len);
+
+/* Arena del hilo actual para temporales de vida corta (arena.h): quien
+ * la usa toma una marca y la libera al terminar (los chunks lo hacen al
+ * final de cada tarea). NULL si no hay memoria. */
+Arena* codec_arena(void);
+
+/* arena_release sobre la arena del hilo. Con --mem-budget, si la arena
+ * queda vacía no retiene más de unos KB: los bytes del chunk vuelven al
+ * presupuesto y no pueden quedar residentes en el hilo. */
+void codec_arena_release(Arena* ar, ArenaMark m);
+
+/* Libera los contextos que dejaron los hilos ya terminados (se guardan
+ * para el próximo hilo que los pida). Los de hilos vivos no se tocan. */
+void codec_scratch_trim(void);
+
+/* delta16 para audio: WAV PCM16 -> muestras -> diferencias entre muestras
+ * del mismo canal -> LZW (COMP_DELTA16_LZW) o Huffman (COMP_DELTA16_HUFF).
+ * La salida lleva la cabecera CODEC_WAV_MAGIC | u16 canales | u32 sample
+ * rate | u32 frames para reconstruir el WAV.
+ * Devuelve 0 = ok, 1 = la entrada no es WAV PCM16 (usar otro camino),
+ * -1 = error. */
+#define CODEC_WAV_MAGIC "GSEAWAV1"
+int codec_wav_compress(CompAlg alg, const uint8_t* in, size_t in_len,
+                       uint8_t** out, size_t* out_len);
+
+/* 1 si el buffer empieza con la cabecera de codec_wav_compress. */
+int codec_wav_is_packed(const uint8_t* in, size_t in_len);
+
+/* Inverso de codec_wav_compress: devuelve el WAV completo. 0 = ok. */
+int codec_wav_decompress(CompAlg alg, const uint8_t* in, size_t in_len,
+                         uint8_t** out, size_t* out_len);
+
+/* Kernels sueltos (los usan los modos de arriba; expuestos para el
+ * microbenchmark de bench/):
+ * - SUB: cada byte pasa a ser la diferencia con el anterior del mismo
+ *   canal, por filas de w píxeles (en los modos *-pred se llama con 1,1,1).
+ * - delta16: lo mismo sobre muestras PCM16 intercaladas por canal. */
+void codec_sub_forward(uint8_t* buf, int w, int h, int ch);
+void codec_sub_inverse(uint8_t* buf, int w, int h, int ch);
+void codec_delta16_forward(int16_t* s, size_t frames, int ch);
+void codec_delta16_inverse(int16_t* s, size_t frames, int ch);
+
+/* Nombre corto del algoritmo (el mismo que acepta --comp-alg). */
+const char* codec_name(CompAlg alg);
+
+#endif
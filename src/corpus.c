@@ -0,0 +1,422 @@
+/* =============================================================
+ * corpus.c - Generador determinista de corpus para benchmarks
+ * -------------------------------------------------------------
+ * "gsea gen-corpus -o DIR" crea:
+ *   text/english.txt    palabras con frecuencia tipo Zipf, frases
+ *   text/app.log        líneas de log con timestamps crecientes
+ *   bin/random.bin      bytes aleatorios (peor caso)
+ *   bin/sparse.bin      mayoría ceros con registros dispersos
+ *   bin/ramp.bin        rampas suaves de 8 bits (predictor SUB)
+ *   audio/mono.wav      PCM16 mono: tonos + ruido (delta16)
+ *   audio/stereo.wav    PCM16 estéreo: acorde + ruido
+ *   image/gradient.png  degradados con figuras (RGB)
+ *   image/photo.jpg     textura suave tipo foto (RGB)
+ *   small/NNNN.txt      muchos archivos de 1-16 KB (lotes)
+ *   MANIFEST.txt        crc32, tamaño y nombre de cada archivo
+ * Todo sale de un PRNG propio (splitmix64) sembrado con --seed,
+ * nunca de rand() ni de la hora, y el seno se calcula con una serie
+ * propia (solo + - * /, exactos en IEEE-754) en vez de libm: así el
+ * mismo comando produce los mismos bytes en cualquier Linux (el
+ * MANIFEST permite comprobarlo).
+ * --size-mb escala los archivos grandes (default 4).
+ * ============================================================= */
+#include "corpus.h"
+#include "audio_wav.h"
+#include "image_png.h"
+#include "image_jpeg.h"
+#include "crc32.h"
+#include "fs.h"
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define CORPUS_DEFAULT_MB    4
+#define CORPUS_DEFAULT_SEED  42
+#define CORPUS_SMALL_FILES   256
+#define CORPUS_SAMPLE_RATE   44100
+
+/* ---------- PRNG determinista (splitmix64) ---------- */
+typedef struct { uint64_t s; } Rng;
+
+static uint64_t rng_next(Rng* r) {
+    uint64_t z = (r->s += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/* Entero uniforme en [0, n) */
+static uint32_t rng_below(Rng* r, uint32_t n) {
+    return n ? (uint32_t)(rng_next(r) % n) : 0;
+}
+
+/* Ruido aproximadamente gaussiano en [-1, 1] (suma de 4 uniformes) */
+static double rng_noise(Rng* r) {
+    double s = 0;
+    for (int i = 0; i < 4; i++) s += (double)(rng_next(r) >> 11) / 9007199254740992.0;
+    return (s - 2.0) / 2.0;
+}
+
+/* ---------- Seno determinista ---------- */
+#define CORPUS_PI 3.14159265358979323846
+
+/* sin(x) por serie de Taylor tras reducir a [-pi, pi]; error < 1e-9,
+ * de sobra para muestras de 16 bits y píxeles de 8. */
+static double det_sin(double x) {
+    double k = (double)(long long)(x / (2.0 * CORPUS_PI));
+    x -= k * 2.0 * CORPUS_PI;
+    if (x > CORPUS_PI) x -= 2.0 * CORPUS_PI;
+    if (x < -CORPUS_PI) x += 2.0 * CORPUS_PI;
+    double x2 = x * x, term = x, sum = x;
+    for (int n = 1; n < 12; n++) {
+        term *= -x2 / (double)((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+static double det_cos(double x) { return det_sin(x + CORPUS_PI / 2.0); }
+
+/* ---------- Buffer de texto creciente ---------- */
+typedef struct { char* p; size_t n, cap; } TextBuf;
+
+static int tb_put(TextBuf* t, const char* s, size_t n) {
+    if (t->n + n + 1 > t->cap) {
+        size_t nc = t->cap ? t->cap * 2 : 65536;
+        while (nc < t->n + n + 1) nc *= 2;
+        char* q = realloc(t->p, nc);
+        if (!q) return -1;
+        t->p = q; t->cap = nc;
+    }
+    memcpy(t->p + t->n, s, n);
+    t->n += n;
+    t->p[t->n] = '\0';
+    return 0;
+}
+
+static int tb_puts(TextBuf* t, const char* s) { return tb_put(t, s, strlen(s)); }
+
+/* ---------- Escritura + manifiesto ---------- */
+typedef struct {
+    const char* root;
+    TextBuf manifest;
+    size_t n_files;
+    uint64_t bytes;
+} Out;
+
+static int out_write(Out* o, const char* rel, const uint8_t* buf, size_t len) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", o->root, rel);
+    if (write_file(path, buf, len) != 0) {
+        fprintf(stderr, "gen-corpus: no se pudo escribir %s\n", path);
+        return -1;
+    }
+    char line[512];
+    snprintf(line, sizeof(line), "%08x %12zu %s\n", crc32_update(0, buf, len), len, rel);
+    tb_puts(&o->manifest, line);
+    o->n_files++;
+    o->bytes += len;
+    return 0;
+}
+
+/* ---------- Texto ---------- */
+static const char* const WORDS[] = {
+    "the", "of", "and", "to", "a", "in", "is", "it", "that", "was", "for", "on",
+    "are", "with", "as", "his", "they", "be", "at", "one", "have", "this", "from",
+    "by", "hot", "word", "but", "what", "some", "we", "can", "out", "other", "were",
+    "all", "there", "when", "up", "use", "your", "how", "said", "an", "each", "she",
+    "which", "do", "their", "time", "if", "will", "way", "about", "many", "then",
+    "them", "write", "would", "like", "so", "these", "her", "long", "make", "thing",
+    "see", "him", "two", "has", "look", "more", "day", "could", "go", "come", "did",
+    "number", "sound", "no", "most", "people", "my", "over", "know", "water", "than",
+    "call", "first", "who", "may", "down", "side", "been", "now", "find", "compression",
+    "thread", "buffer", "stream", "archive", "dictionary", "entropy", "symbol"
+};
+#define N_WORDS (sizeof(WORDS) / sizeof(WORDS[0]))
+
+/* Índice con sesgo tipo Zipf: las primeras palabras salen mucho más */
+static const char* zipf_word(Rng* r) {
+    uint32_t a = rng_below(r, N_WORDS), b = rng_below(r, N_WORDS);
+    return WORDS[(a * b) / N_WORDS];
+}
+
+static int gen_english(Out* o, Rng* r, size_t target) {
+    TextBuf t = {0};
+    while (t.n < target) {
+        uint32_t words = 6 + rng_below(r, 14);
+        for (uint32_t w = 0; w < words; w++) {
+            const char* s = zipf_word(r);
+            if (w == 0) {
+                char cap[32];
+                snprintf(cap, sizeof(cap), "%s", s);
+                if (cap[0] >= 'a' && cap[0] <= 'z') cap[0] = (char)(cap[0] - 'a' + 'A');
+                tb_puts(&t, cap);
+            } else {
+                tb_puts(&t, " ");
+                tb_puts(&t, s);
+                if (rng_below(r, 12) == 0) tb_puts(&t, ",");
+            }
+        }
+        tb_puts(&t, rng_below(r, 8) == 0 ? "?" : ".");
+        tb_puts(&t, rng_below(r, 5) == 0 ? "\n\n" : " ");
+    }
+    int rc = out_write(o, "text/english.txt", (const uint8_t*)t.p, target);
+    free(t.p);
+    return rc;
+}
+
+static int gen_log(Out* o, Rng* r, size_t target) {
+    static const char* const LEVELS[] = { "INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR" };
+    static const char* const PATHS[] = { "/api/v1/users", "/api/v1/orders", "/health",
+                                         "/api/v1/search", "/static/app.js", "/login" };
+    TextBuf t = {0};
+    uint64_t ms = 1704067200000ull; /* 2024-01-01T00:00:00Z */
+    char line[256];
+    while (t.n < target) {
+        ms += 1 + rng_below(r, 40);
+        uint64_t s = ms / 1000;
+        unsigned hh = (unsigned)((s / 3600) % 24), mm = (unsigned)((s / 60) % 60), ss = (unsigned)(s % 60);
+        unsigned day = 1 + (unsigned)((s - 1704067200ull) / 86400) % 28;
+        const char* lvl = LEVELS[rng_below(r, 6)];
+        const char* path = PATHS[rng_below(r, 6)];
+        unsigned status = lvl[0] == 'E' ? 500 : (rng_below(r, 20) == 0 ? 404 : 200);
+        /* cada valor en su propia sentencia: el orden de evaluación de
+         * los argumentos de snprintf no está definido */
+        unsigned worker = rng_below(r, 16);
+        const char* method = rng_below(r, 4) ? "GET" : "POST";
+        unsigned latency = 1 + rng_below(r, 250);
+        unsigned req = (unsigned)rng_next(r);
+        snprintf(line, sizeof(line),
+                 "2024-01-%02uT%02u:%02u:%02u.%03uZ %-5s [worker-%u] %s %s status=%u "
+                 "latency_ms=%u req=%08x\n",
+                 day, hh, mm, ss, (unsigned)(ms % 1000), lvl, worker,
+                 method, path, status, latency, req);
+        tb_puts(&t, line);
+    }
+    int rc = out_write(o, "text/app.log", (const uint8_t*)t.p, target);
+    free(t.p);
+    return rc;
+}
+
+/* Muchos archivos pequeños: ejercita el modo carpeta con lotes */
+static int gen_small(Out* o, Rng* r) {
+    int rc = 0;
+    for (int i = 0; i < CORPUS_SMALL_FILES && rc == 0; i++) {
+        size_t target = 1024 + rng_below(r, 15 * 1024);
+        TextBuf t = {0};
+        char line[128];
+        int k = 0;
+        while (t.n < target) {
+            const char* w1 = zipf_word(r);
+            const char* w2 = zipf_word(r);
+            unsigned v = rng_below(r, 100000);
+            snprintf(line, sizeof(line), "key_%04d_%03d = %s %s %u\n", i, k++, w1, w2, v);
+            tb_puts(&t, line);
+        }
+        char rel[64];
+        snprintf(rel, sizeof(rel), "small/%04d.txt", i);
+        rc = out_write(o, rel, (const uint8_t*)t.p, target);
+        free(t.p);
+    }
+    return rc;
+}
+
+/* ---------- Binarios ---------- */
+static int gen_random(Out* o, Rng* r, size_t n) {
+    uint8_t* b = malloc(n);
+    if (!b) return -1;
+    for (size_t i = 0; i < n; i += 8) {
+        uint64_t v = rng_next(r);
+        for (size_t k = 0; k < 8 && i + k < n; k++) b[i + k] = (uint8_t)(v >> (8 * k));
+    }
+    int rc = out_write(o, "bin/random.bin", b, n);
+    free(b);
+    return rc;
+}
+
+static int gen_sparse(Out* o, Rng* r, size_t n) {
+    uint8_t* b = calloc(n ? n : 1, 1);
+    if (!b) return -1;
+    /* registros de 16-256 bytes cada ~4 KB, el resto ceros */
+    for (size_t pos = rng_below(r, 4096); pos < n; pos += 1024 + rng_below(r, 6144)) {
+        size_t len = 16 + rng_below(r, 240);
+        for (size_t k = 0; k < len && pos + k < n; k++)
+            b[pos + k] = (k < 8) ? (uint8_t)(0xA0 + k) : (uint8_t)rng_next(r);
+    }
+    int rc = out_write(o, "bin/sparse.bin", b, n);
+    free(b);
+    return rc;
+}
+
+static int gen_ramp(Out* o, Rng* r, size_t n) {
+    uint8_t* b = malloc(n ? n : 1);
+    if (!b) return -1;
+    /* tramos con pendiente constante: tras SUB quedan valores casi fijos */
+    size_t i = 0;
+    uint8_t v = 0;
+    while (i < n) {
+        size_t run = 256 + rng_below(r, 4096);
+        int step = (int)rng_below(r, 5) - 2;
+        for (size_t k = 0; k < run && i < n; k++, i++) {
+            v = (uint8_t)(v + step);
+            b[i] = v;
+        }
+    }
+    int rc = out_write(o, "bin/ramp.bin", b, n);
+    free(b);
+    return rc;
+}
+
+/* ---------- Audio ---------- */
+static int gen_wav(Out* o, Rng* r, const char* rel, int channels, size_t bytes) {
+    static const double FREQS[] = { 220.0, 277.18, 329.63, 440.0 };
+    size_t frames = bytes / (2 * (size_t)channels);
+    int16_t* s = malloc(frames * channels * sizeof(int16_t) + 1);
+    if (!s) return -1;
+    for (size_t i = 0; i < frames; i++) {
+        double t = (double)i / CORPUS_SAMPLE_RATE;
+        /* la envolvente cambia de nota cada medio segundo */
+        int note = (int)(t * 2.0) % 4;
+        for (int c = 0; c < channels; c++) {
+            double f = FREQS[(note + c) % 4];
+            double x = 0.45 * det_sin(2.0 * CORPUS_PI * f * t) + 0.15 * det_sin(2.0 * CORPUS_PI * 2.0 * f * t)
+                     + 0.02 * rng_noise(r);
+            if (x > 1.0) x = 1.0;
+            if (x < -1.0) x = -1.0;
+            s[i * channels + c] = (int16_t)(x * 32000.0);
+        }
+    }
+    uint8_t* wav = NULL;
+    size_t wav_len = 0;
+    int rc = wav_encode_pcm16(s, frames, channels, CORPUS_SAMPLE_RATE, &wav, &wav_len);
+    free(s);
+    if (rc != 0) return -1;
+    rc = out_write(o, rel, wav, wav_len);
+    free(wav);
+    return rc;
+}
+
+/* ---------- Imágenes ---------- */
+static int gen_png(Out* o, Rng* r, int w, int h) {
+    uint8_t* px = malloc((size_t)w * h * 3);
+    if (!px) return -1;
+    int cx = w / 3 + (int)rng_below(r, (uint32_t)(w / 3)), cy = h / 2;
+    int rad = h / 4;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            uint8_t* p = px + ((size_t)y * w + x) * 3;
+            p[0] = (uint8_t)(x * 255 / (w - 1));
+            p[1] = (uint8_t)(y * 255 / (h - 1));
+            p[2] = (uint8_t)((x + y) * 255 / (w + h - 2));
+            int dx = x - cx, dy = y - cy;
+            if (dx * dx + dy * dy < rad * rad) { p[0] = 240; p[1] = 200; p[2] = 40; }
+            if (x > w * 3 / 4 && y > h / 8 && y < h / 3) { p[0] = 20; p[1] = 60; p[2] = 160; }
+        }
+    }
+    uint8_t* png = NULL;
+    size_t png_len = 0;
+    int rc = png_encode_image(px, (size_t)w * h * 3, w, h, 3, &png, &png_len);
+    free(px);
+    if (rc != 0) return -1;
+    rc = out_write(o, "image/gradient.png", png, png_len);
+    free(png);
+    return rc;
+}
+
+static int gen_jpeg(Out* o, Rng* r, int w, int h) {
+    uint8_t* px = malloc((size_t)w * h * 3);
+    if (!px) return -1;
+    /* "foto": ondas de baja frecuencia + grano */
+    double fx = 0.01 + rng_below(r, 100) / 10000.0, fy = 0.013 + rng_below(r, 100) / 10000.0;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            uint8_t* p = px + ((size_t)y * w + x) * 3;
+            double base = 0.5 + 0.25 * det_sin(x * fx) + 0.25 * det_cos(y * fy);
+            for (int c = 0; c < 3; c++) {
+                double v = base * (200 + 20 * c) + 8.0 * rng_noise(r);
+                p[c] = (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+            }
+        }
+    }
+    uint8_t* jpg = NULL;
+    size_t jpg_len = 0;
+    int rc = jpeg_encode_image(px, (size_t)w * h * 3, w, h, 3, &jpg, &jpg_len);
+    free(px);
+    if (rc != 0) return -1;
+    rc = out_write(o, "image/photo.jpg", jpg, jpg_len);
+    free(jpg);
+    return rc;
+}
+
+/* ---------- Entrada ---------- */
+static void corpus_usage(void) {
+    fprintf(stderr,
+        "Uso: gsea gen-corpus -o <carpeta> [--size-mb N] [--seed N]\n"
+        "  --size-mb N   tamaño de los archivos grandes (default %d)\n"
+        "  --seed N      semilla del generador (default %d)\n",
+        CORPUS_DEFAULT_MB, CORPUS_DEFAULT_SEED);
+}
+
+int corpus_main(int argc, char* argv[]) {
+    const char* out_dir = NULL;
+    long size_mb = CORPUS_DEFAULT_MB;
+    unsigned long long seed = CORPUS_DEFAULT_SEED;
+
+    static struct option long_opts[] = {
+        {"size-mb", required_argument, 0, 1},
+        {"seed",    required_argument, 0, 2},
+        {0,0,0,0}
+    };
+    optind = 1;
+    int opt, idx = 0;
+    while ((opt = getopt_long(argc, argv, "o:", long_opts, &idx)) != -1) {
+        switch (opt) {
+            case 'o': out_dir = optarg; break;
+            case 1:   size_mb = atol(optarg); break;
+            case 2:   seed = strtoull(optarg, NULL, 10); break;
+            default:  corpus_usage(); return 1;
+        }
+    }
+    if (!out_dir || size_mb < 1 || size_mb > 4096) { corpus_usage(); return 1; }
+
+    const char* subdirs[] = { "", "/text", "/bin", "/audio", "/image", "/small" };
+    for (size_t i = 0; i < sizeof(subdirs) / sizeof(subdirs[0]); i++) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s%s", out_dir, subdirs[i]);
+        mkdir(path, 0755);
+    }
+
+    Out o = { .root = out_dir };
+    size_t big = (size_t)size_mb * 1024 * 1024;
+    /* imagen con ~big/2 bytes de píxeles RGB (mínimo 256x256) */
+    int side = 256;
+    while ((size_t)(side + 16) * (side + 16) * 6 <= big) side += 16;
+
+    /* Un generador por archivo: cambiar uno no altera los demás */
+    Rng r;
+    int rc = 0;
+    r.s = seed ^ 0x01; if (!rc) rc = gen_english(&o, &r, big);
+    r.s = seed ^ 0x02; if (!rc) rc = gen_log(&o, &r, big);
+    r.s = seed ^ 0x03; if (!rc) rc = gen_random(&o, &r, big);
+    r.s = seed ^ 0x04; if (!rc) rc = gen_sparse(&o, &r, big);
+    r.s = seed ^ 0x05; if (!rc) rc = gen_ramp(&o, &r, big);
+    r.s = seed ^ 0x06; if (!rc) rc = gen_wav(&o, &r, "audio/mono.wav", 1, big / 2);
+    r.s = seed ^ 0x07; if (!rc) rc = gen_wav(&o, &r, "audio/stereo.wav", 2, big);
+    r.s = seed ^ 0x08; if (!rc) rc = gen_png(&o, &r, side, side);
+    r.s = seed ^ 0x09; if (!rc) rc = gen_jpeg(&o, &r, side, side);
+    r.s = seed ^ 0x0A; if (!rc) rc = gen_small(&o, &r);
+
+    if (rc == 0) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", out_dir, CORPUS_MANIFEST);
+        rc = write_file(path, (const uint8_t*)o.manifest.p, o.manifest.n);
+    }
+    free(o.manifest.p);
+    if (rc != 0) return 1;
+
+    printf("Corpus en %s: %zu archivos, %.2f MB (seed %llu)\n",
+           out_dir, o.n_files, o.bytes / (1024.0 * 1024.0), seed);
+    return 0;
+}
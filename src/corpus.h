@@ -0,0 +1,23 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Subcomando "gsea gen-corpus": genera de forma determinista (misma
+ * semilla = mismos bytes en cualquier máquina) un corpus que cubre todos
+ * los caminos del pipeline: texto, logs, aleatorio, binario disperso,
+ * rampas para el predictor SUB, WAV PCM16 (delta16), PNG/JPEG y una
+ * carpeta de archivos pequeños (lotes). argv[0] es "gen-corpus". */
+int corpus_main(int argc, char* argv[]);
+
+/* Nombre del manifiesto (crc32, tamaño y nombre por archivo) que
+ * gen-corpus deja en la raíz; no es parte de los datos a medir. */
+#define CORPUS_MANIFEST "MANIFEST.txt"
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORPUS_H */
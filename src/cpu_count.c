@@ -0,0 +1,190 @@
+/* =============================================================
+ * cpu_count.c - Detección de CPUs disponibles para el proceso
+ * -------------------------------------------------------------
+ * sysconf(_SC_NPROCESSORS_ONLN) devuelve los núcleos de la máquina,
+ * no los que el proceso puede usar. Dentro de un contenedor con
+ * cuota (ej: 4 CPUs en un host de 96) eso crea demasiados hilos y
+ * el kernel los estrangula (throttling). Aquí se combinan:
+ *   - sched_getaffinity: CPUs donde el proceso puede correr.
+ *   - cgroup v2: archivo cpu.max ("cuota periodo" o "max periodo").
+ *   - cgroup v1: cpu.cfs_quota_us / cpu.cfs_period_us.
+ *   - GSEA_THREADS: override manual (tiene prioridad).
+ * La cuota se redondea hacia arriba (1.5 CPUs -> 2 hilos).
+ * Para cgroups se recorre la ruta desde el grupo del proceso hasta
+ * la raíz del montaje y se toma la cuota más restrictiva.
+ * ============================================================= */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "cpu_count.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#define CG_ROOT "/sys/fs/cgroup"
+
+/* Lee la primera línea de un archivo pequeño. Devuelve 0 si ok. */
+static int read_line(const char* path, char* buf, size_t cap) {
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+    int ok = (fgets(buf, (int)cap, f) != NULL);
+    fclose(f);
+    return ok ? 0 : -1;
+}
+
+/* Convierte cuota/periodo a hilos (redondeo hacia arriba). 0 = sin límite. */
+static int quota_to_threads(long long quota, long long period) {
+    if (quota <= 0 || period <= 0) return 0;
+    long long n = (quota + period - 1) / period;
+    return (n < 1) ? 1 : (int)n;
+}
+
+/* cgroup v2: "max 100000" o "400000 100000" */
+static int cg2_limit_at(const char* dir) {
+    char path[1024], line[128];
+    snprintf(path, sizeof(path), "%s/cpu.max", dir);
+    if (read_line(path, line, sizeof(line)) != 0) return 0;
+    if (strncmp(line, "max", 3) == 0) return 0;
+    long long quota = 0, period = 0;
+    if (sscanf(line, "%lld %lld", &quota, &period) != 2) return 0;
+    return quota_to_threads(quota, period);
+}
+
+/* cgroup v1: cfs_quota_us = -1 significa sin límite */
+static int cg1_limit_at(const char* dir) {
+    char path[1024], line[64];
+    snprintf(path, sizeof(path), "%s/cpu.cfs_quota_us", dir);
+    if (read_line(path, line, sizeof(line)) != 0) return 0;
+    long long quota = atoll(line);
+    snprintf(path, sizeof(path), "%s/cpu.cfs_period_us", dir);
+    if (read_line(path, line, sizeof(line)) != 0) return 0;
+    long long period = atoll(line);
+    return quota_to_threads(quota, period);
+}
+
+/* Recorre mount/rel, mount/padre(rel), ..., mount y devuelve el menor
+ * límite encontrado (0 si ninguno). */
+static int cg_walk(const char* mount, const char* rel, int (*limit_at)(const char*)) {
+    char dir[1024];
+    int best = 0;
+    snprintf(dir, sizeof(dir), "%s%s", mount, (rel && strcmp(rel, "/") != 0) ? rel : "");
+    size_t root_len = strlen(mount);
+    for (;;) {
+        int n = limit_at(dir);
+        if (n > 0 && (best == 0 || n < best)) best = n;
+        if (strlen(dir) <= root_len) break;
+        char* slash = strrchr(dir, '/');
+        if (!slash || (size_t)(slash - dir) < root_len) break;
+        *slash = '\0';
+    }
+    return best;
+}
+
+/* ¿La lista "cpu,cpuacct" contiene exactamente el controlador "cpu"? */
+static int has_cpu_controller(const char* list) {
+    const char* p = list;
+    while (*p) {
+        const char* end = strchr(p, ',');
+        size_t n = end ? (size_t)(end - p) : strlen(p);
+        if (n == 3 && strncmp(p, "cpu", 3) == 0) return 1;
+        if (!end) break;
+        p = end + 1;
+    }
+    return 0;
+}
+
+/* Límite de cgroup según /proc/self/cgroup. 0 = sin límite / desconocido. */
+static int cgroup_cpu_limit(void) {
+    FILE* f = fopen("/proc/self/cgroup", "r");
+    if (!f) return 0;
+
+    int best = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\n")] = '\0';
+        /* formato: id:controladores:ruta */
+        char* c1 = strchr(line, ':');
+        if (!c1) continue;
+        char* c2 = strchr(c1 + 1, ':');
+        if (!c2) continue;
+        *c2 = '\0';
+        const char* ctrls = c1 + 1;
+        const char* rel = c2 + 1;
+
+        int n = 0;
+        if (ctrls[0] == '\0') {
+            /* cgroup v2 (jerarquía unificada) */
+            n = cg_walk(CG_ROOT, rel, cg2_limit_at);
+            if (n == 0) n = cg_walk(CG_ROOT "/unified", rel, cg2_limit_at);
+        } else if (has_cpu_controller(ctrls)) {
+            char mount[512];
+            snprintf(mount, sizeof(mount), CG_ROOT "/%s", ctrls);
+            n = cg_walk(mount, rel, cg1_limit_at);
+            if (n == 0) n = cg_walk(CG_ROOT "/cpu", rel, cg1_limit_at);
+            if (n == 0) n = cg_walk(CG_ROOT "/cpu,cpuacct", rel, cg1_limit_at);
+        }
+        if (n > 0 && (best == 0 || n < best)) best = n;
+    }
+    fclose(f);
+    return best;
+}
+
+/* CPUs en la máscara de afinidad. 0 = desconocido. */
+static int affinity_cpus(void) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return 0;
+    return CPU_COUNT(&set);
+}
+
+int cpu_count_affinity(void) {
+    int aff = affinity_cpus();
+    if (aff > 0) return aff;
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    return (online > 0) ? (int)online : 1;
+}
+
+int cpu_count_refresh(void) {
+    const char* env = getenv("GSEA_THREADS");
+    if (env && *env) {
+        int v = atoi(env);
+        if (v > 0) return v;
+    }
+
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    int n = (online > 0) ? (int)online : 1;
+
+    int aff = affinity_cpus();
+    if (aff > 0 && aff < n) n = aff;
+
+    int quota = cgroup_cpu_limit();
+    if (quota > 0 && quota < n) n = quota;
+
+    return (n < 1) ? 1 : n;
+}
+
+/* Caché compartida entre hilos */
+static pthread_mutex_t g_mtx = PTHREAD_MUTEX_INITIALIZER;
+static int g_cached = 0;
+static struct timespec g_stamp;
+
+int cpu_count_available(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    pthread_mutex_lock(&g_mtx);
+    double age_ms = (now.tv_sec - g_stamp.tv_sec) * 1000.0 +
+                    (now.tv_nsec - g_stamp.tv_nsec) / 1e6;
+    if (g_cached == 0 || age_ms >= CPU_COUNT_TTL_MS) {
+        g_cached = cpu_count_refresh();
+        g_stamp = now;
+    }
+    int n = g_cached;
+    pthread_mutex_unlock(&g_mtx);
+    return n;
+}
@@ -0,0 +1,25 @@
+#ifndef CPU_COUNT_H
+#define CPU_COUNT_H
+
+/* Cantidad de hilos de CPU que este proceso puede usar de verdad.
+ * Orden de prioridad:
+ *   1. Variable de entorno GSEA_THREADS (si es un entero > 0).
+ *   2. min(CPUs en la afinidad del proceso, cuota de cgroup v1/v2).
+ *   3. sysconf(_SC_NPROCESSORS_ONLN) si lo anterior no está disponible.
+ * El resultado se cachea y se vuelve a leer pasados CPU_COUNT_TTL_MS,
+ * así los modos largos (carpetas) ven cambios de cuota sin reiniciar.
+ * Devuelve siempre >= 1.
+ */
+int cpu_count_available(void);
+
+/* Igual que cpu_count_available() pero ignora la caché. */
+int cpu_count_refresh(void);
+
+/* CPUs en la afinidad del proceso, sin aplicar cuota (techo para pools
+ * cuyo cupo se ajusta luego con la cuota vigente). Devuelve >= 1. */
+int cpu_count_affinity(void);
+
+/* Tiempo de vida de la caché en milisegundos */
+#define CPU_COUNT_TTL_MS 2000
+
+#endif
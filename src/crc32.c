@@ -0,0 +1,28 @@
+/* =============================================================
+ * crc32.c - Suma de verificación CRC-32 (polinomio 0xEDB88320)
+ * -------------------------------------------------------------
+ * Implementación por tabla de 256 entradas (un byte por paso).
+ * La tabla se construye una sola vez de forma segura entre hilos.
+ * ============================================================= */
+#include "crc32.h"
+#include <pthread.h>
+
+static uint32_t g_table[256];
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+
+static void build_table(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+        g_table[i] = c;
+    }
+}
+
+uint32_t crc32_update(uint32_t crc, const uint8_t* buf, size_t len) {
+    pthread_once(&g_once, build_table);
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+        crc = g_table[(crc ^ buf[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
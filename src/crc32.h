@@ -0,0 +1,12 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* CRC-32 (IEEE 802.3, el mismo de zlib/PNG).
+ * Uso incremental: crc = crc32_update(0, a, na); crc = crc32_update(crc, b, nb);
+ */
+uint32_t crc32_update(uint32_t crc, const uint8_t* buf, size_t len);
+
+#endif
@@ -1,9 +1,12 @@
 #include "fs.h"
+#include "bigbuf.h"
+#include "bufpool.h"
 #include <stdlib.h>
 #include <stdint.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <errno.h>
 
 // =============================================================================
@@ -25,7 +28,10 @@
 //
 // Nota: El buffer devuelto está en memoria dinámica (malloc), por lo que el
 //       llamador debe liberar la memoria con free() cuando ya no la necesite.
-int read_file(const char* path, uint8_t** out_buf, size_t* out_len) {
+//
+// read_whole es el cuerpo común: alloc/release deciden de dónde sale el buffer.
+static int read_whole(const char* path, void* (*alloc)(size_t), void (*release)(void*),
+                      uint8_t** out_buf, size_t* out_len) {
     // Validar que los parámetros no sean NULL
     if (!path || !out_buf || !out_len) return -1;
     *out_buf = NULL; *out_len = 0;
@@ -41,9 +47,10 @@ int read_file(const char* path, uint8_t** out_buf, size_t* out_len) {
     // Verificar que sea un archivo regular (no un directorio o dispositivo)
     if (!S_ISREG(st.st_mode)) { close(fd); errno = EISDIR; return -1; }
 
-    // Reservar memoria para almacenar todo el archivo
+    // Reservar memoria para almacenar todo el archivo (archivos grandes:
+    // alineado a huge page, ver bigbuf.c; se libera igual con free)
     size_t n = (size_t)st.st_size;
-    uint8_t* buf = (uint8_t*)malloc(n ? n : 1);  // Si el archivo está vacío, asignar 1 byte mínimo
+    uint8_t* buf = (uint8_t*)alloc(n ? n : 1);  // Si el archivo está vacío, asignar 1 byte mínimo
     if (!buf) { close(fd); return -1; }  // Sin memoria disponible
 
     // Leer el archivo en bloques hasta obtener todo el contenido
@@ -51,7 +58,7 @@ int read_file(const char* path, uint8_t** out_buf, size_t* out_len) {
     size_t off = 0;
     while (off < n) {
         ssize_t r = read(fd, buf + off, n - off);
-        if (r < 0) { free(buf); close(fd); return -1; }  // Error de lectura
+        if (r < 0) { release(buf); close(fd); return -1; }  // Error de lectura
         if (r == 0) break;  // Fin del archivo
         off += (size_t)r;   // Avanzar la posición en el buffer
     }
@@ -63,6 +70,19 @@ int read_file(const char* path, uint8_t** out_buf, size_t* out_len) {
     return 0;
 }
 
+int read_file(const char* path, uint8_t** out_buf, size_t* out_len) {
+    return read_whole(path, bigbuf_alloc, free, out_buf, out_len);
+}
+
+// -----------------------------------------------------------------------------
+// read_file_pooled: igual que read_file pero el buffer sale de bufpool
+// -----------------------------------------------------------------------------
+// Nota: el buffer se devuelve con bufpool_put (no free): así el archivo
+//       siguiente del pipeline reutiliza las mismas páginas ya mapeadas.
+int read_file_pooled(const char* path, uint8_t** out_buf, size_t* out_len) {
+    return read_whole(path, bufpool_get, bufpool_put, out_buf, out_len);
+}
+
 // -----------------------------------------------------------------------------
 // write_file: Escribe TODO el contenido de un buffer en un archivo
 // -----------------------------------------------------------------------------
@@ -104,3 +124,123 @@ int write_file(const char* path, const uint8_t* buf, size_t len) {
     if (close(fd) != 0) return -1;
     return 0;
 }
+
+// -----------------------------------------------------------------------------
+// read_file_reuse: igual que read_file pero sobre un buffer reutilizable
+// -----------------------------------------------------------------------------
+// Parámetros:
+//   - path: ruta del archivo a leer
+//   - buf / cap: buffer actual y su capacidad; se agranda con realloc solo si
+//     el archivo no cabe (el llamador sigue siendo dueño y lo libera al final)
+//   - out_len: bytes leídos
+//
+// Retorna: 0 si tuvo éxito, -1 si hubo algún error
+//
+// Nota: pensado para lotes de archivos pequeños: evita un malloc/free por
+//       archivo cuando se procesan miles seguidos en el mismo hilo.
+int read_file_reuse(const char* path, uint8_t** buf, size_t* cap, size_t* out_len) {
+    if (!path || !buf || !cap || !out_len) return -1;
+    *out_len = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return -1; }
+    if (!S_ISREG(st.st_mode)) { close(fd); errno = EISDIR; return -1; }
+
+    size_t n = (size_t)st.st_size;
+    if (!*buf || *cap < (n ? n : 1)) {
+        uint8_t* nb = (uint8_t*)realloc(*buf, n ? n : 1);
+        if (!nb) { close(fd); return -1; }
+        *buf = nb;
+        *cap = n ? n : 1;
+    }
+
+    size_t off = 0;
+    while (off < n) {
+        ssize_t r = read(fd, *buf + off, n - off);
+        if (r < 0) { close(fd); return -1; }
+        if (r == 0) break;
+        off += (size_t)r;
+    }
+    close(fd);
+
+    *out_len = off;
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+// write_file_at: escribe el buffer en 'name' relativo al directorio dirfd
+// -----------------------------------------------------------------------------
+// Igual que write_file pero con openat(): quien escribe muchos archivos en la
+// misma carpeta la abre una vez y evita resolver la ruta completa cada vez.
+int write_file_at(int dirfd, const char* name, const uint8_t* buf, size_t len) {
+    if (!name || (!buf && len>0)) return -1;
+
+    int fd = openat(dirfd, name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+
+    size_t off = 0;
+    while (off < len) {
+        ssize_t w = write(fd, buf + off, len - off);
+        if (w <= 0) { close(fd); return -1; }
+        off += (size_t)w;
+    }
+
+    if (close(fd) != 0) return -1;
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+// write_file_iov / write_file_at_iov: escriben varios trozos con writev
+// -----------------------------------------------------------------------------
+// Para salidas que ya están en memoria en varios pedazos (los chunks
+// comprimidos de chunked.c): se escriben en orden sin juntarlos antes en
+// un buffer contiguo. writev puede escribir menos de lo pedido, así que se
+// avanza sobre la lista hasta terminar (en tandas de WRITEV_BATCH).
+#define WRITEV_BATCH 64
+
+static int writev_all(int fd, const struct iovec* iov, size_t n) {
+    size_t i = 0, off = 0; // iov actual y bytes ya escritos de él
+    while (i < n) {
+        struct iovec v[WRITEV_BATCH];
+        int k = 0;
+        for (size_t j = i; j < n && k < WRITEV_BATCH; j++, k++) {
+            v[k] = iov[j];
+            if (j == i) {
+                v[k].iov_base = (uint8_t*)v[k].iov_base + off;
+                v[k].iov_len -= off;
+            }
+        }
+        ssize_t w = writev(fd, v, k);
+        if (w < 0) return -1;
+        size_t left = (size_t)w;
+        size_t before = i;
+        while (i < n && left >= iov[i].iov_len - off) {
+            left -= iov[i].iov_len - off;
+            i++;
+            off = 0;
+        }
+        off += left;
+        if (w == 0 && i == before) return -1; // no avanza
+    }
+    return 0;
+}
+
+static int write_iov_fd(int fd, const struct iovec* iov, size_t n) {
+    if (fd < 0) return -1;
+    if (writev_all(fd, iov, n) != 0) { close(fd); return -1; }
+    if (close(fd) != 0) return -1;
+    return 0;
+}
+
+int write_file_iov(const char* path, const struct iovec* iov, size_t n) {
+    if (!path || (!iov && n > 0)) return -1;
+    return write_iov_fd(open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644), iov, n);
+}
+
+int write_file_at_iov(int dirfd, const char* name, const struct iovec* iov, size_t n) {
+    if (!name || (!iov && n > 0)) return -1;
+    return write_iov_fd(openat(dirfd, name, O_WRONLY | O_CREAT | O_TRUNC, 0644), iov, n);
+}
@@ -2,11 +2,28 @@
 #define FS_H
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/uio.h>
 
 /* Lee TODO el archivo en memoria (buffer malloc). Devuelve 0 si ok. */
 int read_file(const char* path, uint8_t** out_buf, size_t* out_len);
 
+/* Como read_file pero el buffer sale del pool (bufpool.h); se devuelve
+ * con bufpool_put. */
+int read_file_pooled(const char* path, uint8_t** out_buf, size_t* out_len);
+
 /* Escribe TODO el buffer en path (crea/trunca). Devuelve 0 si ok. */
 int write_file(const char* path, const uint8_t* buf, size_t len);
 
+/* Como read_file pero reutiliza *buf (capacidad *cap), creciéndolo solo si
+ * hace falta. Útil para leer muchos archivos pequeños seguidos. */
+int read_file_reuse(const char* path, uint8_t** buf, size_t* cap, size_t* out_len);
+
+/* Como write_file pero relativo a un directorio ya abierto (openat). */
+int write_file_at(int dirfd, const char* name, const uint8_t* buf, size_t len);
+
+/* Como write_file / write_file_at pero con los datos en n trozos (writev),
+ * escritos en orden sin copiarlos a un buffer contiguo. */
+int write_file_iov(const char* path, const struct iovec* iov, size_t n);
+int write_file_at_iov(int dirfd, const char* name, const struct iovec* iov, size_t n);
+
 #endif
@@ -15,12 +15,14 @@
 // 2. Leemos la longitud original.
 // 3. Decodificamos símbolo por símbolo usando el árbol.
 // 4. Aplicamos el predictor inverso para volver a los bytes originales.
-// Nota: El BitWriter reserva len*3 bytes como tamaño aproximado; en casos
-//       extremos (datos muy incomprimibles) podría quedarse corto. Se podría
-//       mejorar con realocación dinámica.
+// Nota: El tamaño exacto de la salida se calcula antes de escribir (árbol +
+//       longitud + suma de freq * largo de código), así el BitWriter nunca se
+//       queda corto y se escribe directo en el destino final. Las estructuras
+//       de trabajo viven en un hp_ctx reutilizable.
 // ============================================================================
 
 #include "huffman_predictor.h"
+#include "journal.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -51,15 +53,49 @@ typedef struct {
     size_t capacity; // en bits (capacity = len * 8)
 } BitReader;
 
-/* ----------------- Bit I/O helpers ----------------- */
-static BitWriter* bw_create(size_t cap) {
-    BitWriter* bw = malloc(sizeof(BitWriter));
-    bw->data = calloc(cap, 1); // inicializa en cero para evitar basura en bits
-    bw->bit_pos = 0;
-    bw->capacity = cap;
-    return bw;
+// Contexto reutilizable (uno por hilo): todo lo que antes se reservaba en
+// cada llamada vive aquí y conserva su capacidad, así comprimir chunk tras
+// chunk no toca el heap salvo por el buffer de salida (ninguno con _into).
+// - pool: nodos del árbol (a lo sumo 2*256-1), sin malloc por nodo;
+// - code/code_len: bits de cada símbolo (0/1) en lugar de un strdup;
+// - data: copia con el predictor aplicado; root: árbol de la última entrada.
+struct hp_ctx {
+    Node pool[2 * MAX_SYMBOLS];
+    size_t n_pool;
+    uint8_t code[MAX_SYMBOLS][MAX_SYMBOLS];
+    uint16_t code_len[MAX_SYMBOLS];
+    uint8_t* data;
+    size_t data_cap;
+    Node* root;
+};
+
+hp_ctx* hp_ctx_create(void) {
+    hp_ctx* c = malloc(sizeof(hp_ctx));
+    if (!c) return NULL;
+    c->data = NULL;
+    c->data_cap = 0;
+    c->root = NULL;
+    return c;
+}
+
+void hp_ctx_destroy(hp_ctx* c) {
+    if (!c) return;
+    free(c->data);
+    free(c);
+}
+
+// Asegura *cap >= need (sin conservar el contenido anterior)
+static int grow(uint8_t** buf, size_t* cap, size_t need) {
+    if (need <= *cap) return 0;
+    uint8_t* n = malloc(need);
+    if (!n) return -1;
+    free(*buf);
+    *buf = n;
+    *cap = need;
+    return 0;
 }
 
+/* ----------------- Bit I/O helpers ----------------- */
 // Escribe un único bit (0 o 1). Si se llena la capacidad, se ignora el bit.
 static void bw_write_bit(BitWriter* bw, int bit) {
     if (bw->bit_pos >= bw->capacity * 8) return; // sin espacio (optimización simple)
@@ -75,14 +111,6 @@ static void bw_write_byte(BitWriter* bw, uint8_t b) {
         bw_write_bit(bw, (b >> i) & 1);
 }
 
-static BitReader* br_create(const uint8_t* data, size_t len) {
-    BitReader* br = malloc(sizeof(BitReader));
-    br->data = data;
-    br->bit_pos = 0;
-    br->capacity = len * 8; // capacidad en bits
-    return br;
-}
-
 // Devuelve el siguiente bit (0/1) o -1 si ya no hay más.
 static int br_read_bit(BitReader* br) {
     if (br->bit_pos >= br->capacity) return -1; // fin de datos
@@ -95,8 +123,10 @@ static int br_read_bit(BitReader* br) {
 
 /* ----------------- Huffman core ----------------- */
 
-static Node* new_node(uint8_t s, size_t f, Node* l, Node* r) {
-    Node* n = malloc(sizeof(Node));
+// Toma un nodo del pool del contexto (NULL si se agotó: árbol corrupto).
+static Node* new_node(hp_ctx* c, uint8_t s, size_t f, Node* l, Node* r) {
+    if (c->n_pool == 2 * MAX_SYMBOLS) return NULL;
+    Node* n = &c->pool[c->n_pool++];
     n->sym = s;
     n->freq = f;
     n->left = l;
@@ -104,13 +134,6 @@ static Node* new_node(uint8_t s, size_t f, Node* l, Node* r) {
     return n;
 }
 
-static void free_tree(Node* n) {
-    if (!n) return;
-    free_tree(n->left);
-    free_tree(n->right);
-    free(n);
-}
-
 /* serializa el árbol (preorden) para reconstrucción */
 // Serializa el árbol en preorden:
 // bit 1 seguido del símbolo para hojas, bit 0 para nodos internos.
@@ -126,7 +149,14 @@ static void serialize_tree(Node* n, BitWriter* bw) {
     }
 }
 
-static Node* deserialize_tree(BitReader* br) {
+// Bits que ocupa el árbol serializado
+static size_t tree_bits(const Node* n) {
+    if (!n) return 0;
+    if (!n->left && !n->right) return 9;
+    return 1 + tree_bits(n->left) + tree_bits(n->right);
+}
+
+static Node* deserialize_tree(hp_ctx* c, BitReader* br) {
     int flag = br_read_bit(br);
     if (flag == 1) { // hoja: leer el byte asociado
         uint8_t sym = 0;
@@ -135,25 +165,26 @@ static Node* deserialize_tree(BitReader* br) {
             if (bit < 0) return NULL;
             sym = (sym << 1) | bit;
         }
-        return new_node(sym, 0, NULL, NULL);
+        return new_node(c, sym, 0, NULL, NULL);
     } else if (flag == 0) { // nodo interno: reconstruir recursivamente
-        Node* left = deserialize_tree(br);
-        Node* right = deserialize_tree(br);
-        return new_node(0, 0, left, right);
+        Node* left = deserialize_tree(c, br);
+        Node* right = left ? deserialize_tree(c, br) : NULL;
+        if (!left || !right) return NULL;
+        return new_node(c, 0, 0, left, right);
     }
     return NULL;
 }
 
-// Recorre el árbol y genera la cadena de bits (como texto '0'/'1') para cada símbolo hoja.
-static void build_codes(Node* n, char** tbl, char* pref, int depth) {
+// Recorre el árbol y guarda los bits (0/1) del código de cada símbolo hoja.
+static void build_codes(hp_ctx* c, Node* n, uint8_t* pref, int depth) {
     if (!n) return;
     if (!n->left && !n->right) {
-        pref[depth] = '\0';
-        tbl[n->sym] = strdup(pref); // copia el código encontrado
+        memcpy(c->code[n->sym], pref, (size_t)depth); // copia el código encontrado
+        c->code_len[n->sym] = (uint16_t)depth;
         return;
     }
-    pref[depth] = '0'; build_codes(n->left, tbl, pref, depth + 1);
-    pref[depth] = '1'; build_codes(n->right, tbl, pref, depth + 1);
+    pref[depth] = 0; build_codes(c, n->left, pref, depth + 1);
+    pref[depth] = 1; build_codes(c, n->right, pref, depth + 1);
 }
 
 /* ----------------- Predictor ----------------- */
@@ -178,10 +209,11 @@ static void undo_predictor(uint8_t* buf, size_t len) {
 }
 
 /* ----------------- Compresión ----------------- */
-int hp_compress_buffer(const uint8_t* in, size_t len, uint8_t** out, size_t* out_len) {
-    if (!in || len == 0) return -1; // nada que comprimir
-
-    uint8_t* data = malloc(len);
+// Primera fase: predictor, frecuencias, árbol y códigos. Devuelve en
+// *nbytes el tamaño exacto de la salida (árbol + longitud + códigos).
+static int hp_prepare(hp_ctx* c, const uint8_t* in, size_t len, size_t* nbytes) {
+    if (grow(&c->data, &c->data_cap, len) != 0) return -1;
+    uint8_t* data = c->data;
     memcpy(data, in, len);
     apply_predictor(data, len);
 
@@ -189,9 +221,10 @@ int hp_compress_buffer(const uint8_t* in, size_t len, uint8_t** out, size_t* out
     size_t freq[MAX_SYMBOLS] = {0};
     for (size_t i = 0; i < len; i++) freq[data[i]]++;
 
+    c->n_pool = 0;
     Node* nodes[MAX_SYMBOLS];
     size_t n = 0;
-    for (int i = 0; i < 256; i++) if (freq[i]) nodes[n++] = new_node(i, freq[i], NULL, NULL);
+    for (int i = 0; i < 256; i++) if (freq[i]) nodes[n++] = new_node(c, i, freq[i], NULL, NULL);
 
     // Combinar siempre los dos nodos de menor frecuencia hasta quedar uno
     while (n > 1) {
@@ -202,58 +235,121 @@ int hp_compress_buffer(const uint8_t* in, size_t len, uint8_t** out, size_t* out
             else if (nodes[i]->freq < nodes[i2]->freq) i2 = i;
         }
         Node* a = nodes[i1]; Node* b = nodes[i2];
-        Node* parent = new_node(0, a->freq + b->freq, a, b);
+        Node* parent = new_node(c, 0, a->freq + b->freq, a, b);
         nodes[i1] = parent;
         nodes[i2] = nodes[n - 1];
         n--;
     }
-    Node* root = (n == 1) ? nodes[0] : new_node(0, 1, NULL, NULL);
+    c->root = (n == 1) ? nodes[0] : new_node(c, 0, 1, NULL, NULL);
+
+    memset(c->code_len, 0, sizeof(c->code_len));
+    uint8_t tmp[MAX_SYMBOLS]; build_codes(c, c->root, tmp, 0);
+#if JLOG_LEVEL >= JLOG_LVL_TRACE
+    {
+        int nsym = 0;
+        size_t maxlen = 0;
+        for (int i = 0; i < 256; i++) {
+            if (!freq[i]) continue;
+            nsym++;
+            if (c->code_len[i] > maxlen) maxlen = c->code_len[i];
+        }
+        JTRACE("[HUFF] comp: %zu bytes, %d símbolos, código más largo %zu bits\n", len, nsym, maxlen);
+    }
+#endif
 
-    char* tbl[256] = {0};
-    char tmp[256]; build_codes(root, tbl, tmp, 0);
+    size_t total_bits = tree_bits(c->root) + 32;
+    for (int i = 0; i < 256; i++) total_bits += freq[i] * c->code_len[i];
+    *nbytes = (total_bits + 7) / 8;
+    return 0;
+}
 
-    BitWriter* bw = bw_create(len * 3); // capacidad aproximada (heurística simple)
-    serialize_tree(root, bw);
+// Segunda fase: escribe árbol, longitud y códigos en out[0..nbytes).
+static void hp_emit(hp_ctx* c, size_t len, uint8_t* out, size_t nbytes) {
+    memset(out, 0, nbytes); // los bits solo se encienden con OR
+    BitWriter bw = { out, 0, nbytes };
+    serialize_tree(c->root, &bw);
 
     // Guardar longitud original (32 bits) para saber cuánto reconstruir luego
     for (int i = 31; i >= 0; i--)
-        bw_write_bit(bw, (len >> i) & 1);
+        bw_write_bit(&bw, (len >> i) & 1);
 
     // Codificar cada símbolo usando su secuencia de bits
+    const uint8_t* data = c->data;
     for (size_t i = 0; i < len; i++) {
-        const char* code = tbl[data[i]];
-        for (size_t j = 0; j < strlen(code); j++)
-            bw_write_bit(bw, code[j] == '1');
+        const uint8_t* code = c->code[data[i]];
+        for (size_t j = 0, cl = c->code_len[data[i]]; j < cl; j++)
+            bw_write_bit(&bw, code[j]);
     }
+    JTRACE("[HUFF] comp: %zu -> %zu bytes\n", len, nbytes);
+}
 
-    *out = malloc((bw->bit_pos + 7) / 8);
-    memcpy(*out, bw->data, (bw->bit_pos + 7) / 8);
-    *out_len = (bw->bit_pos + 7) / 8;
+int hp_compress_ctx(hp_ctx* c, const uint8_t* in, size_t len, uint8_t** out, size_t* out_len) {
+    if (!c || !in || len == 0) return -1; // nada que comprimir
+    size_t nbytes = 0;
+    if (hp_prepare(c, in, len, &nbytes) != 0) return -1;
+    *out = malloc(nbytes ? nbytes : 1);
+    if (!*out) return -1;
+    hp_emit(c, len, *out, nbytes);
+    *out_len = nbytes;
+    return 0;
+}
 
-    for (int i = 0; i < 256; i++) free(tbl[i]);
-    free_tree(root);
-    free(bw->data); free(bw);
-    free(data);
+int hp_compress_buffer(const uint8_t* in, size_t len, uint8_t** out, size_t* out_len) {
+    /* Llamada suelta: contexto temporal */
+    hp_ctx* c = hp_ctx_create();
+    if (!c) return -1;
+    int rc = hp_compress_ctx(c, in, len, out, out_len);
+    hp_ctx_destroy(c);
+    return rc;
+}
+
+/* Cota: árbol completo (256 hojas de 9 bits + 255 nodos internos) + 32
+ * bits de longitud + datos. Huffman es óptimo entre códigos prefijo, así
+ * que nunca usa más que un código fijo de 8 bits por símbolo. */
+size_t hp_compress_bound(size_t len) {
+    return len + (MAX_SYMBOLS * 9 + (MAX_SYMBOLS - 1) + 32 + 7) / 8;
+}
+
+int hp_compress_into_ctx(hp_ctx* c, const uint8_t* in, size_t len,
+                         uint8_t* out, size_t cap, size_t* out_len) {
+    if (!c || !in || len == 0 || !out) return -1;
+    size_t nbytes = 0;
+    if (hp_prepare(c, in, len, &nbytes) != 0) return -1;
+    if (nbytes > cap) return -1;
+    hp_emit(c, len, out, nbytes);
+    *out_len = nbytes;
     return 0;
 }
 
-/* ----------------- Descompresión ----------------- */
-int hp_decompress_buffer(const uint8_t* in, size_t len, uint8_t** out, size_t* out_len) {
-    if (!in || len == 0) return -1; // nada que leer
+int hp_compress_into(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t* out_len) {
+    hp_ctx* c = hp_ctx_create();
+    if (!c) return -1;
+    int rc = hp_compress_into_ctx(c, in, len, out, cap, out_len);
+    hp_ctx_destroy(c);
+    return rc;
+}
 
-    BitReader* br = br_create(in, len);
-    Node* root = deserialize_tree(br);
-    if (!root) return -1;
+/* ----------------- Descompresión ----------------- */
+// Lee el árbol (en el pool del contexto) y la longitud original.
+static int hp_read_header(hp_ctx* c, BitReader* br, size_t* orig_len) {
+    c->n_pool = 0;
+    c->root = deserialize_tree(c, br);
+    if (!c->root) return -1;
 
     // Leer la longitud original (32 bits)
-    size_t orig_len = 0;
+    size_t n = 0;
     for (int i = 0; i < 32; i++) {
         int bit = br_read_bit(br);
         if (bit < 0) return -1;
-        orig_len = (orig_len << 1) | bit;
+        n = (n << 1) | bit;
     }
+    *orig_len = n;
+    return 0;
+}
 
-    *out = malloc(orig_len);
+// Decodifica orig_len símbolos en out y revierte el predictor.
+static void hp_decode(hp_ctx* c, BitReader* br, uint8_t* out, size_t orig_len) {
+    Node* root = c->root;
     Node* cur = root;
     // Decodificar símbolo por símbolo recorriendo el árbol según los bits
     for (size_t i = 0; i < orig_len; i++) {
@@ -262,14 +358,53 @@ int hp_decompress_buffer(const uint8_t* in, size_t len, uint8_t** out, size_t* o
             if (bit < 0) break; // datos truncados
             cur = bit ? cur->right : cur->left;
         }
-        (*out)[i] = cur->sym;
+        out[i] = cur->sym;
         cur = root; // reiniciar para el siguiente símbolo
     }
+    undo_predictor(out, orig_len); // revertir delta para recuperar datos originales
+}
+
+int hp_decompress_ctx(hp_ctx* c, const uint8_t* in, size_t len, uint8_t** out, size_t* out_len) {
+    if (!c || !in || len == 0) return -1; // nada que leer
 
-    undo_predictor(*out, orig_len); // revertir delta para recuperar datos originales
+    BitReader br = { in, 0, len * 8 };
+    size_t orig_len = 0;
+    if (hp_read_header(c, &br, &orig_len) != 0) return -1;
+
+    *out = malloc(orig_len ? orig_len : 1);
+    if (!*out) return -1;
+    hp_decode(c, &br, *out, orig_len);
     *out_len = orig_len;
+    JTRACE("[HUFF] dec: %zu -> %zu bytes\n", len, orig_len);
+    return 0;
+}
+
+int hp_decompress_buffer(const uint8_t* in, size_t len, uint8_t** out, size_t* out_len) {
+    hp_ctx* c = hp_ctx_create();
+    if (!c) return -1;
+    int rc = hp_decompress_ctx(c, in, len, out, out_len);
+    hp_ctx_destroy(c);
+    return rc;
+}
+
+int hp_decompress_into_ctx(hp_ctx* c, const uint8_t* in, size_t len,
+                           uint8_t* out, size_t cap, size_t* out_len) {
+    if (!c || !in || len == 0 || !out) return -1;
 
-    free_tree(root);
-    free(br);
+    BitReader br = { in, 0, len * 8 };
+    size_t orig_len = 0;
+    if (hp_read_header(c, &br, &orig_len) != 0) return -1;
+    if (orig_len > cap) return -1;
+    hp_decode(c, &br, out, orig_len);
+    *out_len = orig_len;
+    JTRACE("[HUFF] dec: %zu -> %zu bytes\n", len, orig_len);
     return 0;
 }
+
+int hp_decompress_into(const uint8_t* in, size_t len, uint8_t* out, size_t cap, size_t* out_len) {
+    hp_ctx* c = hp_ctx_create();
+    if (!c) return -1;
+    int rc = hp_decompress_into_ctx(c, in, len, out, cap, out_len);
+    hp_ctx_destroy(c);
+    return rc;
+}
@@ -26,4 +26,40 @@ int hp_compress_buffer(const uint8_t* in, size_t in_len, uint8_t** out, size_t*
  */
 int hp_decompress_buffer(const uint8_t* in, size_t in_len, uint8_t** out, size_t* out_len);
 
+/**
+ * @brief Contexto reutilizable: pool de nodos del árbol, tabla de códigos y
+ * buffers de trabajo que crecen y se conservan entre llamadas. Pensado para
+ * uno por hilo; no es seguro compartirlo entre hilos a la vez.
+ */
+typedef struct hp_ctx hp_ctx;
+
+hp_ctx* hp_ctx_create(void);
+void hp_ctx_destroy(hp_ctx* c);
+
+/**
+ * @brief Igual que hp_compress_buffer()/hp_decompress_buffer() pero usando
+ * el contexto: la única reserva por llamada es el buffer *out devuelto.
+ */
+int hp_compress_ctx(hp_ctx* c, const uint8_t* in, size_t in_len, uint8_t** out, size_t* out_len);
+int hp_decompress_ctx(hp_ctx* c, const uint8_t* in, size_t in_len, uint8_t** out, size_t* out_len);
+
+/**
+ * @brief Salida en un buffer del llamador. hp_compress_bound(n) es el
+ * tamaño máximo posible; *_into escribe en out[0..cap) y devuelve -1 si no
+ * cabe. El formato es el mismo que el de hp_compress_buffer().
+ */
+size_t hp_compress_bound(size_t in_len);
+int hp_compress_into(const uint8_t* in, size_t in_len, uint8_t* out, size_t cap, size_t* out_len);
+int hp_compress_into_ctx(hp_ctx* c, const uint8_t* in, size_t in_len,
+                         uint8_t* out, size_t cap, size_t* out_len);
+
+/**
+ * @brief Descompresión en un buffer del llamador out[0..cap) (quien llama
+ * conoce el tamaño original, p. ej. por el índice de chunks). -1 si el
+ * flujo está corrupto o no cabe.
+ */
+int hp_decompress_into(const uint8_t* in, size_t in_len, uint8_t* out, size_t cap, size_t* out_len);
+int hp_decompress_into_ctx(hp_ctx* c, const uint8_t* in, size_t in_len,
+                           uint8_t* out, size_t cap, size_t* out_len);
+
 #endif
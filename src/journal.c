@@ -8,28 +8,261 @@
 //   - Crear/ inicializar la estructura Journal.
 //   - Activar o desactivar con journal_set_enabled().
 //   - Usar journal_log() para escribir mensajes formateados (similar a printf).
-//   - Se fuerza un fflush() para que el mensaje aparezca de inmediato.
+//
+// Escritura diferida (para que -j cueste poco con muchos hilos):
+//   - Cada hilo formatea su mensaje en un anillo propio (un productor, un
+//     consumidor, sin candados): no compite por el FILE* ni hace syscalls.
+//   - Un hilo "drenador" recoge los anillos cada pocos ms, ordena los
+//     mensajes por tiempo y los escribe en bloque con un solo fflush.
+//   - Cada línea lleva "[+ms tN]": tiempo desde el inicio y hilo.
+//   - Si un anillo se llena, el hilo cede la CPU un momento y, si sigue
+//     lleno, descarta el mensaje (se avisa del total al final): el journal
+//     nunca bloquea al pipeline.
+//   - Al salir (atexit) se detiene el drenador y se vacía lo pendiente.
 //
 // Notas:
 //   - Si no está habilitado (enabled = 0) el costo de llamar journal_log es mínimo.
 //   - Se puede redirigir la salida a un archivo usando journal_set_output().
 //   - Usa varargs ("...") para aceptar formato variable como printf.
+//   - Niveles info/debug/trace por compilación: ver JLOG_LEVEL en journal.h.
+//
+// Tiempos por etapa: aparte de los mensajes libres, journal_stage() escribe
+// una línea JSON por etapa (archivo, chunk, hilo, bytes y ns) en su propio
+// stream, por el mismo camino de anillos. Con --trace la misma etapa se
+// registra también como evento de trace.c, y un hook opcional (metrics.c)
+// recibe su duración.
 // ============================================================================
 
 #include "journal.h"
+#include "trace.h"
+#include "memtrack.h"
+#include <pthread.h>
+#include <sched.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// ---------------------------------------------------------------------------
+// Anillos por hilo
+// ---------------------------------------------------------------------------
+
+#define JR_SLOTS 256          // mensajes por anillo (potencia de 2)
+#define JR_MSG   1000         // bytes por mensaje (se trunca si es más largo)
+#define JR_BATCH 4096         // mensajes como máximo por pasada del drenador
+#define JR_TICK_MS 20         // periodo del drenador
+
+typedef struct {
+    uint64_t ts;
+    FILE* out;
+    unsigned tid;
+    int raw;                  // 1 = sin prefijo (líneas JSON)
+    uint32_t len;
+    char msg[JR_MSG];
+} JrSlot;
+
+typedef struct JRing {
+    atomic_size_t head;       // lo escribe el hilo dueño
+    atomic_size_t tail;       // lo escribe el drenador
+    atomic_int owned;         // 0 = el hilo terminó, se puede reutilizar
+    size_t drain_to;          // uso interno del drenador
+    struct JRing* next;       // lista global (solo crece)
+    JrSlot slot[JR_SLOTS];
+} JRing;
+
+static _Atomic(JRing*) g_rings;
+static _Thread_local JRing* t_ring;
+static pthread_key_t g_ring_key;
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+static atomic_int g_running;  // 1 = el drenador está vivo
+static atomic_ulong g_dropped;
+static uint64_t g_t0;         // inicio, para el prefijo [+ms]
+
+static pthread_t g_drainer;
+static pthread_mutex_t g_dmtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_dcv = PTHREAD_COND_INITIALIZER;
+static int g_stop;
+
+static atomic_uint g_next_tid;
+static _Thread_local unsigned t_tid;
+
+uint64_t journal_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+unsigned journal_thread_id(void) {
+    if (!t_tid) t_tid = atomic_fetch_add(&g_next_tid, 1) + 1;
+    return t_tid;
+}
+
+// Destructor de pthread_key: el hilo terminó, su anillo queda libre
+// (lo pendiente lo sigue drenando el drenador).
+static void ring_release(void* p) {
+    atomic_store_explicit(&((JRing*)p)->owned, 0, memory_order_release);
+}
+
+// Anillo del hilo actual: reutiliza uno huérfano o agrega uno nuevo.
+static JRing* ring_get(void) {
+    if (t_ring) return t_ring;
+    JRing* r = NULL;
+    for (JRing* it = atomic_load(&g_rings); it; it = it->next) {
+        int zero = 0;
+        if (atomic_compare_exchange_strong(&it->owned, &zero, 1)) { r = it; break; }
+    }
+    if (!r) {
+        r = calloc(1, sizeof(JRing));
+        if (!r) return NULL;
+        atomic_store(&r->owned, 1);
+        JRing* head = atomic_load(&g_rings);
+        do { r->next = head; } while (!atomic_compare_exchange_weak(&g_rings, &head, r));
+    }
+    pthread_setspecific(g_ring_key, r);
+    t_ring = r;
+    return r;
+}
+
+static int cmp_slot_ts(const void* a, const void* b) {
+    uint64_t x = (*(const JrSlot* const*)a)->ts, y = (*(const JrSlot* const*)b)->ts;
+    return (x > y) - (x < y);
+}
+
+// Una pasada: toma lo pendiente de todos los anillos, lo ordena por
+// tiempo y lo escribe. Los slots no se copian: el productor no los pisa
+// hasta que 'tail' avanza, y eso se hace al final. Solo la llama el
+// drenador (o el cierre, ya sin él). Devuelve cuántos mensajes escribió.
+static size_t drain_once(void) {
+    static const JrSlot* order[JR_BATCH];
+    size_t n = 0;
+    JRing* rings = atomic_load(&g_rings);
+    for (JRing* r = rings; r; r = r->next) {
+        size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+        while (tail != head && n < JR_BATCH) order[n++] = &r->slot[tail++ % JR_SLOTS];
+        r->drain_to = tail;
+    }
+    if (n > 0) qsort(order, n, sizeof(JrSlot*), cmp_slot_ts);
+
+    FILE* last = NULL;
+    for (size_t i = 0; i < n; i++) {
+        const JrSlot* s = order[i];
+        if (s->out != last && last) fflush(last);
+        last = s->out;
+        const char* m = s->msg;
+        size_t len = s->len;
+        if (!s->raw) {
+            // los saltos de línea iniciales van antes del prefijo
+            while (len > 0 && *m == '\n') { fputc('\n', s->out); m++; len--; }
+            double ms = s->ts > g_t0 ? (double)(s->ts - g_t0) / 1e6 : 0.0;
+            fprintf(s->out, "[+%.3fms t%u] ", ms, s->tid);
+        }
+        fwrite(m, 1, len, s->out);
+    }
+    if (last) fflush(last);
+    for (JRing* r = rings; r; r = r->next)
+        atomic_store_explicit(&r->tail, r->drain_to, memory_order_release);
+    return n;
+}
+
+static void* drainer_main(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_dmtx);
+    while (!g_stop) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += JR_TICK_MS * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) { ts.tv_sec++; ts.tv_nsec -= 1000000000L; }
+        pthread_cond_timedwait(&g_dcv, &g_dmtx, &ts);
+        pthread_mutex_unlock(&g_dmtx);
+        drain_once();
+        pthread_mutex_lock(&g_dmtx);
+    }
+    pthread_mutex_unlock(&g_dmtx);
+    return NULL;
+}
+
+// Detiene el drenador y vacía los anillos (registrado con atexit).
+static void journal_shutdown(void) {
+    if (!atomic_load(&g_running)) return;
+    pthread_mutex_lock(&g_dmtx);
+    g_stop = 1;
+    pthread_cond_signal(&g_dcv);
+    pthread_mutex_unlock(&g_dmtx);
+    pthread_join(g_drainer, NULL);
+    atomic_store(&g_running, 0);
+    while (drain_once() > 0) { }
+    unsigned long d = atomic_load(&g_dropped);
+    if (d) fprintf(stderr, "[JOURNAL] %lu mensajes descartados (anillo lleno)\n", d);
+}
+
+static void start_drainer(void) {
+    g_t0 = journal_now_ns();
+    if (pthread_key_create(&g_ring_key, ring_release) != 0) return;
+    if (pthread_create(&g_drainer, NULL, drainer_main, NULL) != 0) return;
+    atomic_store(&g_running, 1);
+    atexit(journal_shutdown);
+}
+
+// Formatea en el anillo del hilo. Si no hay drenador escribe directo.
+static void ring_vpush(FILE* out, int raw, const char* fmt, va_list ap) {
+    uint64_t ts = journal_now_ns();
+    JRing* r = atomic_load(&g_running) ? ring_get() : NULL;
+    if (!r) {
+        vfprintf(out, fmt, ap);
+        fflush(out);
+        return;
+    }
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    for (int spin = 0; head - atomic_load_explicit(&r->tail, memory_order_acquire) >= JR_SLOTS; spin++) {
+        if (spin == 0) pthread_cond_signal(&g_dcv);
+        if (spin == 64) { atomic_fetch_add(&g_dropped, 1); return; }
+        sched_yield();
+    }
+    JrSlot* s = &r->slot[head % JR_SLOTS];
+    int n = vsnprintf(s->msg, sizeof(s->msg), fmt, ap);
+    if (n < 0) return;
+    if ((size_t)n >= sizeof(s->msg)) {   // truncado: la línea igual termina en \n
+        n = (int)sizeof(s->msg) - 1;
+        s->msg[n - 1] = '\n';
+    }
+    s->len = (uint32_t)n;
+    s->ts = ts;
+    s->out = out;
+    s->tid = journal_thread_id();
+    s->raw = raw;
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+    // medio anillo ocupado: despertar al drenador antes del tick
+    if (head + 1 - atomic_load_explicit(&r->tail, memory_order_relaxed) == JR_SLOTS / 2)
+        pthread_cond_signal(&g_dcv);
+}
+
+static void ring_push(FILE* out, int raw, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    ring_vpush(out, raw, fmt, ap);
+    va_end(ap);
+}
+
+// ---------------------------------------------------------------------------
+// API
+// ---------------------------------------------------------------------------
 
 // Inicializa la estructura: por defecto deshabilitado y salida estándar de errores.
 void journal_init(Journal* j) {
     if (!j) return;
     j->enabled = 0;      // comienza apagado
     j->output = stderr;  // se puede cambiar luego
+    j->stages = NULL;    // eventos por etapa apagados
 }
 
 // Activa (enabled=1) o desactiva (enabled=0) el journal.
+// La primera activación lanza el drenador.
 void journal_set_enabled(Journal* j, int enabled) {
     if (!j) return;
     j->enabled = enabled ? 1 : 0;
+    if (enabled) pthread_once(&g_once, start_drainer);
 }
 
 // Cambia el destino donde se escriben los mensajes (ej: archivo).
@@ -38,16 +271,118 @@ void journal_set_output(Journal* j, FILE* output) {
     j->output = output;
 }
 
-// Imprime un mensaje formateado si el journal está habilitado.
+static const Journal* g_default;
+
+void journal_set_default(const Journal* j) {
+    g_default = j;
+}
+
+const Journal* journal_default(void) {
+    return g_default;
+}
+
+// Encola un mensaje formateado si el journal está habilitado.
 // Uso típico: journal_log(&j, "Procesando chunk %zu/%zu\n", i, total);
-// Se ejecuta fflush para ver el mensaje al instante (útil en largas operaciones).
+// Aparece en la salida en menos de JR_TICK_MS (o al terminar el proceso).
 void journal_log(const Journal* j, const char* fmt, ...) {
     if (!j || !j->enabled || !j->output || !fmt) return; // si está apagado, salir rápido
 
     va_list args;
     va_start(args, fmt);
-    vfprintf(j->output, fmt, args); // imprime con formato variable
+    ring_vpush(j->output, 0, fmt, args);
     va_end(args);
+}
+
+// ---------------------------------------------------------------------------
+// Tiempos por etapa (JSON lines)
+// ---------------------------------------------------------------------------
 
-    fflush(j->output);  // asegurar escritura inmediata
-}
\ No newline at end of file
+// Contexto por hilo para JSTAGE_* (ver journal_scope_set).
+static _Thread_local const Journal* t_scope_j;
+static _Thread_local const char* t_scope_file;
+static _Thread_local long t_scope_chunk;
+
+int journal_open_stages(Journal* j, const char* path) {
+    if (!j || !path) return -1;
+    if (strcmp(path, "-") == 0) {
+        j->stages = stderr;
+    } else {
+        FILE* f = fopen(path, "w");
+        if (!f) return -1;
+        j->stages = f;
+    }
+    pthread_once(&g_once, start_drainer);
+    return 0;
+}
+
+static journal_stage_fn g_stage_hook;
+
+void journal_set_stage_hook(journal_stage_fn fn) {
+    g_stage_hook = fn;
+}
+
+int journal_stages_on(const Journal* j) {
+    return (j && j->stages) || trace_on() || g_stage_hook;
+}
+
+// Copia 'src' escapando comillas, barras y controles para un string JSON.
+void json_escape(char* dst, size_t cap, const char* src) {
+    size_t n = 0;
+    for (; src && *src && n + 7 < cap; src++) {
+        unsigned char c = (unsigned char)*src;
+        if (c == '"' || c == '\\') { dst[n++] = '\\'; dst[n++] = (char)c; }
+        else if (c < 0x20) n += (size_t)snprintf(dst + n, cap - n, "\\u%04x", c);
+        else dst[n++] = (char)c;
+    }
+    dst[n] = '\0';
+}
+
+uint64_t journal_stage_begin(void) {
+    uint64_t t0 = journal_now_ns();
+    memtrack_stage_begin(t0);
+    return t0;
+}
+
+void journal_stage(const Journal* j, const char* file, const char* stage, long chunk,
+                   size_t bytes_in, size_t bytes_out, uint64_t t0) {
+    MemStage ms;
+    int has_mem = memtrack_stage_end(stage, t0, &ms) == 0;
+    if (!journal_stages_on(j)) return;
+    uint64_t t1 = journal_now_ns();
+    trace_event(stage, "stage", file, chunk, t0, t1);
+    if (g_stage_hook) g_stage_hook(stage, t1 - t0);
+    if (!j || !j->stages) return;
+    uint64_t ns = t1 - t0;
+    char esc[512];
+    json_escape(esc, sizeof(esc), file ? file : "");
+    if (has_mem)
+        ring_push(j->stages, 1,
+                  "{\"t_ns\":%llu,\"file\":\"%s\",\"stage\":\"%s\",\"chunk\":%ld,\"tid\":%u,"
+                  "\"bytes_in\":%zu,\"bytes_out\":%zu,\"ns\":%llu,"
+                  "\"allocs\":%llu,\"alloc_bytes\":%llu,\"mem_peak\":%lld}\n",
+                  (unsigned long long)t0, esc, stage, chunk, journal_thread_id(),
+                  bytes_in, bytes_out, (unsigned long long)ns,
+                  (unsigned long long)ms.allocs, (unsigned long long)ms.bytes,
+                  (long long)ms.peak_delta);
+    else
+        ring_push(j->stages, 1,
+                  "{\"t_ns\":%llu,\"file\":\"%s\",\"stage\":\"%s\",\"chunk\":%ld,\"tid\":%u,"
+                  "\"bytes_in\":%zu,\"bytes_out\":%zu,\"ns\":%llu}\n",
+                  (unsigned long long)t0, esc, stage, chunk, journal_thread_id(),
+                  bytes_in, bytes_out, (unsigned long long)ns);
+}
+
+void journal_scope_set(const Journal* j, const char* file, long chunk) {
+    t_scope_j = journal_stages_on(j) ? j : NULL;
+    t_scope_file = file;
+    t_scope_chunk = chunk;
+}
+
+int journal_scope_on(void) {
+    return t_scope_j != NULL;
+}
+
+void journal_scope_stage(const char* stage, size_t bytes_in, size_t bytes_out, uint64_t t0) {
+    if (t_scope_j) journal_stage(t_scope_j, t_scope_file, stage, t_scope_chunk, bytes_in, bytes_out, t0);
+    else memtrack_stage_end(stage, t0, NULL);
+}
@@ -3,6 +3,8 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -12,6 +14,7 @@ extern "C" {
 typedef struct {
     int enabled;
     FILE* output;  /* stderr por defecto */
+    FILE* stages;  /* eventos por etapa en JSON lines (NULL = apagado) */
 } Journal;
 
 /* Inicializa el journal (por defecto deshabilitado, salida a stderr) */
@@ -26,8 +29,100 @@ void journal_set_output(Journal* j, FILE* output);
 /* Imprime mensaje si está habilitado (formato printf) */
 void journal_log(const Journal* j, const char* fmt, ...);
 
+/* Journal por defecto del proceso, para código sin Journal a mano (los
+ * puntos JTRACE de lzw.c / huffman_predictor.c). NULL = ninguno. */
+void journal_set_default(const Journal* j);
+const Journal* journal_default(void);
+
+/* ---------- Niveles ----------
+ * JLOG_LEVEL se fija al compilar (make JLOG_LEVEL=3):
+ *   1 = info  (default): solo JLOG / JLOG_INFO, activables con -j.
+ *   2 = debug: además JLOG_DEBUG (mensajes por chunk).
+ *   3 = trace: además JTRACE (puntos dentro de los codecs).
+ * Un nivel por encima del compilado no genera código: los argumentos ni
+ * se evalúan (el "if (0)" solo sirve para que el compilador los revise).
+ * Los niveles compilados siguen dependiendo de -j en tiempo de ejecución,
+ * y ese chequeo se hace antes de evaluar los argumentos. */
+#define JLOG_LVL_INFO  1
+#define JLOG_LVL_DEBUG 2
+#define JLOG_LVL_TRACE 3
+#ifndef JLOG_LEVEL
+#define JLOG_LEVEL JLOG_LVL_INFO
+#endif
+
+#define JLOG_ON(journal) ((journal) && (journal)->enabled)
+
 /* Macros convenientes para usar en el código */
-#define JLOG(journal, ...) journal_log((journal), __VA_ARGS__)
+#define JLOG(journal, ...) \
+    do { const Journal* jl_ = (journal); if (JLOG_ON(jl_)) journal_log(jl_, __VA_ARGS__); } while (0)
+#define JLOG_INFO(journal, ...) JLOG((journal), __VA_ARGS__)
+
+#if JLOG_LEVEL >= JLOG_LVL_DEBUG
+#define JLOG_DEBUG(journal, ...) JLOG((journal), __VA_ARGS__)
+#else
+#define JLOG_DEBUG(journal, ...) do { if (0) journal_log((journal), __VA_ARGS__); } while (0)
+#endif
+
+#if JLOG_LEVEL >= JLOG_LVL_TRACE
+#define JTRACE(...) JLOG(journal_default(), __VA_ARGS__)
+#else
+#define JTRACE(...) do { if (0) journal_log(NULL, __VA_ARGS__); } while (0)
+#endif
+
+/* ---------- Tiempos por etapa (JSON lines) ----------
+ * Cada etapa del pipeline (read, wav_decode, predictor, compress,
+ * encrypt, decrypt, decompress, unpredict, wav_encode, write) emite una
+ * línea:
+ *   {"t_ns":..,"file":"..","stage":"compress","chunk":3,"tid":2,
+ *    "bytes_in":..,"bytes_out":..,"ns":..}
+ * t_ns = inicio (CLOCK_MONOTONIC), chunk = -1 si la etapa es del archivo
+ * completo, tid = número de hilo pequeño y estable dentro del proceso.
+ * Con MEMTRACK la línea suma "allocs", "alloc_bytes" y "mem_peak" (pico
+ * de bytes vivos del hilo durante la etapa, sobre el inicio). */
+
+/* Abre 'path' para los eventos ("-" = stderr). 0 = ok, -1 = error. */
+int journal_open_stages(Journal* j, const char* path);
+
+/* 1 si los eventos por etapa están activos (JSON lines, --trace o hook). */
+int journal_stages_on(const Journal* j);
+
+/* Reloj monotónico en ns. */
+uint64_t journal_now_ns(void);
+
+/* Copia 'src' en 'dst' (cap bytes, siempre terminado en NUL) escapando
+ * comillas, barras y caracteres de control para un string JSON. */
+void json_escape(char* dst, size_t cap, const char* src);
+
+/* Id del hilo actual (1, 2, ...; asignado en su primer uso). */
+unsigned journal_thread_id(void);
+
+/* Observador extra de etapas (ej: histogramas de metrics.c): recibe el
+ * nombre y la duración de cada etapa. Uno solo; NULL lo quita. */
+typedef void (*journal_stage_fn)(const char* stage, uint64_t ns);
+void journal_set_stage_hook(journal_stage_fn fn);
+
+/* Inicio de una etapa: devuelve el t0 para journal_stage (reloj
+ * monotónico; con MEMTRACK abre además la cuenta de memoria). */
+uint64_t journal_stage_begin(void);
+
+/* Emite una etapa que empezó en t0 (journal_stage_begin) y termina ahora. */
+void journal_stage(const Journal* j, const char* file, const char* stage, long chunk,
+                   size_t bytes_in, size_t bytes_out, uint64_t t0);
+
+/* Contexto del hilo actual para los kernels que no reciben Journal
+ * (codec.c): mientras esté puesto, JSTAGE_* emite con este archivo y
+ * chunk. j = NULL lo quita. */
+void journal_scope_set(const Journal* j, const char* file, long chunk);
+int  journal_scope_on(void);
+void journal_scope_stage(const char* stage, size_t bytes_in, size_t bytes_out, uint64_t t0);
+
+#ifdef MEMTRACK
+#define JSTAGE_BEGIN() journal_stage_begin()
+#else
+#define JSTAGE_BEGIN() (journal_scope_on() ? journal_now_ns() : 0)
+#endif
+#define JSTAGE_END(stage, in, out, t0) \
+    do { if (t0) journal_scope_stage((stage), (in), (out), (t0)); } while (0)
 
 #ifdef __cplusplus
 }
@@ -23,6 +23,7 @@
 // =============================================================================
 
 #include "lzw.h"
+#include "journal.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
@@ -37,12 +38,14 @@
 #define LZW_MAX_CODES 4096
 #define LZW_BIT_WIDTH 12
 
-/* ayudas para escritura en memoria */
-typedef struct { uint8_t* buf; size_t size; size_t cap; } mem_writer;
-static int mw_init(mem_writer* w) { w->buf = NULL; w->size = w->cap = 0; return 0; }
+/* ayudas para escritura en memoria
+ * fixed = 1: el buffer es del llamador (compress_into) y no puede crecer */
+typedef struct { uint8_t* buf; size_t size; size_t cap; int fixed; } mem_writer;
+static int mw_init(mem_writer* w) { w->buf = NULL; w->size = w->cap = 0; w->fixed = 0; return 0; }
 static void mw_free(mem_writer* w) { if (w->buf) free(w->buf); w->buf = NULL; w->size = w->cap = 0; }
 static int mw_ensure(mem_writer* w, size_t need) {
     if (w->size + need <= w->cap) return 0;
+    if (w->fixed) return -1;
     size_t nc = w->cap ? w->cap * 2 : 4096;
     while (nc < w->size + need) nc *= 2;
     uint8_t* tmp = (uint8_t*)realloc(w->buf, nc);
@@ -53,8 +56,6 @@ static int mw_write_u8(mem_writer* w, uint8_t b) { if (mw_ensure(w,1)!=0) return
 
 /* Bitstream writer para códigos de 12 bits */
 typedef struct { mem_writer mw; uint32_t bitbuf; int bitcount; } bit_writer;
-static int bw_init(bit_writer* bw) { bw->bitbuf = 0; bw->bitcount = 0; return mw_init(&bw->mw); }
-static void bw_free(bit_writer* bw) { mw_free(&bw->mw); }
 static int bw_write(bit_writer* bw, uint32_t code) {
     /* escribe LZW_BIT_WIDTH bits LSB-first en el buffer */
     bw->bitbuf |= (code & ((1u<<LZW_BIT_WIDTH)-1)) << bw->bitcount;
@@ -73,16 +74,70 @@ static int bw_flush(bit_writer* bw) {
     return 0;
 }
 
-int lzw_compress(const uint8_t* in, size_t in_len, uint8_t** out, size_t* out_len) {
-    if (!in || in_len == 0 || !out || !out_len) return -1;
+/* Contexto reutilizable: tabla next[] + lista de posiciones usadas.
+ * - next: para cada código existente y posible siguiente byte guarda el
+ *   nuevo código que representa la secuencia extendida (-1 = no existe).
+ *   Se crea en la primera compresión (un contexto que solo descomprime
+ *   no paga los 4 MB).
+ * - used: índices de next[] asignados en la última llamada; al terminar
+ *   solo esos vuelven a -1 (como mucho LZW_MAX_CODES-256 entradas).
+ * - mw: buffer de trabajo de la salida; conserva su capacidad entre
+ *   llamadas, así con chunks de tamaño parecido ya no hay realloc.
+ * - prefix/suffix: diccionario de la descompresión.
+ */
+struct lzw_ctx {
+    int* next;
+    int used[LZW_MAX_CODES];
+    size_t n_used;
+    mem_writer mw;
+    int prefix[LZW_MAX_CODES];
+    unsigned char suffix[LZW_MAX_CODES];
+};
+
+lzw_ctx* lzw_ctx_create(void) {
+    lzw_ctx* ctx = (lzw_ctx*)malloc(sizeof(lzw_ctx));
+    if (!ctx) return NULL;
+    ctx->next = NULL;
+    ctx->n_used = 0;
+    mw_init(&ctx->mw);
+    return ctx;
+}
+
+void lzw_ctx_destroy(lzw_ctx* ctx) {
+    if (!ctx) return;
+    free(ctx->next);
+    mw_free(&ctx->mw);
+    free(ctx);
+}
+
+static int lzw_ctx_table(lzw_ctx* ctx) {
+    if (ctx->next) return 0;
+    ctx->next = (int*)malloc(sizeof(int) * LZW_MAX_CODES * 256);
+    if (!ctx->next) return -1;
+    for (int i=0;i<LZW_MAX_CODES*256;i++) ctx->next[i] = -1; // -1 indica "no existe aún"
+    return 0;
+}
 
-    // Tabla "next": para cada código existente y posible siguiente byte
-    // guarda el nuevo código que representa la secuencia extendida.
-    int *next = (int*)malloc(sizeof(int) * LZW_MAX_CODES * 256);
-    if (!next) return -1;
-    for (int i=0;i<LZW_MAX_CODES*256;i++) next[i] = -1; // -1 indica "no existe aún"
+/* Copia el resultado del buffer de trabajo a un buffer propio del llamador */
+static int mw_take(const mem_writer* w, uint8_t** out, size_t* out_len) {
+    *out_len = w->size;
+    *out = (uint8_t*)malloc(*out_len ? *out_len : 1);
+    if (!*out) return -1;
+    memcpy(*out, w->buf, *out_len);
+    return 0;
+}
+
+/* Deja la tabla como recién creada tocando solo lo que se usó */
+static void lzw_ctx_reset(lzw_ctx* ctx) {
+    for (size_t i = 0; i < ctx->n_used; i++) ctx->next[ctx->used[i]] = -1;
+    ctx->n_used = 0;
+}
 
-    bit_writer bw; bw_init(&bw);
+/* Núcleo de la compresión: escribe los códigos en bw (buffer del contexto
+ * o del llamador según bw->mw.fixed). */
+static int lzw_encode(lzw_ctx* ctx, const uint8_t* in, size_t in_len, bit_writer* bw) {
+    if (lzw_ctx_table(ctx) != 0) return -1;
+    int *next = ctx->next;
 
     int next_code = 256; // siguiente código libre (los 0..255 ya están implícitos)
 
@@ -97,31 +152,74 @@ int lzw_compress(const uint8_t* in, size_t in_len, uint8_t** out, size_t* out_le
             code = nc;
         } else {
             // No existe: emitimos el código de la secuencia actual
-            if (bw_write(&bw, (uint32_t)code) != 0) { free(next); bw_free(&bw); return -1; }
+            if (bw_write(bw, (uint32_t)code) != 0) { lzw_ctx_reset(ctx); return -1; }
             // Añadimos la nueva secuencia si aún hay espacio en el diccionario
             if (next_code < LZW_MAX_CODES) {
                 next[idx] = next_code++;
+                ctx->used[ctx->n_used++] = idx;
+                if (next_code == LZW_MAX_CODES)
+                    JTRACE("[LZW] diccionario lleno en el byte %zu de %zu\n", i, in_len);
             }
             // Empezamos nueva secuencia con el byte actual
             code = c;
         }
     }
+    lzw_ctx_reset(ctx);
     // Emitir el último código pendiente
-    if (bw_write(&bw, (uint32_t)code) != 0) { free(next); bw_free(&bw); return -1; }
+    if (bw_write(bw, (uint32_t)code) != 0) return -1;
     // Vaciar cualquier resto de bits en el buffer
-    if (bw_flush(&bw) != 0) { free(next); bw_free(&bw); return -1; }
+    if (bw_flush(bw) != 0) return -1;
 
+    JTRACE("[LZW] comp: %zu -> %zu bytes, %d códigos en el diccionario\n",
+           in_len, bw->mw.size, next_code);
+    return 0;
+}
+
+int lzw_compress_ctx(lzw_ctx* ctx, const uint8_t* in, size_t in_len, uint8_t** out, size_t* out_len) {
+    if (!ctx || !in || in_len == 0 || !out || !out_len) return -1;
+
+    /* el writer toma prestado el buffer del contexto y lo devuelve al final */
+    bit_writer bw = { ctx->mw, 0, 0 };
+    bw.mw.size = 0;
+    int rc = lzw_encode(ctx, in, in_len, &bw);
     // Copiar resultado al buffer de salida
-    *out_len = bw.mw.size;
-    *out = (uint8_t*)malloc(*out_len ? *out_len : 1);
-    if (!*out) { free(next); bw_free(&bw); return -1; }
-    memcpy(*out, bw.mw.buf, *out_len);
+    if (rc == 0) rc = mw_take(&bw.mw, out, out_len);
+    ctx->mw = bw.mw;
+    return rc;
+}
 
-    free(next);
-    bw_free(&bw);
+/* Peor caso: un código de 12 bits por byte de entrada */
+size_t lzw_compress_bound(size_t in_len) {
+    return (in_len * LZW_BIT_WIDTH + 7) / 8;
+}
+
+int lzw_compress_into_ctx(lzw_ctx* ctx, const uint8_t* in, size_t in_len,
+                          uint8_t* out, size_t cap, size_t* out_len) {
+    if (!ctx || !in || in_len == 0 || !out || !out_len) return -1;
+    bit_writer bw = { { out, 0, cap, 1 }, 0, 0 };
+    if (lzw_encode(ctx, in, in_len, &bw) != 0) return -1;
+    *out_len = bw.mw.size;
     return 0;
 }
 
+int lzw_compress_into(const uint8_t* in, size_t in_len, uint8_t* out, size_t cap, size_t* out_len) {
+    lzw_ctx* ctx = lzw_ctx_create();
+    if (!ctx) return -1;
+    int rc = lzw_compress_into_ctx(ctx, in, in_len, out, cap, out_len);
+    lzw_ctx_destroy(ctx);
+    return rc;
+}
+
+int lzw_compress(const uint8_t* in, size_t in_len, uint8_t** out, size_t* out_len) {
+    if (!in || in_len == 0 || !out || !out_len) return -1;
+    /* Llamada suelta: contexto temporal (mismo costo que antes) */
+    lzw_ctx* ctx = lzw_ctx_create();
+    if (!ctx) return -1;
+    int rc = lzw_compress_ctx(ctx, in, in_len, out, out_len);
+    lzw_ctx_destroy(ctx);
+    return rc;
+}
+
 /* Bitstream reader para códigos de 12 bits */
 typedef struct { const uint8_t* buf; size_t size; size_t pos; uint32_t bitbuf; int bitcount; } bit_reader;
 static void br_init(bit_reader* br, const uint8_t* buf, size_t size) { br->buf = buf; br->size = size; br->pos = 0; br->bitbuf = 0; br->bitcount = 0; }
@@ -140,33 +238,43 @@ static int br_read(bit_reader* br, uint32_t* out_code) {
 
 int lzw_decompress(const uint8_t* in, size_t in_len, uint8_t** out, size_t* out_len) {
     if (!in || in_len == 0 || !out || !out_len) return -1;
+    /* Llamada suelta: contexto temporal (sin tabla de compresión) */
+    lzw_ctx* ctx = lzw_ctx_create();
+    if (!ctx) return -1;
+    int rc = lzw_decompress_ctx(ctx, in, in_len, out, out_len);
+    lzw_ctx_destroy(ctx);
+    return rc;
+}
 
+/* Núcleo de la descompresión: escribe las secuencias en mw (buffer del
+ * contexto o del llamador según mw->fixed). */
+static int lzw_decode(lzw_ctx* ctx, const uint8_t* in, size_t in_len, mem_writer* w) {
     // Diccionario representado por: prefix[] y suffix[]
     // Cada código representa una secuencia: se reconstruye caminando hacia atrás
     // usando prefix hasta llegar a -1, recolectando los suffix.
-    int *prefix = (int*)malloc(sizeof(int) * LZW_MAX_CODES);
-    unsigned char *suffix = (unsigned char*)malloc(sizeof(unsigned char) * LZW_MAX_CODES);
-    if (!prefix || !suffix) { free(prefix); free(suffix); return -1; }
+    int *prefix = ctx->prefix;
+    unsigned char *suffix = ctx->suffix;
 
     // Inicializar códigos base (0..255): secuencias de un solo byte
     for (int i=0;i<256;i++) { prefix[i] = -1; suffix[i] = (unsigned char)i; }
     int next_code = 256;
 
-    mem_writer mw; if (mw_init(&mw)!=0) { free(prefix); free(suffix); return -1; }
+    mem_writer mw = *w;
+    int rc = -1;
 
     bit_reader br; br_init(&br, in, in_len);
     uint32_t code_u;
-    if (!br_read(&br, &code_u)) { mw_free(&mw); free(prefix); free(suffix); return -1; }
+    if (!br_read(&br, &code_u)) goto done;
     int old_code = (int)code_u;
 
     // Primer código debe ser un byte literal (<256)
-    if (old_code < 0 || old_code >= LZW_MAX_CODES) { mw_free(&mw); free(prefix); free(suffix); return -1; }
+    if (old_code < 0 || old_code >= LZW_MAX_CODES) goto done;
     if (old_code < 256) {
-        if (mw_ensure(&mw,1)!=0) { mw_free(&mw); free(prefix); free(suffix); return -1; }
+        if (mw_ensure(&mw,1)!=0) goto done;
         mw.buf[mw.size++] = (uint8_t)old_code;
     } else {
         // No debería ocurrir
-        mw_free(&mw); free(prefix); free(suffix); return -1;
+        goto done;
     }
 
     uint8_t decode_stack[4096]; // pila temporal para reconstruir secuencias
@@ -184,20 +292,22 @@ int lzw_decompress(const uint8_t* in, size_t in_len, uint8_t** out, size_t* out_
                 cur = prefix[cur];
             }
         } else if (code == next_code) {
-            // Caso especial (KwKwK): secuencia = anterior + primer carácter de la anterior
+            // Caso especial (KwKwK): secuencia = anterior + primer carácter de la anterior.
+            // La pila se escribe al revés, así que el carácter extra (el último
+            // de la salida) va en la base: se reserva la posición 0.
             int cur = old_code;
+            stack_top = 1;
             while (cur != -1) { decode_stack[stack_top++] = suffix[cur]; cur = prefix[cur]; }
-            if (stack_top == 0) { mw_free(&mw); free(prefix); free(suffix); return -1; }
-            unsigned char first_char = decode_stack[stack_top-1];
-            decode_stack[stack_top++] = first_char;
+            if (stack_top == 1) goto done;
+            decode_stack[0] = decode_stack[stack_top-1];
         } else {
             // Código inválido
-            mw_free(&mw); free(prefix); free(suffix); return -1;
+            goto done;
         }
 
         // Escribir la secuencia decodificada en orden correcto (invertimos la pila)
         for (int i = stack_top-1; i >= 0; --i) {
-            if (mw_ensure(&mw,1)!=0) { mw_free(&mw); free(prefix); free(suffix); return -1; }
+            if (mw_ensure(&mw,1)!=0) goto done;
             mw.buf[mw.size++] = decode_stack[i];
         }
 
@@ -211,13 +321,38 @@ int lzw_decompress(const uint8_t* in, size_t in_len, uint8_t** out, size_t* out_
 
         old_code = in_code; // avanzar
     }
+    JTRACE("[LZW] dec: %zu -> %zu bytes, %d códigos en el diccionario\n",
+           in_len, mw.size, next_code);
+    rc = 0;
+done:
+    *w = mw;
+    return rc;
+}
 
-    *out_len = mw.size;
-    *out = (uint8_t*)malloc(*out_len ? *out_len : 1);
-    if (!*out) { mw_free(&mw); free(prefix); free(suffix); return -1; }
-    memcpy(*out, mw.buf, *out_len);
+int lzw_decompress_ctx(lzw_ctx* ctx, const uint8_t* in, size_t in_len, uint8_t** out, size_t* out_len) {
+    if (!ctx || !in || in_len == 0 || !out || !out_len) return -1;
+    /* buffer de trabajo prestado del contexto (se devuelve al final) */
+    mem_writer mw = ctx->mw;
+    mw.size = 0;
+    int rc = lzw_decode(ctx, in, in_len, &mw);
+    if (rc == 0) rc = mw_take(&mw, out, out_len);
+    ctx->mw = mw;
+    return rc;
+}
 
-    mw_free(&mw);
-    free(prefix); free(suffix);
+int lzw_decompress_into_ctx(lzw_ctx* ctx, const uint8_t* in, size_t in_len,
+                            uint8_t* out, size_t cap, size_t* out_len) {
+    if (!ctx || !in || in_len == 0 || !out || !out_len) return -1;
+    mem_writer mw = { out, 0, cap, 1 };
+    if (lzw_decode(ctx, in, in_len, &mw) != 0) return -1;
+    *out_len = mw.size;
     return 0;
 }
+
+int lzw_decompress_into(const uint8_t* in, size_t in_len, uint8_t* out, size_t cap, size_t* out_len) {
+    lzw_ctx* ctx = lzw_ctx_create();
+    if (!ctx) return -1;
+    int rc = lzw_decompress_into_ctx(ctx, in, in_len, out, cap, out_len);
+    lzw_ctx_destroy(ctx);
+    return rc;
+}
@@ -13,4 +13,33 @@
 int lzw_compress(const uint8_t* in, size_t in_len, uint8_t** out, size_t* out_len);
 int lzw_decompress(const uint8_t* in, size_t in_len, uint8_t** out, size_t* out_len);
 
+/* Context reusable for many calls (e.g. chunk after chunk on a worker).
+ * It owns the 4 MB next[] table (created on the first compression and
+ * initialized once; after each call only the entries actually assigned are
+ * reset, so per-call setup is O(codes used) instead of O(table)), the
+ * decompression dictionary and a work buffer that keeps its capacity.
+ * Once warm, the only allocation per call is the returned output.
+ * Not thread-safe: one context per thread.
+ */
+typedef struct lzw_ctx lzw_ctx;
+lzw_ctx* lzw_ctx_create(void);
+void lzw_ctx_destroy(lzw_ctx* ctx);
+int lzw_compress_ctx(lzw_ctx* ctx, const uint8_t* in, size_t in_len, uint8_t** out, size_t* out_len);
+int lzw_decompress_ctx(lzw_ctx* ctx, const uint8_t* in, size_t in_len, uint8_t** out, size_t* out_len);
+
+/* Caller-provided output: lzw_compress_bound(n) is the worst-case size
+ * (one 12-bit code per input byte). *_into writes straight into
+ * out[0..cap) and fails with -1 if it does not fit; *out_len gets the
+ * bytes written. Same stream as lzw_compress.
+ */
+size_t lzw_compress_bound(size_t in_len);
+int lzw_compress_into(const uint8_t* in, size_t in_len, uint8_t* out, size_t cap, size_t* out_len);
+int lzw_compress_into_ctx(lzw_ctx* ctx, const uint8_t* in, size_t in_len,
+                          uint8_t* out, size_t cap, size_t* out_len);
+/* Decompression into out[0..cap) (the caller knows the original size,
+ * e.g. from the chunk index); -1 if the stream is corrupt or does not fit. */
+int lzw_decompress_into(const uint8_t* in, size_t in_len, uint8_t* out, size_t cap, size_t* out_len);
+int lzw_decompress_into_ctx(lzw_ctx* ctx, const uint8_t* in, size_t in_len,
+                            uint8_t* out, size_t cap, size_t* out_len);
+
 #endif
@@ -29,9 +29,10 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <errno.h>
-#include <dirent.h>
 #include <pthread.h>
 #include <time.h>
+#include <fcntl.h>
+#include <stdatomic.h>
 
 #include "fs.h"
 #include "rle_var.h"
@@ -44,24 +45,33 @@
 #include "audio_wav.h"
 #include "thread_pool.h"
 #include "journal.h"  
-
-/* Constantes generales */
-#define WAV_MAGIC       "GSEAWAV1"
-#define WAV_MAGIC_LEN   8
-
+#include "trace.h"
+#include "metrics.h"
+#include "perfctr.h"
+#include "progress.h"
+#include "memtrack.h"
+#include "membudget.h"
+#include "bigbuf.h"
+#include "bufpool.h"
+#include "cpu_count.h"
+#include "walk.h"
+#include "codec.h"
+#include "archive.h"
+#include "chunked.h"
+#include "bench.h"
+#include "corpus.h"
 
 /* Tamaño por defecto de chunk para procesamiento en paralelo: 100 MB */
 #define DEFAULT_CHUNK_MB 100
 
-/* Algoritmos de compresión disponibles */
-typedef enum {
-    COMP_RLEVAR,
-    COMP_LZW,
-    COMP_LZWPRED,
-    COMP_HUFFMANPRED,
-    COMP_DELTA16_LZW,
-    COMP_DELTA16_HUFF
-} CompAlg;
+/* Lotes de archivos pequeños (modo carpeta): tamaño objetivo por lote y
+ * umbral para considerar "pequeño" un archivo */
+#define DEFAULT_BATCH_MB   8
+#define SMALL_FILE_BYTES   (1024 * 1024)
+#define BATCH_MAX_FILES    4096
+
+/* Tamaño por defecto de bloque sólido en modo --archive: 8 MB */
+#define DEFAULT_SOLID_MB   8
 
 /* Algoritmos de encriptación disponibles */
 typedef enum {
@@ -75,7 +85,14 @@ typedef enum {
  * comp_alg / enc_alg  = algoritmos seleccionados.
  * workers / inner_workers = hilos externos (archivos) e internos (chunks). 0=auto.
  * chunk_bytes = tamaño de cada porción para dividir archivos grandes.
+ * batch_bytes = tamaño objetivo de un lote de archivos pequeños (0 = sin lotes).
+ * archive / solid_bytes = carpeta -> contenedor único con bloques sólidos.
+ * extract_name / list_archive = extraer un archivo / listar un contenedor.
+ * has_range / range_off / range_len = --extract-range OFFSET:LEN.
  * journal = controla si se imprimen mensajes paso a paso.
+ * metrics_path / metrics_interval = --metrics-file y su período (s).
+ * progress / progress_fd = --progress (stderr) y --progress-fd (JSON, -1 = no).
+ * (--mem-budget no vive aquí: es global del proceso, ver membudget.h.)
  */
 typedef struct {
     int do_c, do_d, do_e, do_u;
@@ -90,136 +107,69 @@ typedef struct {
     int verbose;
 
     size_t chunk_bytes;   
+    size_t batch_bytes;
+
+    int archive;
+    size_t solid_bytes;
+    const char* extract_name;
+    int list_archive;
+
+    int has_range;
+    uint64_t range_off;
+    uint64_t range_len;
 
     Journal journal;
+
+    const char* metrics_path;
+    unsigned metrics_interval;
+
+    int progress;
+    int progress_fd;
 } Config;
 
+/* Scratch: recursos reutilizables entre archivos de un mismo lote.
+ * - rbuf/rcap: buffer de lectura (evita malloc/free por archivo).
+ * - out_dir/out_dirfd: última carpeta de salida abierta (write_file_at).
+ * Un Scratch pertenece a un solo hilo. NULL = sin reutilización.
+ * (Los contextos de los codecs son por hilo y viven en codec.c.)
+ */
+typedef struct {
+    uint8_t* rbuf;
+    size_t rcap;
+    char* out_dir;
+    int out_dirfd;
+} Scratch;
+
+/* Progreso de un archivo (--progress): los bytes se acreditan a medida
+ * que terminan sus chunks; al final se acredita el resto (cabeceras,
+ * cifrado, delta16). Lo tocan los hilos internos: contador atómico. */
+typedef struct {
+    atomic_ullong credited;
+    int comp_side;      /* 1 = contar bytes comprimidos (descompresión) */
+} FileProgress;
+
 /* Prototipos principales del pipeline */
 static int   run_interactive(void);
 static void  human_readable(size_t bytes, char* out, size_t out_size);
 
-/* Predictor SUB: resta el pixel/byte anterior para generar diferencias */
-static void apply_predictor_sub(uint8_t* buf, int w, int h, int ch);
-static void undo_predictor_sub(uint8_t* buf, int w, int h, int ch);
-
-
-static void delta16_forward(int16_t* s, size_t frames, int ch);  /* Aplica diferencia entre muestras PCM16 */
-static void delta16_inverse(int16_t* s, size_t frames, int ch);  /* Revierte la diferencia */
-
-
-static void wr16le(uint8_t* p, uint16_t v); /* Escribe 16 bits little-endian */
-static void wr32le(uint8_t* p, uint32_t v); /* Escribe 32 bits little-endian */
-static uint16_t rd16le(const uint8_t* p);  /* Lee 16 bits little-endian */
-static uint32_t rd32le(const uint8_t* p);  /* Lee 32 bits little-endian */
 
 /* Pipeline principal */
-static int process_one_file(const char* in, const char* out, const Config* cfg,
+static int process_one_file(const char* in, const char* out, const Config* cfg, Scratch* sc,
                             size_t* o_orig, size_t* o_fin, double* o_ms); /* Ejecuta todas las etapas sobre 1 archivo */
-static int compress_chunked(const Config* cfg,
+static int compress_chunked(const Config* cfg, const char* name, FileProgress* fp,
                             const uint8_t* in, size_t in_len,
-                            uint8_t** out, size_t* out_len);        /* Divide y comprime por trozos */
-static int decompress_chunked(const Config* cfg,
+                            ChunkedBuf* out);                       /* Divide y comprime por trozos */
+static int decompress_chunked(const Config* cfg, const char* name, FileProgress* fp,
                               const uint8_t* in, size_t in_len,
                               uint8_t** out, size_t* out_len);      /* Reconstruye concatenando trozos */
 
 
-static int hw_threads(void); /* Detecta núcleos disponibles */
-static int compress_chunked_parallel(const Config* cfg,
-                                     const uint8_t* in, size_t in_len,
-                                     uint8_t** out, size_t* out_len); /* Versión paralela interna */
-
-
-
-
-static void apply_predictor_sub(uint8_t* buf, int w, int h, int ch) {
-    /* Recorre la fila y reemplaza cada valor por (actual - anterior) */
-    if (!buf) return;
-    for (int y = 0; y < h; ++y) {
-        size_t base = (size_t)y * w * ch;
-        uint8_t left[4] = {0,0,0,0};
-        for (int x = 0; x < w; ++x) {
-            for (int c = 0; c < ch; ++c) {
-                size_t i = base + x*ch + c;
-                uint8_t cur = buf[i];
-                uint8_t pred = (uint8_t)(cur - left[c]);
-                buf[i] = pred;
-                left[c] = cur;
-            }
-        }
-    }
-}
-
-static void undo_predictor_sub(uint8_t* buf, int w, int h, int ch) {
-    /* Reconstruye sumando el valor previo */
-    if (!buf) return;
-    for (int y = 0; y < h; ++y) {
-        size_t base = (size_t)y * w * ch;
-        uint8_t left[4] = {0,0,0,0};
-        for (int x = 0; x < w; ++x) {
-            for (int c = 0; c < ch; ++c) {
-                size_t i = base + x*ch + c;
-                uint8_t pred = buf[i];
-                uint8_t cur = (uint8_t)(pred + left[c]);
-                buf[i] = cur;
-                left[c] = cur;
-            }
-        }
-    }
-}
-
-
-static void delta16_forward(int16_t* s, size_t frames, int ch) {
-    /* Convierte muestras PCM16 a diferencias para mejorar compresión */
-    for (int c = 0; c < ch; ++c) {
-        int16_t prev = 0;
-        for (size_t i = 0; i < frames; ++i) {
-            size_t idx = i*(size_t)ch + c;
-            int16_t cur = s[idx];
-            int16_t d = cur - prev;
-            s[idx] = d;
-            prev = cur;
-        }
-    }
-}
-
-static void delta16_inverse(int16_t* s, size_t frames, int ch) {
-    /* Revierte las diferencias a muestras originales */
-    for (int c = 0; c < ch; ++c) {
-        int16_t prev = 0;
-        for (size_t i = 0; i < frames; ++i) {
-            size_t idx = i*(size_t)ch + c;
-            int16_t d = s[idx];
-            int16_t cur = d + prev;
-            s[idx] = cur;
-            prev = cur;
-        }
-    }
-}
-
-
-
-static void wr16le(uint8_t* p, uint16_t v) {
-    p[0] = v & 0xFF;
-    p[1] = (v >> 8) & 0xFF;
-}
+static int hw_threads(void); /* Detecta núcleos disponibles (afinidad + cgroup) */
+static int run_archive(const Config* cfg, int isFolder); /* Modo contenedor sólido */
+static int run_extract_range(const Config* cfg);         /* Extrae un rango de bytes */
 
-static void wr32le(uint8_t* p, uint32_t v) {
-    p[0] = (v      ) & 0xFF;
-    p[1] = (v >> 8 ) & 0xFF;
-    p[2] = (v >> 16) & 0xFF;
-    p[3] = (v >> 24) & 0xFF;
-}
 
-static uint16_t rd16le(const uint8_t* p) {
-    return p[0] | (p[1]<<8);
-}
 
-static uint32_t rd32le(const uint8_t* p) {
-    return (uint32_t)p[0]
-         | ((uint32_t)p[1] << 8)
-         | ((uint32_t)p[2] << 16)
-         | ((uint32_t)p[3] << 24);
-}
 
 /* ---------- Formato legible de tamaño ---------- */
 static void human_readable(size_t bytes, char* out, size_t out_size) {
@@ -236,88 +186,71 @@ static void human_readable(size_t bytes, char* out, size_t out_size) {
 
 
 
-static int compress_chunked(const Config* cfg,
+/* Hilos para chunks de un archivo: --inner-workers o auto */
+static size_t inner_threads(const Config* cfg) {
+    return (cfg->inner_workers > 0) ? (size_t)cfg->inner_workers : (size_t)hw_threads();
+}
+
+/* Aviso por chunk de chunked.c: acredita sus bytes en --progress */
+static void on_chunk_progress(size_t chunk, size_t raw_len, size_t comp_len, uint64_t ns, void* ctx) {
+    (void)chunk; (void)ns;
+    FileProgress* fp = ctx;
+    uint64_t b = fp->comp_side ? comp_len : raw_len;
+    atomic_fetch_add_explicit(&fp->credited, b, memory_order_relaxed);
+    progress_add_bytes(b);
+}
+
+static int compress_chunked(const Config* cfg, const char* name, FileProgress* fp,
                             const uint8_t* in, size_t in_len,
-                            uint8_t** out, size_t* out_len)
+                            ChunkedBuf* out)
 {
-    const size_t CH = cfg->chunk_bytes;
-    /* Si el archivo supera un chunk se usa versión paralela; si no, bucle único. */
-
-   
-    if (in_len > CH) {
-        return compress_chunked_parallel(cfg, in, in_len, out, out_len);
+    /* Formato indexado (chunked.c): cada chunk se comprime aparte, en
+     * paralelo si hay más de uno, y la cabecera guarda dónde empieza cada
+     * uno para poder descomprimir en paralelo o extraer rangos. */
+    if (cfg->comp_alg == COMP_DELTA16_LZW || cfg->comp_alg == COMP_DELTA16_HUFF) {
+        fprintf(stderr, "Algoritmo no válido.\n");
+        return -1;
     }
 
-    size_t pos = 0;
-
-    
-    size_t cap = in_len ? in_len : 1;
-    *out = (uint8_t*)malloc(cap);
-    if (!*out) return -1;
-    *out_len = 0;
-
-    while (pos < in_len) {
-        size_t csize = in_len - pos;
-        if (csize > CH) csize = CH;
-
-        JLOG(&cfg->journal, "[JOURNAL] → Chunk %zu bytes\n", csize);
-
-        const uint8_t* p = in + pos;
-        uint8_t* bout = NULL;
-        size_t blen = 0;
-        int rc = 0;
-
-        switch (cfg->comp_alg) {
-            case COMP_RLEVAR:
-                rc = rle_var_compress(p, csize, &bout, &blen); break;
-            case COMP_LZW:
-                rc = lzw_compress(p, csize, &bout, &blen); break;
-            case COMP_LZWPRED: {
-                uint8_t* tmp = malloc(csize);
-                if (!tmp) { free(*out); return -1; }
-                memcpy(tmp, p, csize);
-                apply_predictor_sub(tmp, 1, 1, 1);
-                rc = lzw_compress(tmp, csize, &bout, &blen);
-                free(tmp);
-                break;
-            }
-            case COMP_HUFFMANPRED: {
-                uint8_t* tmp = malloc(csize);
-                if (!tmp) { free(*out); return -1; }
-                memcpy(tmp, p, csize);
-                apply_predictor_sub(tmp, 1, 1, 1);
-                rc = hp_compress_buffer(tmp, csize, &bout, &blen);
-                free(tmp);
-                break;
-            }
-            default:
-                fprintf(stderr, "Algoritmo no válido.\n");
-                free(*out); return -1;
-        }
-        if (rc != 0) { fprintf(stderr, "Error al comprimir chunk\n"); free(*out); return -1; }
-
-        if (*out_len + blen > cap) {
-            size_t ncap = cap * 2 + blen;
-            uint8_t* tmp2 = (uint8_t*)realloc(*out, ncap);
-            if (!tmp2) { free(bout); free(*out); return -1; }
-            *out = tmp2; cap = ncap;
-        }
-        memcpy(*out + *out_len, bout, blen);
-        *out_len += blen;
-        free(bout);
-        pos += csize;
+    ChunkedOptions co = {
+        .alg = cfg->comp_alg,
+        .chunk_bytes = cfg->chunk_bytes,
+        .nthreads = (in_len > cfg->chunk_bytes) ? inner_threads(cfg) : 1,
+        .journal = &cfg->journal,
+        .name = name,
+        .on_chunk = fp ? on_chunk_progress : NULL,
+        .chunk_ctx = fp,
+        .pooled = 1
+    };
+    if (fp) fp->comp_side = 0;
+    JLOG(&cfg->journal, "[JOURNAL] → %zu bytes en chunks de %zu\n", in_len, cfg->chunk_bytes);
+    if (chunked_compress_iov(&co, in, in_len, out) != 0) {
+        fprintf(stderr, "Error al comprimir chunk\n");
+        return -1;
     }
-
-    uint8_t* shrink = (uint8_t*)realloc(*out, *out_len ? *out_len : 1);
-    if (shrink) *out = shrink;
     return 0;
 }
 
 /* ---------- Descompresión por chunks ---------- */
-static int decompress_chunked(const Config* cfg,
+static int decompress_chunked(const Config* cfg, const char* name, FileProgress* fp,
                               const uint8_t* in, size_t in_len,
                               uint8_t** out, size_t* out_len)
 {
+    if (chunked_is_framed(in, in_len)) {
+        /* con -c -d los bytes ya se acreditaron al comprimir */
+        if (cfg->do_c) fp = NULL;
+        ChunkedOptions co = { .nthreads = inner_threads(cfg), .journal = &cfg->journal,
+                              .name = name, .on_chunk = fp ? on_chunk_progress : NULL,
+                              .chunk_ctx = fp, .pooled = 1 };
+        if (fp) fp->comp_side = 1;
+        if (chunked_decompress(&co, in, in_len, out, out_len) != 0) {
+            fprintf(stderr, "Falló descompresión chunk.\n");
+            return -1;
+        }
+        return 0;
+    }
+
+    /* Formato antiguo (chunks concatenados sin índice) */
     const size_t CH = cfg->chunk_bytes;
     size_t pos = 0;
     /* Descomprime en bloques y reconstruye en un único buffer final */
@@ -328,24 +261,22 @@ static int decompress_chunked(const Config* cfg,
         size_t csize = in_len - pos;
         if (csize > CH) csize = CH;
 
-        JLOG(&cfg->journal, "[JOURNAL] → Chunk dec (%zu bytes)\n", csize);
+        JLOG_DEBUG(&cfg->journal, "[JOURNAL] → Chunk dec (%zu bytes)\n", csize);
 
         const uint8_t* p = in + pos;
         uint8_t* bout = NULL;
         size_t blen = 0;
         int rc = 0;
 
-        switch (cfg->comp_alg) {
-            case COMP_RLEVAR:   rc = rle_var_decompress(p, csize, &bout, &blen); break;
-            case COMP_LZW:
-            case COMP_LZWPRED:  rc = lzw_decompress(p, csize, &bout, &blen); break;
-            case COMP_HUFFMANPRED: rc = hp_decompress_buffer(p, csize, &bout, &blen); break;
-            default: fprintf(stderr, "Algoritmo no válido.\n"); return -1;
+        if (cfg->comp_alg == COMP_DELTA16_LZW || cfg->comp_alg == COMP_DELTA16_HUFF) {
+            fprintf(stderr, "Algoritmo no válido.\n"); return -1;
         }
+        uint64_t t0 = journal_stage_begin();
+        journal_scope_set(&cfg->journal, name, (long)(pos / CH));
+        rc = codec_decompress(cfg->comp_alg, p, csize, &bout, &blen);
+        journal_scope_set(NULL, NULL, -1);
         if (rc != 0) { fprintf(stderr, "Falló descompresión chunk.\n"); free(*out); return -1; }
-
-        if (cfg->comp_alg == COMP_LZWPRED || cfg->comp_alg == COMP_HUFFMANPRED)
-            undo_predictor_sub(bout, 1, 1, 1);
+        journal_stage(&cfg->journal, name, "decompress", (long)(pos / CH), csize, blen, t0);
 
         uint8_t* merged = (uint8_t*)realloc(*out, *out_len + blen ? *out_len + blen : 1);
         if (!merged) { free(bout); free(*out); return -1; }
@@ -360,20 +291,63 @@ static int decompress_chunked(const Config* cfg,
 
 /* ---------- Pipeline principal: procesa un archivo completo ---------- */
 
-static int process_one_file(const char* in, const char* out,
-                            const Config* cfg,
-                            size_t* o_orig, size_t* o_fin, double* o_ms)
+/* Libera un buffer del pipeline salvo que sea el de lectura del Scratch.
+ * Los grandes vuelven al pool (bufpool.c); el resto se libera con free. */
+static void buf_release(uint8_t* b, const Scratch* sc) {
+    if (!sc || b != sc->rbuf) bufpool_put(b);
+}
+
+/* fd de la carpeta de 'path', reutilizado si es la misma que la del
+ * archivo anterior del lote (los lotes suelen venir de una carpeta).
+ * -1 = escribir con la ruta completa. */
+static int scratch_dirfd(Scratch* sc, const char* path, const char** name) {
+    const char* slash = strrchr(path, '/');
+    if (!slash) return -1;
+    size_t dlen = (size_t)(slash - path);
+    if (!sc->out_dir || strlen(sc->out_dir) != dlen || strncmp(sc->out_dir, path, dlen) != 0) {
+        if (sc->out_dirfd >= 0) close(sc->out_dirfd);
+        free(sc->out_dir);
+        sc->out_dir = strndup(path, dlen);
+        sc->out_dirfd = open(dlen ? sc->out_dir : "/", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    *name = slash + 1;
+    return sc->out_dirfd;
+}
+
+static int scratch_write(Scratch* sc, const char* path, const uint8_t* buf, size_t len) {
+    const char* name;
+    int dfd = scratch_dirfd(sc, path, &name);
+    if (dfd < 0) return write_file(path, buf, len);
+    return write_file_at(dfd, name, buf, len);
+}
+
+static int scratch_writev(Scratch* sc, const char* path, const struct iovec* iov, size_t n) {
+    const char* name;
+    int dfd = scratch_dirfd(sc, path, &name);
+    if (dfd < 0) return write_file_iov(path, iov, n);
+    return write_file_at_iov(dfd, name, iov, n);
+}
+
+static int run_stages(const char* in, const char* out,
+                      const Config* cfg, Scratch* sc, FileProgress* fp,
+                      size_t* o_orig, size_t* o_fin, double* o_ms)
 {
     JLOG(&cfg->journal, "\n[JOURNAL] Leyendo archivo: %s\n", in);
     /* Etapas: leer -> (compresión) -> (cifrado) -> (descifrado) -> (descompresión) -> guardar */
 
     uint8_t* buf = NULL;
     size_t len = 0;
+    const Journal* jr = &cfg->journal;
+    uint64_t ts = journal_stage_begin();   /* inicio de la etapa actual (--journal-json) */
 
-    if (read_file(in, &buf, &len) != 0) {
+    int rrc = sc ? read_file_reuse(in, &sc->rbuf, &sc->rcap, &len)
+                 : read_file_pooled(in, &buf, &len);
+    if (sc) buf = sc->rbuf;
+    if (rrc != 0) {
         fprintf(stderr, "Error al leer %s\n", in);
         return -1;
     }
+    journal_stage(jr, in, "read", -1, len, len, ts);
 
     if (o_orig) *o_orig = len;
 
@@ -382,31 +356,7 @@ static int process_one_file(const char* in, const char* out,
 
     uint8_t* tmp = NULL;
     size_t tlen = 0;
-
-    int is_wav_pcm16 = 0;
-    int wav_ch = 0, wav_sr = 0;
-    size_t wav_frames = 0;
-
-    if (cfg->do_c &&
-        (cfg->comp_alg == COMP_DELTA16_LZW ||
-         cfg->comp_alg == COMP_DELTA16_HUFF))
-    {
-        /* Detectar WAV y convertir a muestras para aplicar delta16 */
-        if (wav_is_riff_wave(buf, len)) {
-            int16_t* samples = NULL;
-            if (wav_decode_pcm16(buf, len, &samples,
-                                 &wav_frames, &wav_ch, &wav_sr) == 0) {
-
-                free(buf);
-                buf = (uint8_t*) samples;
-                len = wav_frames * wav_ch * 2;
-                is_wav_pcm16 = 1;
-
-                JLOG(&cfg->journal, "[JOURNAL] WAV detectado (%d ch, %d SR)\n",
-                       wav_ch, wav_sr);
-            }
-        }
-    }
+    ChunkedBuf chunks = { 0 };   /* salida por chunks aún sin juntar (writev) */
 
     /* ========== COMPRESIÓN ========== */
     if (cfg->do_c) {
@@ -415,53 +365,45 @@ static int process_one_file(const char* in, const char* out,
         if (cfg->comp_alg == COMP_DELTA16_LZW ||
             cfg->comp_alg == COMP_DELTA16_HUFF)
         {
-            if (is_wav_pcm16) {
-                /* Aplicar delta y empaquetar con cabecera simple */
-                delta16_forward((int16_t*)buf, wav_frames, wav_ch);
-
-                int rc;
-                if (cfg->comp_alg == COMP_DELTA16_LZW)
-                    rc = lzw_compress(buf, len, &tmp, &tlen);
-                else
-                    rc = hp_compress_buffer(buf, len, &tmp, &tlen);
-
-                if (rc != 0) {
-                    fprintf(stderr,"Error en delta16 comp\n");
-                    free(buf);
-                    return -1;
-                }
-
-                size_t head = 18;
-                uint8_t* pack = malloc(head + tlen);
-
-                memcpy(pack, WAV_MAGIC, 8);
-                wr16le(pack+8, wav_ch);
-                wr32le(pack+10, wav_sr);
-                wr32le(pack+14, wav_frames);
-                memcpy(pack+head, tmp, tlen);
-
-                free(tmp);
-                free(buf);
-
-                buf = pack;
-                len = head + tlen;
-
+            /* WAV PCM16: diferencias entre muestras + cabecera (codec.c) */
+            journal_scope_set(jr, in, -1);
+            int rc = codec_wav_compress(cfg->comp_alg, buf, len, &tmp, &tlen);
+            journal_scope_set(NULL, NULL, -1);
+            if (rc < 0) {
+                fprintf(stderr,"Error en delta16 comp\n");
+                buf_release(buf, sc);
+                return -1;
+            }
+            if (rc == 0) {
+                JLOG(&cfg->journal, "[JOURNAL] WAV delta16: %zu -> %zu bytes\n", len, tlen);
+                metrics_add_bytes(cfg->comp_alg, 1, len, tlen);
+                buf_release(buf, sc);
+                buf = tmp;
+                len = tlen;
+                tmp = NULL;
+                tlen = 0;
                 goto ENCRYPT;
             }
         }
 
         /* Si no es WAV-delta16 → compresión general chunked */
-        if (compress_chunked(cfg, buf, len, &tmp, &tlen) != 0) {
+        if (compress_chunked(cfg, in, fp, buf, len, &chunks) != 0) {
             fprintf(stderr,"Error en compresión chunked\n");
-            free(buf);
+            buf_release(buf, sc);
+            return -1;
+        }
+        metrics_add_bytes(cfg->comp_alg, 1, len, chunks.total);
+
+        buf_release(buf, sc);
+        buf = NULL;
+        len = chunks.total;
+        /* Las etapas siguientes trabajan sobre un buffer contiguo; si no
+         * hay ninguna, los chunks se escriben tal cual con writev. */
+        if ((cfg->do_e || cfg->do_u || cfg->do_d) &&
+            chunked_buf_flatten(&chunks, &buf, &len) != 0) {
+            chunked_buf_free(&chunks);
             return -1;
         }
-
-        free(buf);
-        buf = tmp;
-        len = tlen;
-        tmp = NULL;
-        tlen = 0;
 
         JLOG(&cfg->journal, "[JOURNAL] Compresión lista: %zu bytes\n", len);
     }
@@ -472,6 +414,8 @@ ENCRYPT:
     if (cfg->do_e) {
         JLOG(&cfg->journal, "[JOURNAL] Cifrando...\n");
         /* Cifrado en memoria: Vigenere XOR simple o AES */
+        ts = journal_stage_begin();
+        size_t before = len;
 
         if (cfg->enc_alg == ENC_VIG) {
             vigenere_encrypt(buf, len, (uint8_t*)cfg->key, strlen(cfg->key));
@@ -479,36 +423,40 @@ ENCRYPT:
         } else if (cfg->enc_alg == ENC_AES) {
             if (aes_encrypt_buffer(buf, len, cfg->key, &tmp, &tlen) != 0) {
                 fprintf(stderr,"AES falló\n");
-                free(buf);
+                buf_release(buf, sc);
                 return -1;
             }
-            free(buf);
+            buf_release(buf, sc);
             buf = tmp;
             len = tlen;
             tmp = NULL;
             tlen = 0;
         }
+        journal_stage(jr, in, "encrypt", -1, before, len, ts);
     }
 
     /* ========== DESCIFRADO ========== */
     if (cfg->do_u) {
         JLOG(&cfg->journal, "[JOURNAL] Descifrando...\n");
         /* Inverso del paso anterior si fue solicitado */
+        ts = journal_stage_begin();
+        size_t before = len;
         if (cfg->enc_alg == ENC_VIG) {
             vigenere_decrypt(buf, len,
                              (uint8_t*)cfg->key, strlen(cfg->key));
         } else if (cfg->enc_alg == ENC_AES) {
             if (aes_decrypt_buffer(buf, len, cfg->key, &tmp, &tlen) != 0) {
                 fprintf(stderr,"AES descifrado falló\n");
-                free(buf);
+                buf_release(buf, sc);
                 return -1;
             }
-            free(buf);
+            buf_release(buf, sc);
             buf = tmp;
             len = tlen;
             tmp = NULL;
             tlen = 0;
         }
+        journal_stage(jr, in, "decrypt", -1, before, len, ts);
     }
 
     /* ========== DESCOMPRESIÓN ========== */
@@ -517,60 +465,36 @@ ENCRYPT:
         /* Si es delta16 reconstruir WAV, si no descompresión chunked normal */
 
         /* WAV delta16 */
-        if (cfg->comp_alg == COMP_DELTA16_LZW ||
-            cfg->comp_alg == COMP_DELTA16_HUFF)
+        if ((cfg->comp_alg == COMP_DELTA16_LZW ||
+             cfg->comp_alg == COMP_DELTA16_HUFF) &&
+            codec_wav_is_packed(buf, len))
         {
-            if (len >= 18 && memcmp(buf, WAV_MAGIC, 8)==0) {
-
-                uint16_t ch = rd16le(buf+8);
-                uint32_t sr = rd32le(buf+10);
-                uint32_t fr = rd32le(buf+14);
-
-                const uint8_t* pay = buf+18;
-                size_t pay_len = len-18;
-
-                int rc;
-                if (cfg->comp_alg==COMP_DELTA16_LZW)
-                    rc = lzw_decompress(pay, pay_len, &tmp, &tlen);
-                else
-                    rc = hp_decompress_buffer(pay, pay_len, &tmp, &tlen);
-
-                if (rc!=0) {
-                    fprintf(stderr,"Falló descomp delta16\n");
-                    free(buf);
-                    return -1;
-                }
-
-                free(buf);
-                buf = tmp;
-                len = tlen;
-                tmp = NULL;
-                tlen = 0;
-
-                delta16_inverse((int16_t*)buf, fr, ch);
-
-                uint8_t* out_wav = NULL;
-                size_t out_wav_len = 0;
-
-                if (wav_encode_pcm16((int16_t*)buf, fr, ch, sr,
-                                     &out_wav, &out_wav_len)==0)
-                {
-                    free(buf);
-                    buf = out_wav;
-                    len = out_wav_len;
-                }
-                goto SAVE;
+            journal_scope_set(jr, in, -1);
+            int rc = codec_wav_decompress(cfg->comp_alg, buf, len, &tmp, &tlen);
+            journal_scope_set(NULL, NULL, -1);
+            if (rc != 0) {
+                fprintf(stderr,"Falló descomp delta16\n");
+                buf_release(buf, sc);
+                return -1;
             }
+            metrics_add_bytes(cfg->comp_alg, 0, len, tlen);
+            buf_release(buf, sc);
+            buf = tmp;
+            len = tlen;
+            tmp = NULL;
+            tlen = 0;
+            goto SAVE;
         }
 
         /* No delta16 → chunked */
-        if (decompress_chunked(cfg, buf, len, &tmp, &tlen) != 0) {
+        if (decompress_chunked(cfg, in, fp, buf, len, &tmp, &tlen) != 0) {
             fprintf(stderr,"Error descomp chunked\n");
-            free(buf);
+            buf_release(buf, sc);
             return -1;
         }
+        metrics_add_bytes(cfg->comp_alg, 0, len, tlen);
 
-        free(buf);
+        buf_release(buf, sc);
         buf = tmp;
         len = tlen;
         tmp = NULL;
@@ -583,7 +507,14 @@ SAVE:
     JLOG(&cfg->journal, "[JOURNAL] Guardando en %s\n", out);
     /* Escribe resultado final a disco y mide tiempo total */
 
-    int wres = write_file(out, buf, len);
+    ts = journal_stage_begin();
+    int wres;
+    if (chunks.base)
+        wres = sc ? scratch_writev(sc, out, chunks.iov, chunks.n_iov)
+                  : write_file_iov(out, chunks.iov, chunks.n_iov);
+    else
+        wres = sc ? scratch_write(sc, out, buf, len) : write_file(out, buf, len);
+    if (wres == 0) journal_stage(jr, in, "write", -1, len, len, ts);
 
     clock_gettime(CLOCK_MONOTONIC, &t1);
     double ms = (t1.tv_sec-t0.tv_sec)*1000.0 +
@@ -592,10 +523,100 @@ SAVE:
     if (o_fin) *o_fin = len;
     if (o_ms)  *o_ms  = ms;
 
-    free(buf);
+    chunked_buf_free(&chunks);
+    buf_release(buf, sc);
     return wres;
 }
 
+/* Bytes que reserva un archivo de 'size' bytes en --mem-budget: entrada
+ * + salida de cada etapa, como si todas siguieran vivas (cota, no medida).
+ * Compresión: cota del codec. Descompresión: tamaño original de la
+ * cabecera de chunks si se puede leer, si no 3x. AES suma una copia. */
+static uint64_t file_mem_estimate(const Config* cfg, const char* in, uint64_t size)
+{
+    uint64_t est = size;        /* buffer de lectura */
+    uint64_t cur = size;        /* lo que recibe la etapa siguiente */
+    if (cfg->do_c) {
+        CompAlg a = cfg->comp_alg;
+        if (a == COMP_DELTA16_LZW || a == COMP_DELTA16_HUFF) {
+            est += size;        /* muestras con diferencias */
+            a = (a == COMP_DELTA16_LZW) ? COMP_LZW : COMP_HUFFMANPRED;
+        }
+        cur = codec_compress_bound(a, (size_t)size);
+        est += cur;
+    }
+    if (cfg->enc_alg == ENC_AES && (cfg->do_e || cfg->do_u))
+        est += cur + 32;
+    if (cfg->do_d) {
+        uint64_t raw = size;
+        if (!cfg->do_c && (cfg->do_u || chunked_file_raw_len(in, &raw) != 0))
+            raw = cur * 3;
+        est += raw;
+    }
+    return est;
+}
+
+/* Resumen de --mem-budget en el journal */
+static void log_mem_budget(const Config* cfg)
+{
+    if (!membudget_on()) return;
+    MemBudgetStats st;
+    membudget_stats(&st);
+    JLOG(&cfg->journal, "[JOURNAL] --mem-budget: tope %.1f MB, pico reservado %.1f MB, "
+         "%llu esperas (%.1f ms), %llu reservas sobre el tope\n",
+         st.limit / (1024.0 * 1024.0), st.peak / (1024.0 * 1024.0),
+         (unsigned long long)st.waits, st.wait_ns / 1e6, (unsigned long long)st.oversize);
+}
+
+/* Resumen del pool de buffers en el journal: total y por clase */
+static void log_class(size_t size, uint64_t gets, uint64_t hits, void* ctx)
+{
+    const Config* cfg = ctx;
+    JLOG(&cfg->journal, "[JOURNAL]   clase %8.2f MB: %llu pedidos, %.1f%% aciertos\n",
+         size / (1024.0 * 1024.0), (unsigned long long)gets, gets ? 100.0 * hits / gets : 0.0);
+}
+
+static void log_buf_pool(const Config* cfg)
+{
+    BufPoolStats st;
+    bufpool_stats(&st);
+    if (st.gets == 0) return;
+    JLOG(&cfg->journal, "[JOURNAL] Pool de buffers: %llu pedidos, %.1f%% aciertos, %.1f MB reutilizados, "
+         "%llu descartados, pico tibio %.1f MB\n",
+         (unsigned long long)st.gets, 100.0 * st.hits / st.gets,
+         st.reused_bytes / (1024.0 * 1024.0), (unsigned long long)st.dropped,
+         st.warm_peak / (1024.0 * 1024.0));
+    bufpool_each_class(log_class, (void*)cfg);
+}
+
+/* Procesa un archivo y lo cuenta en --metrics-file y --progress */
+static int process_one_file(const char* in, const char* out,
+                            const Config* cfg, Scratch* sc,
+                            size_t* o_orig, size_t* o_fin, double* o_ms)
+{
+    size_t orig = 0;
+    uint64_t need = 0;
+    if (membudget_on()) {
+        /* se reserva antes de leer y se devuelve después de escribir */
+        struct stat st;
+        need = stat(in, &st) == 0 ? file_mem_estimate(cfg, in, (uint64_t)st.st_size) : 0;
+        uint64_t w = membudget_acquire(need);
+        if (w) JLOG(&cfg->journal, "[JOURNAL] --mem-budget: %s esperó %.1f ms (reserva %.1f MB)\n",
+                    in, w / 1e6, need / (1024.0 * 1024.0));
+    }
+    FileProgress fp = { 0 };
+    uint64_t t0 = journal_now_ns();
+    memtrack_stage_begin(t0);       /* pico de heap del archivo completo (MEMTRACK) */
+    int rc = run_stages(in, out, cfg, sc, progress_on() ? &fp : NULL, &orig, o_fin, o_ms);
+    memtrack_stage_end("file", t0, NULL);
+    membudget_release(need);
+    metrics_file_done(rc == 0);
+    uint64_t got = atomic_load(&fp.credited);
+    progress_file_done(orig > got ? orig - got : 0, rc == 0);
+    if (o_orig) *o_orig = orig;
+    return rc;
+}
+
 /* ---------- Macro de journaling ---------- */
 #ifndef JPRINT
 #define JPRINT(...) \
@@ -615,6 +636,10 @@ static int parse_args(int argc, char* argv[], Config* cfg)
     cfg->workers = 0;
     cfg->inner_workers = 0;
     cfg->chunk_bytes = (size_t)DEFAULT_CHUNK_MB * 1024ull * 1024ull;
+    cfg->batch_bytes = (size_t)DEFAULT_BATCH_MB * 1024ull * 1024ull;
+    cfg->solid_bytes = (size_t)DEFAULT_SOLID_MB * 1024ull * 1024ull;
+    cfg->metrics_interval = 15;
+    cfg->progress_fd = -1;
 
     journal_init(&cfg->journal);
 
@@ -625,6 +650,21 @@ static int parse_args(int argc, char* argv[], Config* cfg)
         {"workers",       required_argument, 0, 4}, 
         {"inner-workers", required_argument, 0, 5}, 
         {"chunk-mb",      required_argument, 0, 6}, 
+        {"batch-mb",      required_argument, 0, 7},
+        {"archive",       no_argument,       0, 8},
+        {"solid-mb",      required_argument, 0, 9},
+        {"extract",       required_argument, 0, 10},
+        {"list",          no_argument,       0, 11},
+        {"extract-range", required_argument, 0, 12},
+        {"journal-json",  required_argument, 0, 13},
+        {"trace",         required_argument, 0, 14},
+        {"metrics-file",  required_argument, 0, 15},
+        {"metrics-interval", required_argument, 0, 16},
+        {"perf-counters", no_argument,       0, 17},
+        {"progress",      no_argument,       0, 18},
+        {"progress-fd",   required_argument, 0, 19},
+        {"mem-budget",    required_argument, 0, 20},
+        {"numa",          no_argument,       0, 21},
         {0,0,0,0}
     };
 
@@ -692,6 +732,102 @@ static int parse_args(int argc, char* argv[], Config* cfg)
                 }
                 break;
 
+            case 7:
+                {
+                    long mb = atol(optarg);
+                    if (mb < 0) mb = 0;      // 0 = sin lotes
+                    if (mb > 1024) mb = 1024;
+                    cfg->batch_bytes = (size_t)mb * 1024ull * 1024ull;
+                }
+                break;
+
+            case 8: cfg->archive = 1; break;
+
+            case 9:
+                {
+                    long mb = atol(optarg);
+                    if (mb < 1) mb = 1;
+                    if (mb > 1024) mb = 1024;
+                    cfg->solid_bytes = (size_t)mb * 1024ull * 1024ull;
+                }
+                break;
+
+            case 10: cfg->extract_name = optarg; break;
+            case 11: cfg->list_archive = 1; break;
+
+            case 12:
+                {
+                    /* OFFSET:LEN en bytes (LEN vacío = hasta el final) */
+                    char* end = NULL;
+                    cfg->range_off = strtoull(optarg, &end, 10);
+                    if (end == optarg || *end != ':') {
+                        fprintf(stderr, "Rango inválido (use OFFSET:LEN): %s\n", optarg);
+                        return -1;
+                    }
+                    const char* l = end + 1;
+                    cfg->range_len = *l ? strtoull(l, &end, 10) : UINT64_MAX;
+                    if (*l && *end != '\0') {
+                        fprintf(stderr, "Rango inválido (use OFFSET:LEN): %s\n", optarg);
+                        return -1;
+                    }
+                    cfg->has_range = 1;
+                }
+                break;
+
+            case 13:
+                if (journal_open_stages(&cfg->journal, optarg) != 0) {
+                    fprintf(stderr, "No se pudo abrir %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 14:
+                if (trace_open(optarg) != 0) {
+                    fprintf(stderr, "No se pudo abrir %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 15: cfg->metrics_path = optarg; break;
+
+            case 16:
+                {
+                    long s = atol(optarg);
+                    if (s < 0) s = 0;        // 0 = solo al terminar
+                    if (s > 86400) s = 86400;
+                    cfg->metrics_interval = (unsigned)s;
+                }
+                break;
+
+            case 17: perfctr_enable(); break;   /* si no hay contadores, solo avisa */
+
+            case 18: cfg->progress = 1; break;
+
+            case 19:
+                {
+                    char* end = NULL;
+                    long fd = strtol(optarg, &end, 10);
+                    if (end == optarg || *end != '\0' || fd < 0 || fcntl((int)fd, F_GETFD) < 0) {
+                        fprintf(stderr, "--progress-fd: descriptor inválido: %s\n", optarg);
+                        return -1;
+                    }
+                    cfg->progress_fd = (int)fd;
+                }
+                break;
+
+            case 20:
+                {
+                    uint64_t b = 0;
+                    if (membudget_parse(optarg, &b) != 0) {
+                        fprintf(stderr, "--mem-budget: tamaño inválido (ej. 8G, 512M): %s\n", optarg);
+                        return -1;
+                    }
+                    membudget_set(b);   /* 0 = sin límite */
+                }
+                break;
+
+            case 21: bigbuf_set_numa(1); break;   /* si mbind falla, solo avisa */
+
             default:
                 fprintf(stderr, "Opción inválida\n");
                 return -1;
@@ -705,8 +841,8 @@ static int parse_args(int argc, char* argv[], Config* cfg)
     }
 #endif
 
-    /* Validación mínima */
-    if (!cfg->in_path || !cfg->out_path) {
+    /* Validación mínima (--list solo necesita -i) */
+    if (!cfg->in_path || (!cfg->out_path && !cfg->list_archive)) {
         fprintf(stderr, "Debe indicar ruta de entrada -i y ruta de salida -o.\n");
         return -1;
     }
@@ -722,12 +858,6 @@ static int parse_args(int argc, char* argv[], Config* cfg)
 
 
 /* ---------- Helpers para archivos ---------- */
-static int is_regular(const char* p) {
-    /* Devuelve 1 si es archivo regular */
-    struct stat st;
-    return (stat(p, &st) == 0 && S_ISREG(st.st_mode));
-}
-
 static int is_dir(const char* p) {
     /* Devuelve 1 si es carpeta */
     struct stat st;
@@ -745,46 +875,6 @@ static char* join_path(const char* a, const char* b) {
     return r;
 }
 
-/*************************************************************
- *                 LISTA DE ARCHIVOS DE CARPETA
- *************************************************************/
-typedef struct {
-    char** in;
-    char** out;
-    size_t count;
-    size_t cap;
-} FileList;
-
-static void fl_init(FileList* fl) {
-    /* Inicializa lista dinámica de archivos */
-    fl->count = 0;
-    fl->cap = 32;
-    fl->in = malloc(sizeof(char*) * fl->cap);
-    fl->out = malloc(sizeof(char*) * fl->cap);
-}
-
-static void fl_push(FileList* fl, char* in, char* out) {
-    /* Agrega archivo (expande si hace falta) */
-    if (fl->count == fl->cap) {
-        fl->cap *= 2;
-        fl->in = realloc(fl->in, sizeof(char*) * fl->cap);
-        fl->out = realloc(fl->out, sizeof(char*) * fl->cap);
-    }
-    fl->in[fl->count] = in;
-    fl->out[fl->count] = out;
-    fl->count++;
-}
-
-static void fl_free(FileList* fl) {
-    /* Libera toda la lista y rutas */
-    for (size_t i = 0; i < fl->count; i++) {
-        free(fl->in[i]);
-        free(fl->out[i]);
-    }
-    free(fl->in);
-    free(fl->out);
-}
-
 /*************************************************************
  *                   Estructura de Tarea
  *************************************************************/
@@ -792,6 +882,7 @@ typedef struct {
     char* in;
     char* out;
     const Config* cfg;
+    ThreadPool* pool;   /* pool externo si --workers auto (para reajustar cupo) */
 
     int rc;
     size_t orig;
@@ -802,16 +893,157 @@ typedef struct {
 static void task_run(void* arg) {
     /* Ejecuta la tarea de proceso para un archivo */
     Task* t = arg;
+    /* En modo auto se re-evalúa la cuota de CPU (valor cacheado, barato) */
+    if (t->pool) tp_set_limit(t->pool, (size_t)hw_threads());
     t->rc = process_one_file(
         t->in,
         t->out,
         t->cfg,
+        NULL,
         &t->orig,
         &t->fin,
         &t->ms
     );
 }
 
+/*************************************************************
+ *              LOTES DE ARCHIVOS PEQUEÑOS
+ *************************************************************/
+/* Con 100k+ archivos de pocos KB, cada Task pagaría un despacho del pool,
+ * un malloc de lectura, la inicialización de la tabla LZW de 4 MB y un
+ * open de carpeta. Un Batch agrupa archivos pequeños hasta ~batch_bytes y
+ * los procesa en serie en un mismo hilo con un único Scratch. */
+typedef struct {
+    Task** files;
+    size_t count;
+    size_t cap;
+    size_t bytes;
+} Batch;
+
+static void batch_push(Batch* b, Task* t, size_t size) {
+    if (b->count == b->cap) {
+        b->cap = b->cap ? b->cap * 2 : 64;
+        b->files = realloc(b->files, sizeof(Task*) * b->cap);
+    }
+    b->files[b->count++] = t;
+    b->bytes += size;
+}
+
+static void batch_run(void* arg) {
+    Batch* b = arg;
+    if (b->count == 0) { free(b->files); free(b); return; }
+
+    const Config* cfg = b->files[0]->cfg;
+    if (b->files[0]->pool) tp_set_limit(b->files[0]->pool, (size_t)hw_threads());
+
+    Scratch sc = { .rbuf = NULL, .rcap = 0, .out_dir = NULL, .out_dirfd = -1 };
+
+    JLOG(&cfg->journal, "[JOURNAL] Lote: %zu archivos, %zu bytes\n", b->count, b->bytes);
+
+    for (size_t i = 0; i < b->count; i++) {
+        Task* t = b->files[i];
+        t->rc = process_one_file(t->in, t->out, t->cfg, &sc, &t->orig, &t->fin, &t->ms);
+    }
+
+    free(sc.rbuf);
+    if (sc.out_dirfd >= 0) close(sc.out_dirfd);
+    free(sc.out_dir);
+    free(b->files);
+    free(b);
+}
+
+/*************************************************************
+ *        LISTA DE TAREAS DE CARPETA (se llena en streaming)
+ *************************************************************/
+/* El recorrido (walk.c) llama on_file_found desde varios hilos: cada
+ * archivo se convierte en Task y se encola de inmediato en el pool
+ * externo. La prioridad es el tamaño, así entre los pendientes siempre
+ * se toma el mayor (LPT) aunque el listado aún no haya terminado. */
+typedef struct {
+    Task** items;
+    size_t count;
+    size_t cap;
+    pthread_mutex_t mtx;
+
+    const Config* cfg;
+    ThreadPool* pool;
+    int auto_workers;
+
+    Batch* open_batch;   /* lote de archivos pequeños aún sin encolar */
+    size_t n_batches;
+} TaskList;
+
+static void tl_init(TaskList* tl, const Config* cfg, ThreadPool* pool) {
+    tl->count = 0;
+    tl->cap = 32;
+    tl->items = malloc(sizeof(Task*) * tl->cap);
+    pthread_mutex_init(&tl->mtx, NULL);
+    tl->cfg = cfg;
+    tl->pool = pool;
+    tl->auto_workers = (cfg->workers == 0);
+    tl->open_batch = NULL;
+    tl->n_batches = 0;
+}
+
+/* Encola el lote abierto (si lo hay). Llamar tras terminar el recorrido. */
+static void tl_flush_batch(TaskList* tl) {
+    pthread_mutex_lock(&tl->mtx);
+    Batch* b = tl->open_batch;
+    tl->open_batch = NULL;
+    if (b) tl->n_batches++;
+    pthread_mutex_unlock(&tl->mtx);
+    if (b) tp_submit_prio(tl->pool, batch_run, b, b->bytes);
+}
+
+static void tl_free(TaskList* tl) {
+    /* Libera tareas y rutas */
+    for (size_t i = 0; i < tl->count; i++) {
+        free(tl->items[i]->in);
+        free(tl->items[i]->out);
+        free(tl->items[i]);
+    }
+    free(tl->items);
+    pthread_mutex_destroy(&tl->mtx);
+}
+
+static void on_file_found(const char* rel, size_t size, void* ctx) {
+    TaskList* tl = ctx;
+    Task* t = calloc(1, sizeof(Task));
+    if (!t) return;
+    progress_add_total(size);
+    t->in  = join_path(tl->cfg->in_path, rel);
+    t->out = join_path(tl->cfg->out_path, rel);
+    t->cfg = tl->cfg;
+    t->pool = tl->auto_workers ? tl->pool : NULL;
+
+    int small = (tl->cfg->batch_bytes > 0 && size < SMALL_FILE_BYTES &&
+                 size < tl->cfg->batch_bytes);
+    Batch* ready = NULL;
+
+    pthread_mutex_lock(&tl->mtx);
+    if (tl->count == tl->cap) {
+        tl->cap *= 2;
+        tl->items = realloc(tl->items, sizeof(Task*) * tl->cap);
+    }
+    tl->items[tl->count++] = t;
+    if (small) {
+        if (!tl->open_batch) tl->open_batch = calloc(1, sizeof(Batch));
+        batch_push(tl->open_batch, t, size);
+        if (tl->open_batch->bytes >= tl->cfg->batch_bytes ||
+            tl->open_batch->count >= BATCH_MAX_FILES) {
+            ready = tl->open_batch;
+            tl->open_batch = NULL;
+            tl->n_batches++;
+        }
+    }
+    pthread_mutex_unlock(&tl->mtx);
+
+    if (!small)
+        tp_submit_prio(tl->pool, task_run, t, size);
+    else if (ready)
+        tp_submit_prio(tl->pool, batch_run, ready, ready->bytes);
+}
+
 /*************************************************************
  *                 MODO INTERACTIVO
  *************************************************************/
@@ -922,6 +1154,133 @@ static int run_interactive() {
     return system(cmd);
 }
 
+/*************************************************************
+ *              MODO CONTENEDOR (--archive)
+ *************************************************************/
+static int run_archive(const Config* cfg, int isFolder) {
+    if (cfg->list_archive)
+        return archive_list(cfg->in_path, stdout) == 0 ? 0 : 1;
+
+    if (cfg->do_e || cfg->do_u) {
+        fprintf(stderr, "El modo contenedor no admite cifrado (-e/-u).\n");
+        return 1;
+    }
+
+    if (cfg->extract_name) {
+        if (archive_extract_file(cfg->in_path, cfg->extract_name, cfg->out_path) != 0) {
+            fprintf(stderr, "No se pudo extraer %s de %s\n", cfg->extract_name, cfg->in_path);
+            return 1;
+        }
+        printf("Extraído %s -> %s\n", cfg->extract_name, cfg->out_path);
+        return 0;
+    }
+
+    ArchiveOptions ao = {
+        .alg = cfg->comp_alg,
+        .block_bytes = cfg->solid_bytes,
+        .nthreads = (cfg->inner_workers > 0) ? (size_t)cfg->inner_workers : (size_t)hw_threads(),
+        .journal = &cfg->journal
+    };
+    ArchiveStats st = {0};
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    int rc;
+    if (cfg->do_c) {
+        if (!isFolder) { fprintf(stderr, "--archive requiere una carpeta de entrada.\n"); return 1; }
+        if (cfg->comp_alg == COMP_DELTA16_LZW || cfg->comp_alg == COMP_DELTA16_HUFF) {
+            fprintf(stderr, "delta16 no está disponible en modo contenedor.\n");
+            return 1;
+        }
+        printf("Creando contenedor...\n");
+        rc = archive_create(cfg->in_path, cfg->out_path, &ao, &st);
+    } else if (cfg->do_d) {
+        printf("Extrayendo contenedor...\n");
+        rc = archive_extract_all(cfg->in_path, cfg->out_path, &ao, &st);
+    } else {
+        fprintf(stderr, "Indique -c (crear) o -d (extraer) con --archive.\n");
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ms = (t1.tv_sec - t0.tv_sec) * 1000.0 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+
+    if (rc != 0) {
+        fprintf(stderr, "Error en modo contenedor (%s)\n", cfg->in_path);
+        return 1;
+    }
+
+    char rh[32], ah[32];
+    human_readable((size_t)st.raw_bytes, rh, sizeof(rh));
+    human_readable((size_t)st.arc_bytes, ah, sizeof(ah));
+    printf("\nArchivos: %zu  Bloques: %zu\n", st.n_files, st.n_blocks);
+    printf("Datos: %s  Contenedor: %s  (%.2f%% ahorro)  Tiempo: %.3f ms\n", rh, ah,
+           st.raw_bytes ? (1.0 - (double)st.arc_bytes / st.raw_bytes) * 100.0 : 0.0, ms);
+    return 0;
+}
+
+/*************************************************************
+ *              EXTRACCIÓN DE RANGO (--extract-range)
+ *************************************************************/
+static int run_extract_range(const Config* cfg) {
+    size_t nthreads = inner_threads(cfg);
+    uint8_t* out = NULL;
+    size_t out_len = 0;
+    int rc;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    if (!cfg->do_u) {
+        /* Sin cifrado: solo se leen índice y chunks del rango (pread) */
+        rc = chunked_read_range_file(cfg->in_path, cfg->range_off, cfg->range_len,
+                                     nthreads, &out, &out_len);
+    } else {
+        /* El cifrado cubre todo el archivo: hay que leer y descifrar
+         * completo; la descompresión sigue limitada al rango. */
+        uint8_t* buf = NULL;
+        size_t len = 0;
+        if (read_file(cfg->in_path, &buf, &len) != 0) {
+            fprintf(stderr, "Error al leer %s\n", cfg->in_path);
+            return 1;
+        }
+        if (cfg->enc_alg == ENC_VIG) {
+            vigenere_decrypt(buf, len, (uint8_t*)cfg->key, strlen(cfg->key));
+        } else if (cfg->enc_alg == ENC_AES) {
+            uint8_t* dec = NULL;
+            size_t dlen = 0;
+            if (aes_decrypt_buffer(buf, len, cfg->key, &dec, &dlen) != 0) {
+                fprintf(stderr, "AES descifrado falló\n");
+                free(buf);
+                return 1;
+            }
+            free(buf);
+            buf = dec;
+            len = dlen;
+        }
+        rc = chunked_read_range(buf, len, cfg->range_off, cfg->range_len,
+                                nthreads, &out, &out_len);
+        free(buf);
+    }
+
+    if (rc != 0) {
+        fprintf(stderr, "No se pudo extraer el rango de %s (¿formato sin índice?)\n",
+                cfg->in_path);
+        return 1;
+    }
+
+    rc = write_file(cfg->out_path, out, out_len);
+    free(out);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ms = (t1.tv_sec - t0.tv_sec) * 1000.0 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+    if (rc != 0) {
+        fprintf(stderr, "Error al escribir %s\n", cfg->out_path);
+        return 1;
+    }
+    printf("Rango %llu:+%zu -> %s  Tiempo: %.3f ms\n",
+           (unsigned long long)cfg->range_off, out_len, cfg->out_path, ms);
+    return 0;
+}
+
 /*************************************************************
  *                           MAIN
  *************************************************************/
@@ -931,13 +1290,40 @@ int main(int argc, char* argv[])
     if (argc == 1)
         return run_interactive();
 
+    /* Subcomando de benchmark: gsea bench -i <corpus> ... */
+    if (strcmp(argv[1], "bench") == 0)
+        return bench_main(argc - 1, argv + 1);
+
+    /* Corpus sintético determinista: gsea gen-corpus -o <carpeta> */
+    if (strcmp(argv[1], "gen-corpus") == 0)
+        return corpus_main(argc - 1, argv + 1);
+
     Config cfg;
     if (parse_args(argc, argv, &cfg) != 0)
         return 1;
+    journal_set_default(&cfg.journal);   /* para los JTRACE de los codecs */
+    if (cfg.metrics_path && metrics_open(cfg.metrics_path, cfg.metrics_interval) != 0) {
+        fprintf(stderr, "No se pudo escribir %s\n", cfg.metrics_path);
+        return 1;
+    }
+
+    JLOG(&cfg.journal, "[JOURNAL] Buffers >= %zu MB: THP %s, NUMA local %s\n",
+         BIGBUF_MIN / (1024 * 1024), bigbuf_thp_mode(), bigbuf_numa_on() ? "sí" : "no");
 
     /* ¿Es archivo único o carpeta? */
     int isFolder = is_dir(cfg.in_path);
 
+    if (cfg.has_range) {
+        if (isFolder) { fprintf(stderr, "--extract-range requiere un archivo.\n"); return 1; }
+        return run_extract_range(&cfg);
+    }
+
+    /* Contenedor sólido: explícito (--archive/--extract/--list) o al
+     * descomprimir un archivo que ya es un contenedor */
+    if (cfg.archive || cfg.extract_name || cfg.list_archive ||
+        (cfg.do_d && !isFolder && archive_is_archive(cfg.in_path)))
+        return run_archive(&cfg, isFolder);
+
     /* Si es archivo único */
     if (!isFolder) {
         /* Modo archivo único (sin pool externo) */
@@ -949,7 +1335,17 @@ int main(int argc, char* argv[])
             .cfg = &cfg
         };
 
+        struct stat st;
+        if ((cfg.progress || cfg.progress_fd >= 0) && progress_start(cfg.progress, cfg.progress_fd) == 0) {
+            progress_add_total(stat(cfg.in_path, &st) == 0 ? (uint64_t)st.st_size : 0);
+            progress_total_known();
+        }
         task_run(&t);
+        progress_stop();
+        log_mem_budget(&cfg);
+        log_buf_pool(&cfg);
+        bufpool_trim();
+        codec_scratch_trim();
 
         char oh[32], fh[32];
         human_readable(t.orig, oh, sizeof(oh));
@@ -967,59 +1363,95 @@ int main(int argc, char* argv[])
 
     /* Si es carpeta */
     printf("Procesando carpeta con hilos...\n");
-    /* Modo carpeta: lista archivos regulares y usa thread pool externo */
-
-    FileList fl;
-    fl_init(&fl);
-
-    DIR* d = opendir(cfg.in_path);
-    struct dirent* de;
-
-    while ((de = readdir(d))) {
-        if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
-            continue;
-
-        char* in_full  = join_path(cfg.in_path, de->d_name);
-        char* out_full = join_path(cfg.out_path, de->d_name);
-
-        if (is_regular(in_full))
-            fl_push(&fl, in_full, out_full);
-        else {
-            free(in_full);
-            free(out_full);
-        }
-    }
-    closedir(d);
-
-    /* Crear carpeta de salida si no existe */
-    mkdir(cfg.out_path, 0755);
+    /* Modo carpeta: recorrido recursivo que alimenta el thread pool externo */
 
     /* Pool externo con N trabajadores parametrizable */
     size_t outer = (cfg.workers > 0) ? (size_t)cfg.workers : (size_t)hw_threads();
-    /* outer = hilos para archivos; inner (cfg->inner_workers) se usa dentro de compresión chunked */
-    ThreadPool* tp = tp_create(outer);
+    /* outer = hilos para archivos; inner (cfg->inner_workers) se usa dentro de compresión chunked.
+     * En modo auto el pool se crea con el techo de afinidad y el cupo sigue a la cuota. */
+    size_t ceiling = outer;
+    if (cfg.workers == 0 && (size_t)cpu_count_affinity() > ceiling)
+        ceiling = (size_t)cpu_count_affinity();
+    /* Pool de buffers: un buffer tibio por clase y trabajador. Con
+     * --mem-budget los tibios siguen residentes aunque no estén en vuelo:
+     * se les da 1/8 del presupuesto y el resto queda para las tareas. */
+    MemBudgetStats mb;
+    membudget_stats(&mb);
+    uint64_t warm = mb.limit / 8;
+    if (warm) membudget_set(mb.limit - warm);
+    bufpool_set_limits(outer, warm);
+    ThreadPool* tp = tp_create(ceiling);
+    tp_set_limit(tp, outer);
+    metrics_watch_pool(tp);
     JLOG(&cfg.journal, "[JOURNAL] Pool externo: %zu hilos, inner: %d, chunk: %zu MB\n",
          outer, (cfg.inner_workers>0?cfg.inner_workers:hw_threads()), cfg.chunk_bytes/(1024*1024));
 
-    Task* tasks = calloc(fl.count, sizeof(Task));
-    for (size_t i = 0; i < fl.count; i++) {
-        tasks[i].in  = fl.in[i];
-        tasks[i].out = fl.out[i];
-        tasks[i].cfg = &cfg;
-        tp_submit(tp, task_run, &tasks[i]);
+    struct timespec w0, w1;
+    clock_gettime(CLOCK_MONOTONIC, &w0);
+    if (cfg.progress || cfg.progress_fd >= 0)
+        progress_start(cfg.progress, cfg.progress_fd);
+
+    TaskList tl;
+    tl_init(&tl, &cfg, tp);
+
+    /* El listado corre en el mismo pool (prioridad 0, detrás de los
+     * archivos ya encolados), así no suma hilos a la cuota de CPU; los
+     * archivos entran al pool apenas se ven */
+    WalkOptions wo = {
+        .in_root  = cfg.in_path,
+        .out_root = cfg.out_path,
+        .pool     = tp,
+        .on_file  = on_file_found,
+        .ctx      = &tl
+    };
+    size_t n_dirs = 0, n_files = 0;
+    int walk_rc = walk_tree(&wo, &n_dirs, &n_files);   /* 1 = faltan entradas (ya avisadas) */
+    if (walk_rc < 0) {
+        fprintf(stderr, "No se pudo recorrer %s\n", cfg.in_path);
+        metrics_watch_pool(NULL);
+        tp_destroy(tp);
+        tl_free(&tl);
+        return 1;
     }
+    tl_flush_batch(&tl);
+    progress_total_known();
+    JLOG(&cfg.journal, "[JOURNAL] Recorrido: %zu carpetas, %zu archivos, %zu lotes\n",
+         n_dirs, n_files, tl.n_batches);
+
     tp_wait(tp);
+    metrics_watch_pool(NULL);
     tp_destroy(tp);
+    progress_stop();
+
+    clock_gettime(CLOCK_MONOTONIC, &w1);
+    double makespan = (w1.tv_sec - w0.tv_sec) * 1000.0 +
+                      (w1.tv_nsec - w0.tv_nsec) / 1e6;
+
+    /* Cota inferior ideal: max(trabajo total / hilos, tarea más larga) */
+    double work = 0, longest = 0;
+    for (size_t i = 0; i < tl.count; i++) {
+        work += tl.items[i]->ms;
+        if (tl.items[i]->ms > longest) longest = tl.items[i]->ms;
+    }
+    double ideal = work / (double)outer;
+    if (longest > ideal) ideal = longest;
+    JLOG(&cfg.journal, "[JOURNAL] Makespan: %.3f ms, ideal: %.3f ms (%.1f%% del ideal)\n",
+         makespan, ideal, makespan > 0 ? ideal / makespan * 100.0 : 100.0);
+    log_mem_budget(&cfg);
+    log_buf_pool(&cfg);
+    bufpool_trim();
+    codec_scratch_trim();
 
     /* Resultados */
     printf("\nArchivo    | Orig          | Final         | Ahorro(%%) | Tiempo(ms)\n");
     printf("----------------------------------------------------------------------\n");
 
-    size_t total_o = 0, total_f = 0;
+    size_t total_o = 0, total_f = 0, n_failed = 0;
     double total_t = 0;
 
-    for (size_t i = 0; i < fl.count; i++) {
-        Task* t = &tasks[i];
+    for (size_t i = 0; i < tl.count; i++) {
+        Task* t = tl.items[i];
+        if (t->rc != 0) n_failed++;
 
         char oh[32], fh[32];
         human_readable(t->orig, oh, sizeof(oh));
@@ -1040,110 +1472,22 @@ int main(int argc, char* argv[])
            total_o, total_f,
            (total_o ? (1.0 - (double)total_f / total_o) * 100.0 : 0.0),
            total_t);
+    if (walk_rc > 0)
+        printf("ATENCIÓN: parte de %s no se pudo recorrer (ver stderr)\n", cfg.in_path);
+    if (n_failed)
+        printf("ATENCIÓN: %zu archivo(s) fallaron (ver stderr)\n", n_failed);
 
-    fl_free(&fl);
-    free(tasks);
+    tl_free(&tl);
 
-    return 0;
+    return (walk_rc > 0 || n_failed) ? 1 : 0;
 }
 
 /* ---------- Helpers para cantidad de hilos ---------- */
 static int hw_threads(void) {
-    /* Obtiene núcleos lógicos disponibles (con límites) */
-    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    /* Núcleos realmente usables: GSEA_THREADS, afinidad y cuota de cgroup.
+     * Se re-evalúa periódicamente (ver cpu_count.h). */
+    int n = cpu_count_available();
     if (n <= 0) return 4;
     if (n > 128) n = 128;
-    return (int)n;
-}
-
-/* ========== Paralelismo interno por chunks ========== */
-typedef struct {
-    const Config* cfg;
-    const uint8_t* in;
-    size_t len;
-    size_t chunk_id;
-    uint8_t* out;
-    size_t out_len;
-    int err;
-} ChunkTask;
-
-static void compress_chunk_worker(void* arg) {
-    /* Comprime 1 chunk (posible predictor) y guarda resultado */
-    ChunkTask* ct = (ChunkTask*)arg;
-    const uint8_t* p = ct->in; size_t n = ct->len;
-    uint8_t* bout = NULL; size_t blen = 0; int rc = 0;
-
-    switch (ct->cfg->comp_alg) {
-        case COMP_RLEVAR:   rc = rle_var_compress(p, n, &bout, &blen); break;
-        case COMP_LZW:      rc = lzw_compress(p, n, &bout, &blen); break;
-        case COMP_LZWPRED: {
-            uint8_t* tmp = malloc(n); if (!tmp){ ct->err=-1; return; }
-            memcpy(tmp, p, n); apply_predictor_sub(tmp, 1, 1, 1);
-            rc = lzw_compress(tmp, n, &bout, &blen); free(tmp); break;
-        }
-        case COMP_HUFFMANPRED: {
-            uint8_t* tmp = malloc(n); if (!tmp){ ct->err=-1; return; }
-            memcpy(tmp, p, n); apply_predictor_sub(tmp, 1, 1, 1);
-            rc = hp_compress_buffer(tmp, n, &bout, &blen); free(tmp); break;
-        }
-        default: rc = -1;
-    }
-    ct->err = rc; ct->out = bout; ct->out_len = blen;
-}
-
-static int compress_chunked_parallel(const Config* cfg,
-                                     const uint8_t* in, size_t in_len,
-                                     uint8_t** out, size_t* out_len)
-{
-    /* Divide archivo en chunks y los procesa con hilos internos, luego concatena */
-    const size_t CH = cfg->chunk_bytes;
-    size_t n_chunks = (in_len + CH - 1) / CH;
-
-    int wanted = (cfg->inner_workers > 1) ? cfg->inner_workers : hw_threads();
-    if (wanted > (int)n_chunks) wanted = (int)n_chunks;
-    if (wanted < 1) wanted = 1;
-
-    JLOG(&cfg->journal, "[JOURNAL] Paralelo: %zu chunks con %d hilos\n", n_chunks, wanted);
-
-    ThreadPool* tp = tp_create((size_t)wanted);
-    if (!tp) return -1;
-
-    ChunkTask* tasks = (ChunkTask*)calloc(n_chunks, sizeof(ChunkTask));
-    if (!tasks) { tp_destroy(tp); return -1; }
-
-    for (size_t i = 0; i < n_chunks; i++) {
-        size_t off = i * CH;
-        size_t sz  = (off + CH > in_len) ? (in_len - off) : CH;
-        tasks[i].cfg = cfg;
-        tasks[i].in  = in + off;
-        tasks[i].len = sz;
-        tasks[i].chunk_id = i;
-        tp_submit(tp, compress_chunk_worker, &tasks[i]);
-    }
-
-    tp_wait(tp);
-    tp_destroy(tp);
-
-    size_t total = 0;
-    for (size_t i = 0; i < n_chunks; i++) {
-        if (tasks[i].err) {
-            for (size_t j = 0; j < n_chunks; j++) free(tasks[j].out);
-            free(tasks); return -1;
-        }
-        total += tasks[i].out_len;
-    }
-
-    uint8_t* buf = (uint8_t*)malloc(total ? total : 1);
-    if (!buf) { for (size_t j = 0; j < n_chunks; j++) free(tasks[j].out); free(tasks); return -1; }
-
-    size_t k = 0;
-    for (size_t i = 0; i < n_chunks; i++) {
-        memcpy(buf + k, tasks[i].out, tasks[i].out_len);
-        k += tasks[i].out_len;
-        free(tasks[i].out);
-    }
-    free(tasks);
-
-    *out = buf; *out_len = total;
-    return 0;
+    return n;
 }
@@ -0,0 +1,121 @@
+/* =============================================================
+ * membudget.c - Presupuesto global de memoria en vuelo
+ * -------------------------------------------------------------
+ * Con --workers 32 y chunks de 100 MB, 32 archivos grandes a la vez
+ * pueden pedir entrada + salida + temporales cada uno sin que nada
+ * limite el total. --mem-budget fija un tope de bytes reservados a la
+ * vez (un semáforo contado en bytes, mutex + condición):
+ *   - Archivo (pool externo): antes de leer reserva una estimación de
+ *     entrada + salida y la devuelve después de escribir. Espera
+ *     mientras no quepa y haya algo en vuelo; una reserva más grande
+ *     que todo el presupuesto corre sola en vez de bloquearse siempre.
+ *   - Chunk (pool interno): reserva sus temporales (lectura con pread,
+ *     copia del predictor, salida parcial). Solo espera mientras haya
+ *     otros chunks corriendo: esos no esperan a nadie y terminan, así
+ *     que un archivo admitido nunca queda trabado por uno que espera
+ *     su turno (sin interbloqueo entre los dos pools).
+ * El tope es sobre lo reservado, no sobre el RSS: la caché por hilo de
+ * los codecs y el heap de glibc quedan fuera.
+ * ============================================================= */
+#include "membudget.h"
+#include <ctype.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+static uint64_t g_limit;                 /* 0 = sin presupuesto */
+static uint64_t g_in_use, g_chunk_in_use;
+static MemBudgetStats g_st;
+static pthread_mutex_t g_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_cv = PTHREAD_COND_INITIALIZER;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void membudget_set(uint64_t bytes) {
+    g_limit = bytes;
+    g_st.limit = bytes;
+}
+
+int membudget_on(void) {
+    return g_limit != 0;
+}
+
+/* Espera (con g_mtx tomado) mientras no quepa n y *blocker > 0. */
+static uint64_t wait_fit(uint64_t n, const uint64_t* blocker) {
+    uint64_t waited = 0;
+    if (g_in_use + n > g_limit && *blocker > 0) {
+        uint64_t t0 = now_ns();
+        while (g_in_use + n > g_limit && *blocker > 0)
+            pthread_cond_wait(&g_cv, &g_mtx);
+        waited = now_ns() - t0;
+        g_st.waits++;
+        g_st.wait_ns += waited;
+    }
+    if (n > g_limit) g_st.oversize++;
+    g_in_use += n;
+    if (g_in_use > g_st.peak) g_st.peak = g_in_use;
+    return waited;
+}
+
+uint64_t membudget_acquire(uint64_t n) {
+    if (!g_limit || n == 0) return 0;
+    pthread_mutex_lock(&g_mtx);
+    uint64_t w = wait_fit(n, &g_in_use);
+    pthread_mutex_unlock(&g_mtx);
+    return w;
+}
+
+uint64_t membudget_acquire_chunk(uint64_t n) {
+    if (!g_limit || n == 0) return 0;
+    pthread_mutex_lock(&g_mtx);
+    uint64_t w = wait_fit(n, &g_chunk_in_use);
+    g_chunk_in_use += n;
+    pthread_mutex_unlock(&g_mtx);
+    return w;
+}
+
+void membudget_release(uint64_t n) {
+    if (!g_limit || n == 0) return;
+    pthread_mutex_lock(&g_mtx);
+    g_in_use -= (n < g_in_use) ? n : g_in_use;
+    pthread_cond_broadcast(&g_cv);
+    pthread_mutex_unlock(&g_mtx);
+}
+
+void membudget_release_chunk(uint64_t n) {
+    if (!g_limit || n == 0) return;
+    pthread_mutex_lock(&g_mtx);
+    g_chunk_in_use -= (n < g_chunk_in_use) ? n : g_chunk_in_use;
+    g_in_use -= (n < g_in_use) ? n : g_in_use;
+    pthread_cond_broadcast(&g_cv);
+    pthread_mutex_unlock(&g_mtx);
+}
+
+void membudget_stats(MemBudgetStats* st) {
+    pthread_mutex_lock(&g_mtx);
+    *st = g_st;
+    pthread_mutex_unlock(&g_mtx);
+}
+
+int membudget_parse(const char* s, uint64_t* out) {
+    char* end = NULL;
+    if (!s || !isdigit((unsigned char)*s)) return -1;
+    unsigned long long v = strtoull(s, &end, 10);
+    unsigned shift = 0;
+    switch (toupper((unsigned char)*end)) {
+        case '\0': break;
+        case 'K': shift = 10; end++; break;
+        case 'M': shift = 20; end++; break;
+        case 'G': shift = 30; end++; break;
+        case 'T': shift = 40; end++; break;
+        default: return -1;
+    }
+    if (*end == 'B' || *end == 'b') end++;   /* "8GB" también vale */
+    if (*end != '\0' || (shift && v > (UINT64_MAX >> shift))) return -1;
+    *out = (uint64_t)v << shift;
+    return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef MEMBUDGET_H
+#define MEMBUDGET_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Presupuesto global de memoria en vuelo (--mem-budget). Las tareas de
+ * archivo y de chunk reservan sus bytes antes de pedir los buffers y los
+ * devuelven después de escribir; si no caben, esperan (ver membudget.c).
+ * Sin presupuesto (0) todas las llamadas son no-op. */
+
+/* Fija el presupuesto en bytes (0 = sin límite). Llamar antes de lanzar
+ * hilos. */
+void membudget_set(uint64_t bytes);
+
+/* 1 si hay presupuesto activo. */
+int membudget_on(void);
+
+/* Reserva de una tarea de archivo. Espera hasta que quepa; si 'n' supera
+ * el presupuesto entero, espera a que no haya nada en vuelo y corre sola.
+ * Devuelve los ns que esperó. */
+uint64_t membudget_acquire(uint64_t n);
+void membudget_release(uint64_t n);
+
+/* Reserva de un chunk dentro de un archivo que ya tiene la suya. Solo
+ * espera a que terminen otros chunks, nunca a otros archivos, así un
+ * archivo admitido siempre avanza. Devuelve los ns que esperó. */
+uint64_t membudget_acquire_chunk(uint64_t n);
+void membudget_release_chunk(uint64_t n);
+
+typedef struct {
+    uint64_t limit;
+    uint64_t peak;        /* máximo de bytes reservados a la vez */
+    uint64_t waits;       /* reservas que tuvieron que esperar */
+    uint64_t wait_ns;     /* tiempo total de espera */
+    uint64_t oversize;    /* reservas mayores que el presupuesto (corrieron solas) */
+} MemBudgetStats;
+
+void membudget_stats(MemBudgetStats* st);
+
+/* "8G", "512M", "100k", "123456": sufijos K/M/G/T binarios (1024).
+ * 0 = ok, -1 = texto inválido. */
+int membudget_parse(const char* s, uint64_t* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MEMBUDGET_H */
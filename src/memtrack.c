@@ -0,0 +1,287 @@
+/* =============================================================
+ * memtrack.c - Contabilidad del heap por proceso, hilo y etapa
+ * -------------------------------------------------------------
+ * Solo se compila con "make MEMTRACK=1". El Makefile enlaza con
+ * -Wl,--wrap=malloc,... : las llamadas de NUESTROS objetos a malloc,
+ * calloc, realloc, free, strdup, strndup y posix_memalign (bigbuf.c)
+ * llegan a __wrap_*, que llaman a la versión real (__real_*) y anotan
+ * el tamaño. Todo lo que pasa por free tiene que estar envuelto al
+ * reservar, o "vivos al salir" queda negativo.
+ * Notas:
+ *   - El tamaño se toma con malloc_usable_size() tanto al reservar como
+ *     al liberar, así cuadra aunque el bloque lo haya reservado una
+ *     biblioteca (OpenSSL, libpng) y lo libere nuestro código.
+ *   - Un buffer reservado en un worker y liberado en el hilo principal
+ *     suma al primero y resta al segundo: el pico por hilo es neto.
+ *   - Etapas: cada hilo guarda una pila corta de etapas abiertas
+ *     (journal_stage_begin) y cada reserva actualiza todas; al cerrarse
+ *     la etapa (journal_stage) se acumula en la tabla por nombre.
+ * El reporte se imprime en stderr al salir.
+ * ============================================================= */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "memtrack.h"
+#include "journal.h"
+#include <malloc.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+void* __real_malloc(size_t n);
+void* __real_calloc(size_t n, size_t sz);
+void* __real_realloc(void* p, size_t n);
+void  __real_free(void* p);
+char* __real_strdup(const char* s);
+char* __real_strndup(const char* s, size_t n);
+int   __real_posix_memalign(void** p, size_t align, size_t n);
+
+#define MT_DEPTH 8            /* etapas anidadas por hilo */
+#define MT_TOP   8            /* hilos terminados que se reportan */
+
+static const char* const k_stages[] = {
+    "read", "wav_decode", "predictor", "compress", "encrypt",
+    "decrypt", "decompress", "unpredict", "wav_encode", "write",
+    "file",                   /* process_one_file completo */
+    "other"
+};
+#define N_STAGES (sizeof(k_stages) / sizeof(k_stages[0]))
+
+typedef struct {
+    uint64_t t0;
+    int64_t base;             /* bytes vivos del hilo al abrir */
+    int64_t peak;
+    uint64_t allocs, bytes;
+} MtFrame;
+
+typedef struct {
+    unsigned tid;
+    int64_t live, peak;
+    uint64_t allocs, bytes;
+    MtFrame f[MT_DEPTH];
+    int depth;
+    int registered;
+} MtThread;
+
+typedef struct {
+    atomic_ullong calls, allocs, bytes;
+    atomic_llong peak_delta;  /* máximo entre llamadas */
+} MtStage;
+
+static _Thread_local MtThread t_mt;   /* TLS estático: no reserva memoria */
+
+static atomic_llong g_live, g_peak;
+static atomic_llong g_win_peak;       /* pico desde memtrack_reset_peak */
+static atomic_ullong g_allocs, g_bytes;
+static MtStage g_stage[N_STAGES];
+
+static pthread_mutex_t g_top_mtx = PTHREAD_MUTEX_INITIALIZER;
+static MtThread g_top[MT_TOP];        /* hilos terminados con mayor pico */
+static size_t g_n_top;
+static unsigned long g_threads_done;
+
+static pthread_key_t g_key;
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+
+static void max_store(atomic_llong* m, int64_t v) {
+    int64_t cur = atomic_load_explicit(m, memory_order_relaxed);
+    while (v > cur && !atomic_compare_exchange_weak_explicit(m, &cur, v,
+                                                             memory_order_relaxed, memory_order_relaxed)) {}
+}
+
+/* Hilo terminado: entra a la tabla si su pico está entre los mayores */
+static void thread_done(void* p) {
+    MtThread* t = p;
+    pthread_mutex_lock(&g_top_mtx);
+    g_threads_done++;
+    size_t slot = g_n_top;
+    if (g_n_top < MT_TOP) {
+        g_n_top++;
+    } else {
+        slot = 0;
+        for (size_t i = 1; i < MT_TOP; i++)
+            if (g_top[i].peak < g_top[slot].peak) slot = i;
+        if (g_top[slot].peak >= t->peak) slot = MT_TOP;
+    }
+    if (slot < MT_TOP) g_top[slot] = *t;
+    pthread_mutex_unlock(&g_top_mtx);
+}
+
+static void report_at_exit(void) {
+    memtrack_report(stderr);
+}
+
+static void init_once(void) {
+    pthread_key_create(&g_key, thread_done);
+    atexit(report_at_exit);
+}
+
+static MtThread* self(void) {
+    MtThread* t = &t_mt;
+    if (!t->registered) {
+        t->registered = 1;
+        t->tid = journal_thread_id();
+        pthread_once(&g_once, init_once);
+        pthread_setspecific(g_key, t);
+    }
+    return t;
+}
+
+static void on_alloc(void* p) {
+    if (!p) return;
+    int64_t n = (int64_t)malloc_usable_size(p);
+    int64_t live = atomic_fetch_add_explicit(&g_live, n, memory_order_relaxed) + n;
+    max_store(&g_peak, live);
+    max_store(&g_win_peak, live);
+    atomic_fetch_add_explicit(&g_allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_bytes, (uint64_t)n, memory_order_relaxed);
+
+    MtThread* t = self();
+    t->live += n;
+    if (t->live > t->peak) t->peak = t->live;
+    t->allocs++;
+    t->bytes += (uint64_t)n;
+    for (int i = 0; i < t->depth; i++) {
+        MtFrame* f = &t->f[i];
+        f->allocs++;
+        f->bytes += (uint64_t)n;
+        if (t->live > f->peak) f->peak = t->live;
+    }
+}
+
+static void on_free(int64_t n) {
+    atomic_fetch_sub_explicit(&g_live, n, memory_order_relaxed);
+    self()->live -= n;
+}
+
+void* __wrap_malloc(size_t n) {
+    void* p = __real_malloc(n);
+    on_alloc(p);
+    return p;
+}
+
+void* __wrap_calloc(size_t n, size_t sz) {
+    void* p = __real_calloc(n, sz);
+    on_alloc(p);
+    return p;
+}
+
+void* __wrap_realloc(void* p, size_t n) {
+    int64_t old = p ? (int64_t)malloc_usable_size(p) : 0;
+    void* q = __real_realloc(p, n);
+    if (q) {
+        if (p) on_free(old);
+        on_alloc(q);
+    } else if (p && n == 0) {
+        on_free(old);           /* realloc(p, 0) liberó p */
+    }
+    return q;
+}
+
+void __wrap_free(void* p) {
+    if (!p) return;
+    on_free((int64_t)malloc_usable_size(p));
+    __real_free(p);
+}
+
+char* __wrap_strdup(const char* s) {
+    char* p = __real_strdup(s);
+    on_alloc(p);
+    return p;
+}
+
+char* __wrap_strndup(const char* s, size_t n) {
+    char* p = __real_strndup(s, n);
+    on_alloc(p);
+    return p;
+}
+
+int __wrap_posix_memalign(void** p, size_t align, size_t n) {
+    int rc = __real_posix_memalign(p, align, n);
+    if (rc == 0) on_alloc(*p);
+    return rc;
+}
+
+/* ---------- Etapas ---------- */
+void memtrack_stage_begin(uint64_t t0) {
+    MtThread* t = self();
+    if (t->depth == MT_DEPTH) {       /* etapas huérfanas: se olvida la más vieja */
+        memmove(&t->f[0], &t->f[1], sizeof(MtFrame) * (MT_DEPTH - 1));
+        t->depth--;
+    }
+    MtFrame* f = &t->f[t->depth++];
+    f->t0 = t0;
+    f->base = f->peak = t->live;
+    f->allocs = f->bytes = 0;
+}
+
+int memtrack_stage_end(const char* stage, uint64_t t0, MemStage* out) {
+    MtThread* t = self();
+    int i = t->depth - 1;
+    while (i >= 0 && t->f[i].t0 != t0) i--;
+    if (i < 0) return -1;
+    MtFrame f = t->f[i];
+    t->depth = i;                     /* descarta también las internas sin cerrar */
+
+    size_t s = N_STAGES - 1;
+    for (size_t k = 0; k + 1 < N_STAGES; k++)
+        if (strcmp(stage, k_stages[k]) == 0) { s = k; break; }
+    MtStage* st = &g_stage[s];
+    atomic_fetch_add_explicit(&st->calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&st->allocs, f.allocs, memory_order_relaxed);
+    atomic_fetch_add_explicit(&st->bytes, f.bytes, memory_order_relaxed);
+    max_store(&st->peak_delta, f.peak - f.base);
+
+    if (out) {
+        out->allocs = f.allocs;
+        out->bytes = f.bytes;
+        out->peak_delta = f.peak - f.base;
+    }
+    return 0;
+}
+
+/* ---------- Totales y reporte ---------- */
+void memtrack_get(MemTotals* t) {
+    t->live = atomic_load(&g_live);
+    t->peak = atomic_load(&g_win_peak);
+    t->allocs = atomic_load(&g_allocs);
+    t->bytes = atomic_load(&g_bytes);
+}
+
+void memtrack_reset_peak(void) {
+    atomic_store(&g_win_peak, atomic_load(&g_live));
+}
+
+static double mb(int64_t b) { return (double)b / (1024.0 * 1024.0); }
+
+void memtrack_report(FILE* f) {
+    MemTotals tot;
+    memtrack_get(&tot);
+    fprintf(f, "\nHeap (MEMTRACK): pico %.2f MB, vivos al salir %.2f MB, %llu reservas, %.2f MB reservados\n",
+            mb(atomic_load(&g_peak)), mb(tot.live), (unsigned long long)tot.allocs, mb((int64_t)tot.bytes));
+
+    int header = 0;
+    for (size_t s = 0; s < N_STAGES; s++) {
+        const MtStage* st = &g_stage[s];
+        unsigned long long calls = atomic_load(&st->calls);
+        if (!calls) continue;
+        if (!header++)
+            fprintf(f, "%-11s %8s %10s %12s %14s\n", "etapa", "llamadas", "reservas", "MB reserv.", "pico máx MB");
+        fprintf(f, "%-11s %8llu %10llu %12.2f %13.2f\n", k_stages[s], calls,
+                (unsigned long long)atomic_load(&st->allocs),
+                mb((int64_t)atomic_load(&st->bytes)), mb(atomic_load(&st->peak_delta)));
+    }
+
+    MtThread* me = &t_mt;
+    pthread_mutex_lock(&g_top_mtx);
+    fprintf(f, "%-6s %10s %12s %12s   (%lu hilos terminados, se muestran los de mayor pico)\n",
+            "hilo", "reservas", "MB reserv.", "pico neto MB", g_threads_done);
+    if (me->registered)
+        fprintf(f, "t%-5u %10llu %12.2f %12.2f   (hilo actual)\n", me->tid,
+                (unsigned long long)me->allocs, mb((int64_t)me->bytes), mb(me->peak));
+    for (size_t i = 0; i < g_n_top; i++)
+        fprintf(f, "t%-5u %10llu %12.2f %12.2f\n", g_top[i].tid,
+                (unsigned long long)g_top[i].allocs, mb((int64_t)g_top[i].bytes), mb(g_top[i].peak));
+    pthread_mutex_unlock(&g_top_mtx);
+}
@@ -0,0 +1,65 @@
+#ifndef MEMTRACK_H
+#define MEMTRACK_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Contabilidad de memoria del heap (build de diagnóstico: make MEMTRACK=1).
+ * El enlazador redirige malloc/calloc/realloc/free/strdup/strndup de
+ * nuestros objetos (-Wl,--wrap) a memtrack.c, que lleva:
+ *   - proceso: bytes vivos, pico y número de reservas;
+ *   - hilo: reservas, bytes reservados y pico neto (reservado - liberado
+ *     por ese hilo);
+ *   - etapa: entre journal_stage_begin() y journal_stage() de la misma
+ *     etapa, reservas, bytes y pico de bytes vivos del hilo.
+ * Sin MEMTRACK todo esto compila a nada. */
+
+typedef struct {
+    int64_t live;           /* bytes vivos */
+    int64_t peak;           /* pico de bytes vivos desde memtrack_reset_peak */
+    uint64_t allocs;        /* reservas (malloc/calloc/realloc/strdup) */
+    uint64_t bytes;         /* bytes reservados en total */
+} MemTotals;
+
+/* Lo que hizo una etapa recién cerrada (para la línea JSON del journal). */
+typedef struct {
+    uint64_t allocs;
+    uint64_t bytes;
+    int64_t peak_delta;     /* pico de bytes vivos del hilo sobre el inicio */
+} MemStage;
+
+#ifdef MEMTRACK
+
+/* Abre / cierra una etapa en el hilo actual. t0 identifica la etapa (el
+ * mismo valor que recibe journal_stage); si una etapa nunca se cerró
+ * (error a mitad de camino) se descarta al cerrar una exterior. */
+void memtrack_stage_begin(uint64_t t0);
+int  memtrack_stage_end(const char* stage, uint64_t t0, MemStage* out);
+
+void memtrack_get(MemTotals* t);
+void memtrack_reset_peak(void);     /* reinicia el pico de memtrack_get */
+void memtrack_report(FILE* f);      /* tablas por etapa y por hilo */
+#define memtrack_on() 1
+
+#else
+
+static inline void memtrack_stage_begin(uint64_t t0) { (void)t0; }
+static inline int memtrack_stage_end(const char* stage, uint64_t t0, MemStage* out) {
+    (void)stage; (void)t0; (void)out; return -1;
+}
+static inline void memtrack_get(MemTotals* t) { t->live = t->peak = 0; t->allocs = t->bytes = 0; }
+static inline void memtrack_reset_peak(void) {}
+static inline void memtrack_report(FILE* f) { (void)f; }
+#define memtrack_on() 0
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MEMTRACK_H */
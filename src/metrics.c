@@ -0,0 +1,265 @@
+/* =============================================================
+ * metrics.c - Exportación para el textfile collector de Prometheus
+ * -------------------------------------------------------------
+ * Contadores (atómicos, los actualizan los hilos de trabajo):
+ *   gsea_codec_bytes_{in,out}_total{codec,op}  bytes por codec y operación
+ *   gsea_files_processed_total / gsea_errors_total
+ *   gsea_stage_duration_seconds{stage}         histograma por etapa
+ *                                              (vía hook de journal_stage)
+ * Al escribir se leen además:
+ *   gsea_pool_*        tareas, segundos ocupado / ocioso / esperando el
+ *                      mutex, hilos y cola actual / pico
+ *   gsea_peak_rss_bytes, gsea_run_duration_seconds,
+ *   gsea_last_update_timestamp_seconds
+ * Escritura atómica: se escribe "<path>.tmp" y se renombra, así
+ * node_exporter nunca lee un archivo a medias. Un hilo reescribe cada
+ * 'interval_s' segundos y atexit hace la escritura final.
+ * ============================================================= */
+#include "metrics.h"
+#include "journal.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#define N_CODECS (COMP_DELTA16_HUFF + 1)
+
+static const char* const k_stages[] = {
+    "read", "wav_decode", "predictor", "compress", "encrypt",
+    "decrypt", "decompress", "unpredict", "wav_encode", "write", "other"
+};
+#define N_STAGES (sizeof(k_stages) / sizeof(k_stages[0]))
+
+/* Límites superiores (segundos) de los buckets; +Inf va aparte */
+static const double k_bounds[] = { 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5, 30 };
+#define N_BOUNDS (sizeof(k_bounds) / sizeof(k_bounds[0]))
+
+typedef struct {
+    atomic_ullong bucket[N_BOUNDS + 1];   /* no acumulados; el último es +Inf */
+    atomic_ullong count;
+    atomic_ullong sum_ns;
+} Histogram;
+
+static atomic_int g_on;
+static char* g_path;
+static uint64_t g_start_ns;
+static atomic_ullong g_bytes_in[N_CODECS][2];
+static atomic_ullong g_bytes_out[N_CODECS][2];
+static atomic_ullong g_files, g_errors;
+static Histogram g_stage[N_STAGES];
+static ThreadPool* g_pool;              /* protegido por g_wmtx */
+
+static pthread_mutex_t g_wmtx = PTHREAD_MUTEX_INITIALIZER;  /* una escritura a la vez */
+static pthread_mutex_t g_tmtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_tcv = PTHREAD_COND_INITIALIZER;
+static pthread_t g_thread;
+static int g_has_thread, g_stop;
+static unsigned g_interval;
+
+int metrics_on(void) {
+    return atomic_load_explicit(&g_on, memory_order_relaxed);
+}
+
+void metrics_add_bytes(CompAlg alg, int compress, uint64_t in, uint64_t out) {
+    if (!metrics_on() || (int)alg < 0 || alg >= N_CODECS) return;
+    atomic_fetch_add(&g_bytes_in[alg][compress ? 1 : 0], in);
+    atomic_fetch_add(&g_bytes_out[alg][compress ? 1 : 0], out);
+}
+
+void metrics_file_done(int ok) {
+    if (!metrics_on()) return;
+    atomic_fetch_add(&g_files, 1);
+    if (!ok) atomic_fetch_add(&g_errors, 1);
+}
+
+/* Toma el mutex de escritura: al volver, ninguna escritura en curso
+ * sigue usando el pool anterior y se puede destruir. */
+void metrics_watch_pool(ThreadPool* tp) {
+    pthread_mutex_lock(&g_wmtx);
+    g_pool = tp;
+    pthread_mutex_unlock(&g_wmtx);
+}
+
+/* Hook de journal_stage */
+static void on_stage(const char* stage, uint64_t ns) {
+    size_t s = N_STAGES - 1;
+    for (size_t i = 0; i + 1 < N_STAGES; i++)
+        if (strcmp(stage, k_stages[i]) == 0) { s = i; break; }
+    Histogram* h = &g_stage[s];
+    double sec = (double)ns / 1e9;
+    size_t b = 0;
+    while (b < N_BOUNDS && sec > k_bounds[b]) b++;
+    atomic_fetch_add(&h->bucket[b], 1);
+    atomic_fetch_add(&h->count, 1);
+    atomic_fetch_add(&h->sum_ns, ns);
+}
+
+static long peak_rss_kb(void) {
+    struct rusage ru;
+    return getrusage(RUSAGE_SELF, &ru) == 0 ? ru.ru_maxrss : 0;
+}
+
+static void write_all(FILE* f) {
+    fprintf(f, "# HELP gsea_codec_bytes_in_total Bytes que entraron a cada codec.\n"
+               "# TYPE gsea_codec_bytes_in_total counter\n");
+    for (int a = 0; a < N_CODECS; a++)
+        for (int op = 0; op < 2; op++)
+            fprintf(f, "gsea_codec_bytes_in_total{codec=\"%s\",op=\"%s\"} %llu\n",
+                    codec_name((CompAlg)a), op ? "compress" : "decompress",
+                    atomic_load(&g_bytes_in[a][op]));
+    fprintf(f, "# HELP gsea_codec_bytes_out_total Bytes que salieron de cada codec.\n"
+               "# TYPE gsea_codec_bytes_out_total counter\n");
+    for (int a = 0; a < N_CODECS; a++)
+        for (int op = 0; op < 2; op++)
+            fprintf(f, "gsea_codec_bytes_out_total{codec=\"%s\",op=\"%s\"} %llu\n",
+                    codec_name((CompAlg)a), op ? "compress" : "decompress",
+                    atomic_load(&g_bytes_out[a][op]));
+
+    fprintf(f, "# HELP gsea_files_processed_total Archivos procesados (con o sin error).\n"
+               "# TYPE gsea_files_processed_total counter\n"
+               "gsea_files_processed_total %llu\n", atomic_load(&g_files));
+    fprintf(f, "# HELP gsea_errors_total Archivos que fallaron.\n"
+               "# TYPE gsea_errors_total counter\n"
+               "gsea_errors_total %llu\n", atomic_load(&g_errors));
+
+    fprintf(f, "# HELP gsea_stage_duration_seconds Duración de cada etapa del pipeline.\n"
+               "# TYPE gsea_stage_duration_seconds histogram\n");
+    for (size_t s = 0; s < N_STAGES; s++) {
+        const Histogram* h = &g_stage[s];
+        unsigned long long cum = 0;
+        for (size_t b = 0; b < N_BOUNDS; b++) {
+            cum += atomic_load(&h->bucket[b]);
+            fprintf(f, "gsea_stage_duration_seconds_bucket{stage=\"%s\",le=\"%g\"} %llu\n",
+                    k_stages[s], k_bounds[b], cum);
+        }
+        cum += atomic_load(&h->bucket[N_BOUNDS]);
+        fprintf(f, "gsea_stage_duration_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n", k_stages[s], cum);
+        fprintf(f, "gsea_stage_duration_seconds_sum{stage=\"%s\"} %.9f\n",
+                k_stages[s], (double)atomic_load(&h->sum_ns) / 1e9);
+        fprintf(f, "gsea_stage_duration_seconds_count{stage=\"%s\"} %llu\n",
+                k_stages[s], atomic_load(&h->count));
+    }
+
+    /* Pools: destruidos (total del proceso) + el externo si sigue vivo */
+    ThreadPoolStats st, live = {0};
+    tp_get_stats(NULL, &st);
+    ThreadPool* tp = g_pool;
+    size_t depth = 0, threads = 0;
+    if (tp) {
+        tp_get_stats(tp, &live);
+        depth = tp_queue_depth(tp);
+        threads = tp_thread_count(tp);
+    }
+    fprintf(f, "# HELP gsea_pool_tasks_total Tareas ejecutadas por los pools.\n"
+               "# TYPE gsea_pool_tasks_total counter\n"
+               "gsea_pool_tasks_total %llu\n", st.tasks + live.tasks);
+    fprintf(f, "# HELP gsea_pool_busy_seconds_total Tiempo de hilo dentro de tareas.\n"
+               "# TYPE gsea_pool_busy_seconds_total counter\n"
+               "gsea_pool_busy_seconds_total %.6f\n", (double)(st.task_ns + live.task_ns) / 1e9);
+    fprintf(f, "# HELP gsea_pool_idle_seconds_total Tiempo de hilo esperando trabajo.\n"
+               "# TYPE gsea_pool_idle_seconds_total counter\n"
+               "gsea_pool_idle_seconds_total %.6f\n", (double)(st.idle_ns + live.idle_ns) / 1e9);
+    fprintf(f, "# HELP gsea_pool_lock_wait_seconds_total Tiempo de hilo esperando el mutex de la cola.\n"
+               "# TYPE gsea_pool_lock_wait_seconds_total counter\n"
+               "gsea_pool_lock_wait_seconds_total %.6f\n",
+               (double)(st.lock_wait_ns + live.lock_wait_ns) / 1e9);
+    fprintf(f, "# HELP gsea_pool_threads Hilos del pool externo.\n"
+               "# TYPE gsea_pool_threads gauge\n"
+               "gsea_pool_threads %zu\n", threads);
+    fprintf(f, "# HELP gsea_pool_queue_depth Tareas en cola del pool externo.\n"
+               "# TYPE gsea_pool_queue_depth gauge\n"
+               "gsea_pool_queue_depth %zu\n", depth);
+    fprintf(f, "# HELP gsea_pool_queue_depth_peak Mayor largo de cola visto en cualquier pool.\n"
+               "# TYPE gsea_pool_queue_depth_peak gauge\n"
+               "gsea_pool_queue_depth_peak %llu\n",
+               st.queue_peak > live.queue_peak ? st.queue_peak : live.queue_peak);
+
+    fprintf(f, "# HELP gsea_peak_rss_bytes RSS máximo del proceso.\n"
+               "# TYPE gsea_peak_rss_bytes gauge\n"
+               "gsea_peak_rss_bytes %lld\n", (long long)peak_rss_kb() * 1024);
+    fprintf(f, "# HELP gsea_run_duration_seconds Tiempo desde el inicio de la corrida.\n"
+               "# TYPE gsea_run_duration_seconds gauge\n"
+               "gsea_run_duration_seconds %.3f\n", (double)(journal_now_ns() - g_start_ns) / 1e9);
+    fprintf(f, "# HELP gsea_last_update_timestamp_seconds Hora de esta escritura.\n"
+               "# TYPE gsea_last_update_timestamp_seconds gauge\n"
+               "gsea_last_update_timestamp_seconds %lld\n", (long long)time(NULL));
+}
+
+int metrics_write(void) {
+    if (!metrics_on()) return -1;
+    pthread_mutex_lock(&g_wmtx);
+    size_t n = strlen(g_path) + 5;
+    char* tmp = malloc(n);
+    int rc = -1;
+    if (tmp) {
+        snprintf(tmp, n, "%s.tmp", g_path);
+        FILE* f = fopen(tmp, "w");
+        if (f) {
+            write_all(f);
+            int bad = ferror(f);
+            if (fclose(f) == 0 && !bad && rename(tmp, g_path) == 0) rc = 0;
+            else remove(tmp);
+        }
+        free(tmp);
+    }
+    pthread_mutex_unlock(&g_wmtx);
+    return rc;
+}
+
+static void* writer_main(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_tmtx);
+    while (!g_stop) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += g_interval;
+        pthread_cond_timedwait(&g_tcv, &g_tmtx, &ts);
+        if (g_stop) break;
+        pthread_mutex_unlock(&g_tmtx);
+        metrics_write();
+        pthread_mutex_lock(&g_tmtx);
+    }
+    pthread_mutex_unlock(&g_tmtx);
+    return NULL;
+}
+
+/* Escritura final (atexit): detiene el hilo periódico y reescribe. */
+static void metrics_close(void) {
+    if (!metrics_on()) return;
+    if (g_has_thread) {
+        pthread_mutex_lock(&g_tmtx);
+        g_stop = 1;
+        pthread_cond_signal(&g_tcv);
+        pthread_mutex_unlock(&g_tmtx);
+        pthread_join(g_thread, NULL);
+        g_has_thread = 0;
+    }
+    metrics_watch_pool(NULL);
+    if (metrics_write() != 0)
+        fprintf(stderr, "No se pudieron escribir las métricas en %s\n", g_path);
+    journal_set_stage_hook(NULL);
+    atomic_store(&g_on, 0);
+}
+
+int metrics_open(const char* path, unsigned interval_s) {
+    if (!path || metrics_on()) return -1;
+    g_path = strdup(path);
+    if (!g_path) return -1;
+    g_start_ns = journal_now_ns();
+    atomic_store(&g_on, 1);
+    if (metrics_write() != 0) {     /* falla temprano si no se puede escribir */
+        atomic_store(&g_on, 0);
+        free(g_path);
+        g_path = NULL;
+        return -1;
+    }
+    journal_set_stage_hook(on_stage);
+    g_interval = interval_s;
+    if (interval_s > 0 && pthread_create(&g_thread, NULL, writer_main, NULL) == 0)
+        g_has_thread = 1;
+    atexit(metrics_close);
+    return 0;
+}
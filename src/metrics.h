@@ -0,0 +1,42 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "codec.h"
+#include "thread_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Métricas en formato de texto Prometheus/OpenMetrics para el textfile
+ * collector de node_exporter (--metrics-file). El archivo se reescribe
+ * de forma atómica (temporal + rename) cada 'interval_s' segundos
+ * durante la corrida (0 = solo al final) y una última vez al salir. */
+
+/* Activa las métricas hacia 'path'. 0 = ok, -1 = error. */
+int metrics_open(const char* path, unsigned interval_s);
+
+/* 1 si hay métricas activas (los demás llamados son no-op si no). */
+int metrics_on(void);
+
+/* Bytes que entraron/salieron de un codec. compress = 1 compresión,
+ * 0 descompresión. */
+void metrics_add_bytes(CompAlg alg, int compress, uint64_t in, uint64_t out);
+
+/* Un archivo terminó (ok = 0 si falló). */
+void metrics_file_done(int ok);
+
+/* Pool externo vivo cuyos contadores se exportan (NULL = ninguno). Los
+ * pools ya destruidos se toman del total de tp_get_stats(NULL). */
+void metrics_watch_pool(ThreadPool* tp);
+
+/* Reescribe el archivo ahora. 0 = ok. */
+int metrics_write(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* METRICS_H */
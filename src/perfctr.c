@@ -0,0 +1,198 @@
+/* =============================================================
+ * perfctr.c - Contadores de hardware por codec (--perf-counters)
+ * -------------------------------------------------------------
+ * Cada hilo abre un grupo perf_event (líder: ciclos; miembros:
+ * instrucciones, fallos de caché y fallos de saltos) solo para sí
+ * mismo y solo en espacio de usuario, así basta con
+ * perf_event_paranoid <= 2. Antes y después de cada llamada al codec
+ * se lee el grupo completo con un único read() y la diferencia se suma
+ * a la fila (CompAlg, operación).
+ * Degradación:
+ *   - si el líder no abre (sin PMU en la VM, paranoid = 3, seccomp...)
+ *     perfctr_enable() avisa y todo queda en no-op;
+ *   - un miembro que no abre se reporta como "n/d";
+ *   - si el kernel multiplexa el grupo, los valores se escalan por
+ *     tiempo habilitado / tiempo en ejecución.
+ * Los descriptores se cierran al terminar cada hilo (pthread_key).
+ * ============================================================= */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "perfctr.h"
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define N_CODECS (COMP_DELTA16_HUFF + 1)
+
+static const uint64_t k_config[PC_N] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+};
+
+typedef struct {
+    int fd[PC_N];
+    uint64_t id[PC_N];
+} PcThread;
+
+/* Formato de read() con PERF_FORMAT_GROUP | ID | TOTAL_TIME_* */
+typedef struct {
+    uint64_t nr;
+    uint64_t enabled;
+    uint64_t running;
+    struct { uint64_t value, id; } cnt[PC_N];
+} PcRead;
+
+static atomic_int g_on;
+static atomic_int g_have[PC_N];       /* el contador abrió en algún hilo */
+static atomic_ullong g_acc[N_CODECS][2][PC_N];
+static atomic_ullong g_bytes[N_CODECS][2];
+static atomic_ullong g_calls[N_CODECS][2];
+
+static _Thread_local PcThread* t_pc;
+static _Thread_local int t_failed;    /* ya se intentó y no hay contadores */
+static pthread_key_t g_key;
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+
+static int pc_open(uint64_t config, int group) {
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.size = sizeof(a);
+    a.type = PERF_TYPE_HARDWARE;
+    a.config = config;
+    a.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID |
+                    PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    a.exclude_kernel = 1;
+    a.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &a, 0 /* este hilo */, -1, group, PERF_FLAG_FD_CLOEXEC);
+}
+
+static void pc_release(void* p) {
+    PcThread* t = p;
+    for (int i = 0; i < PC_N; i++)
+        if (t->fd[i] >= 0) close(t->fd[i]);
+    free(t);
+}
+
+static void key_init(void) {
+    pthread_key_create(&g_key, pc_release);
+}
+
+/* Grupo del hilo actual; NULL si no hay contadores. */
+static PcThread* pc_thread(void) {
+    if (t_pc) return t_pc;
+    if (t_failed) return NULL;
+    PcThread* t = malloc(sizeof(PcThread));
+    if (!t) { t_failed = 1; return NULL; }
+    for (int i = 0; i < PC_N; i++) {
+        t->fd[i] = pc_open(k_config[i], i == 0 ? -1 : t->fd[0]);
+        t->id[i] = 0;
+        if (t->fd[i] >= 0) {
+            ioctl(t->fd[i], PERF_EVENT_IOC_ID, &t->id[i]);
+            atomic_store(&g_have[i], 1);
+        } else if (i == 0) {
+            free(t);
+            t_failed = 1;
+            return NULL;
+        }
+    }
+    pthread_once(&g_once, key_init);
+    pthread_setspecific(g_key, t);
+    t_pc = t;
+    return t;
+}
+
+static int pc_read(PcThread* t, PerfSample* s) {
+    PcRead r;
+    if (read(t->fd[0], &r, sizeof(r)) < (ssize_t)(3 * sizeof(uint64_t))) return -1;
+    memset(s->v, 0, sizeof(s->v));
+    for (uint64_t k = 0; k < r.nr && k < PC_N; k++)
+        for (int i = 0; i < PC_N; i++)
+            if (t->fd[i] >= 0 && r.cnt[k].id == t->id[i]) s->v[i] = r.cnt[k].value;
+    s->enabled = r.enabled;
+    s->running = r.running;
+    return 0;
+}
+
+int perfctr_on(void) {
+    return atomic_load_explicit(&g_on, memory_order_relaxed);
+}
+
+void perfctr_begin(PerfSample* s) {
+    s->valid = 0;
+    if (!perfctr_on()) return;
+    PcThread* t = pc_thread();
+    if (t && pc_read(t, s) == 0) s->valid = 1;
+}
+
+void perfctr_end(const PerfSample* s, CompAlg alg, int compress, uint64_t bytes) {
+    if (!s->valid || (int)alg < 0 || alg >= N_CODECS) return;
+    PerfSample e;
+    if (!t_pc || pc_read(t_pc, &e) != 0) return;
+    uint64_t en = e.enabled - s->enabled, run = e.running - s->running;
+    int op = compress ? 1 : 0;
+    for (int i = 0; i < PC_N; i++) {
+        uint64_t d = e.v[i] - s->v[i];
+        if (run > 0 && run < en) d = (uint64_t)((double)d * (double)en / (double)run);
+        atomic_fetch_add_explicit(&g_acc[alg][op][i], d, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&g_bytes[alg][op], bytes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_calls[alg][op], 1, memory_order_relaxed);
+}
+
+/* Fallos por KB, o "n/d" si el contador no existe en esta CPU */
+static void per_kb(char* out, size_t cap, int counter, uint64_t v, uint64_t bytes) {
+    if (!atomic_load(&g_have[counter])) snprintf(out, cap, "n/d");
+    else snprintf(out, cap, "%.2f", bytes ? (double)v * 1024.0 / (double)bytes : 0.0);
+}
+
+static void perfctr_report(void) {
+    fprintf(stderr, "\nContadores de hardware por llamada al codec (solo espacio de usuario):\n");
+    fprintf(stderr, "%-13s %-10s %8s %10s %6s %9s %15s %14s\n",  /* é ocupa 2 bytes */
+            "comp", "op", "llamadas", "MB", "IPC", "ciclos/B", "miss caché/KB", "miss salto/KB");
+    for (int a = 0; a < N_CODECS; a++) {
+        for (int op = 1; op >= 0; op--) {
+            uint64_t calls = atomic_load(&g_calls[a][op]);
+            if (calls == 0) continue;
+            uint64_t b = atomic_load(&g_bytes[a][op]);
+            uint64_t cyc = atomic_load(&g_acc[a][op][PC_CYCLES]);
+            uint64_t ins = atomic_load(&g_acc[a][op][PC_INSTR]);
+            char ipc[16], cm[16], bm[16];
+            if (atomic_load(&g_have[PC_INSTR]) && cyc) snprintf(ipc, sizeof(ipc), "%.2f", (double)ins / (double)cyc);
+            else snprintf(ipc, sizeof(ipc), "n/d");
+            per_kb(cm, sizeof(cm), PC_CACHE_MISS, atomic_load(&g_acc[a][op][PC_CACHE_MISS]), b);
+            per_kb(bm, sizeof(bm), PC_BRANCH_MISS, atomic_load(&g_acc[a][op][PC_BRANCH_MISS]), b);
+            fprintf(stderr, "%-13s %-10s %8llu %10.2f %6s %9.2f %14s %14s\n",
+                    codec_name((CompAlg)a), op ? "compress" : "decompress",
+                    (unsigned long long)calls, (double)b / (1024.0 * 1024.0), ipc,
+                    b ? (double)cyc / (double)b : 0.0, cm, bm);
+        }
+    }
+}
+
+int perfctr_enable(void) {
+    if (perfctr_on()) return 0;
+    /* Prueba en el hilo actual: si aquí no abre, tampoco en los workers */
+    if (!pc_thread()) {
+        int err = errno;
+        int paranoid = -1;
+        FILE* f = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+        if (f) {
+            if (fscanf(f, "%d", &paranoid) != 1) paranoid = -1;
+            fclose(f);
+        }
+        fprintf(stderr, "aviso: contadores de hardware no disponibles (%s, perf_event_paranoid=%d); "
+                        "se sigue sin --perf-counters\n", strerror(err), paranoid);
+        return -1;
+    }
+    atomic_store(&g_on, 1);
+    atexit(perfctr_report);
+    return 0;
+}
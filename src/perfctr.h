@@ -0,0 +1,43 @@
+#ifndef PERFCTR_H
+#define PERFCTR_H
+
+#include <stdint.h>
+#include "codec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Contadores de hardware (perf_event_open) alrededor de cada llamada a
+ * un codec (--perf-counters): ciclos, instrucciones, fallos de caché y
+ * fallos de predicción de saltos, acumulados por CompAlg y operación.
+ * Cada hilo abre sus propios contadores la primera vez que mide. Al
+ * salir se imprime IPC, ciclos y fallos por byte en stderr. */
+
+enum { PC_CYCLES, PC_INSTR, PC_CACHE_MISS, PC_BRANCH_MISS, PC_N };
+
+typedef struct {
+    uint64_t v[PC_N];
+    uint64_t enabled, running;   /* para escalar si el kernel multiplexa */
+    int valid;
+} PerfSample;
+
+/* Activa la medición. Si el kernel no permite contadores imprime el
+ * motivo y devuelve -1 (el resto de llamadas quedan en no-op). */
+int perfctr_enable(void);
+
+/* 1 si la medición está activa. */
+int perfctr_on(void);
+
+/* Lee los contadores del hilo actual antes de la llamada al codec. */
+void perfctr_begin(PerfSample* s);
+
+/* Lee de nuevo y suma la diferencia a (alg, compress). bytes = entrada
+ * del codec (sin comprimir al comprimir, comprimida al descomprimir). */
+void perfctr_end(const PerfSample* s, CompAlg alg, int compress, uint64_t bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PERFCTR_H */
@@ -0,0 +1,178 @@
+/* =============================================================
+ * progress.c - Progreso en vivo (--progress / --progress-fd)
+ * -------------------------------------------------------------
+ * Los workers (y el recorrido de carpetas) solo hacen fetch_add sobre
+ * contadores atómicos: nunca toman un candado ni escriben. Un hilo
+ * "reportero" despierta cada PG_TICK_MS, lee los contadores y calcula:
+ *   - MB/s instantáneo: media móvil exponencial de los últimos ticks
+ *     (los bytes llegan a saltos, de a un chunk);
+ *   - MB/s promedio: bytes / tiempo desde el inicio;
+ *   - ETA: bytes pendientes / MB/s promedio, solo cuando el recorrido
+ *     terminó y el total es definitivo.
+ * Los bytes se acreditan a medida que terminan los chunks de cada
+ * archivo (progress_add_bytes); al cerrar el archivo solo se suma lo que
+ * no pasó por chunks y se cuenta el archivo.
+ * Salida humana: una línea en stderr que se reescribe con '\r'.
+ * Salida para máquinas: una línea JSON por tick en el fd indicado,
+ * la última con "done":true.
+ * ============================================================= */
+#include "progress.h"
+#include "journal.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PG_TICK_MS 250        /* 4 actualizaciones por segundo */
+#define PG_ALPHA   0.3        /* peso del último tick en el MB/s instantáneo */
+
+static atomic_int g_on;
+static atomic_ullong g_files_total, g_bytes_total;
+static atomic_ullong g_files_done, g_bytes_done, g_errors;
+static atomic_int g_total_known;
+
+static int g_human;
+static int g_fd = -1;
+static uint64_t g_t0;
+
+static pthread_t g_thread;
+static pthread_mutex_t g_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_cv = PTHREAD_COND_INITIALIZER;
+static int g_stop;
+
+/* Estado del reportero (solo lo toca su hilo, y progress_stop tras el join) */
+static uint64_t g_last_ns, g_last_bytes;
+static double g_inst_mbs;
+static int g_last_len;        /* largo de la última línea humana */
+
+int progress_on(void) {
+    return atomic_load_explicit(&g_on, memory_order_relaxed);
+}
+
+void progress_add_total(uint64_t bytes) {
+    if (!progress_on()) return;
+    atomic_fetch_add_explicit(&g_files_total, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_bytes_total, bytes, memory_order_relaxed);
+}
+
+void progress_total_known(void) {
+    if (progress_on()) atomic_store(&g_total_known, 1);
+}
+
+void progress_add_bytes(uint64_t bytes) {
+    if (progress_on()) atomic_fetch_add_explicit(&g_bytes_done, bytes, memory_order_relaxed);
+}
+
+void progress_file_done(uint64_t rest, int ok) {
+    if (!progress_on()) return;
+    atomic_fetch_add_explicit(&g_bytes_done, rest, memory_order_relaxed);
+    if (!ok) atomic_fetch_add_explicit(&g_errors, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_files_done, 1, memory_order_relaxed);
+}
+
+static void fmt_eta(double s, char* out, size_t cap) {
+    if (s < 0) { snprintf(out, cap, "?"); return; }
+    unsigned long t = (unsigned long)(s + 0.5);
+    if (t >= 3600) snprintf(out, cap, "%luh%02lum", t / 3600, (t / 60) % 60);
+    else snprintf(out, cap, "%lum%02lus", t / 60, t % 60);
+}
+
+static void report(int done) {
+    uint64_t now = journal_now_ns();
+    unsigned long long fd_ = atomic_load(&g_files_done), ft = atomic_load(&g_files_total);
+    unsigned long long bd = atomic_load(&g_bytes_done), bt = atomic_load(&g_bytes_total);
+    unsigned long long err = atomic_load(&g_errors);
+    int known = atomic_load(&g_total_known) || done;
+
+    double el = (double)(now - g_t0) / 1e9;
+    double dt = (double)(now - g_last_ns) / 1e9;
+    if (dt > 0) {
+        double mbs = (double)(bd - g_last_bytes) / (1024.0 * 1024.0) / dt;
+        g_inst_mbs = (g_last_ns == g_t0) ? mbs : PG_ALPHA * mbs + (1 - PG_ALPHA) * g_inst_mbs;
+    }
+    g_last_ns = now;
+    g_last_bytes = bd;
+    double avg = el > 0 ? (double)bd / (1024.0 * 1024.0) / el : 0.0;
+    double eta = -1;
+    if (known && avg > 0) eta = (double)(bt > bd ? bt - bd : 0) / (1024.0 * 1024.0) / avg;
+    if (done) eta = 0;
+
+    if (g_human) {
+        char eta_s[32], line[256];
+        fmt_eta(eta, eta_s, sizeof(eta_s));
+        int n = snprintf(line, sizeof(line),
+                         "%llu/%llu%s archivos | %.1f/%.1f MB | %.1f MB/s (prom %.1f) | ETA %s%s",
+                         fd_, ft, known ? "" : "+", (double)bd / (1024.0 * 1024.0),
+                         (double)bt / (1024.0 * 1024.0), g_inst_mbs, avg, eta_s,
+                         err ? " | con errores" : "");
+        if (n < 0) n = 0;
+        if (n >= (int)sizeof(line)) n = (int)sizeof(line) - 1;
+        /* rellena con espacios si la línea anterior era más larga */
+        fprintf(stderr, "\r%s%*s%s", line, g_last_len > n ? g_last_len - n : 0, "", done ? "\n" : "");
+        fflush(stderr);
+        g_last_len = n;
+    }
+    if (g_fd >= 0) {
+        char buf[512];
+        int n = snprintf(buf, sizeof(buf),
+                         "{\"elapsed_s\":%.3f,\"files_done\":%llu,\"files_total\":%llu,"
+                         "\"total_known\":%s,\"bytes_done\":%llu,\"bytes_total\":%llu,"
+                         "\"errors\":%llu,\"mbs_inst\":%.3f,\"mbs_avg\":%.3f,\"eta_s\":",
+                         el, fd_, ft, known ? "true" : "false", bd, bt, err, g_inst_mbs, avg);
+        if (n > 0 && n < (int)sizeof(buf))
+            n += snprintf(buf + n, sizeof(buf) - (size_t)n, eta < 0 ? "null" : "%.1f", eta);
+        if (n > 0 && n < (int)sizeof(buf))
+            n += snprintf(buf + n, sizeof(buf) - (size_t)n, ",\"done\":%s}\n", done ? "true" : "false");
+        if (n > 0 && n < (int)sizeof(buf)) {
+            /* un solo write por línea: el lector nunca ve media línea */
+            ssize_t w = write(g_fd, buf, (size_t)n);
+            (void)w;
+        }
+    }
+}
+
+static void* reporter_main(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&g_mtx);
+    while (!g_stop) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += PG_TICK_MS * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) { ts.tv_sec++; ts.tv_nsec -= 1000000000L; }
+        pthread_cond_timedwait(&g_cv, &g_mtx, &ts);
+        if (g_stop) break;
+        report(0);
+    }
+    pthread_mutex_unlock(&g_mtx);
+    return NULL;
+}
+
+void progress_stop(void) {
+    if (!progress_on()) return;
+    pthread_mutex_lock(&g_mtx);
+    g_stop = 1;
+    pthread_cond_signal(&g_cv);
+    pthread_mutex_unlock(&g_mtx);
+    pthread_join(g_thread, NULL);
+    report(1);
+    atomic_store(&g_on, 0);
+}
+
+int progress_start(int human, int fd) {
+    if (progress_on() || (!human && fd < 0)) return -1;
+    g_human = human;
+    g_fd = fd;
+    g_t0 = g_last_ns = journal_now_ns();
+    g_stop = 0;
+    atomic_store(&g_on, 1);
+    if (pthread_create(&g_thread, NULL, reporter_main, NULL) != 0) {
+        atomic_store(&g_on, 0);
+        return -1;
+    }
+    static int registered;
+    if (!registered) { atexit(progress_stop); registered = 1; }
+    return 0;
+}
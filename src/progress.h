@@ -0,0 +1,44 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Progreso en vivo de corridas largas: archivos hechos / total, bytes,
+ * MB/s instantáneo y promedio y ETA. Los workers solo tocan contadores
+ * atómicos; un hilo aparte los lee unas pocas veces por segundo y:
+ *   - human = 1: reescribe una línea en stderr (--progress);
+ *   - fd >= 0:   escribe una línea JSON por tick en ese fd (--progress-fd). */
+
+/* Arranca el hilo. 0 = ok, -1 = error (o nada que mostrar). */
+int progress_start(int human, int fd);
+
+/* 1 si hay un reporte activo (las demás llamadas son no-op si no). */
+int progress_on(void);
+
+/* Se encontró un archivo de 'bytes' bytes (el total crece mientras
+ * el recorrido sigue). */
+void progress_add_total(uint64_t bytes);
+
+/* El recorrido terminó: el total ya es definitivo y hay ETA. */
+void progress_total_known(void);
+
+/* Bytes de entrada procesados (un chunk terminado), sin esperar a que
+ * termine el archivo: con archivos grandes el MB/s y la ETA se mueven. */
+void progress_add_bytes(uint64_t bytes);
+
+/* Un archivo terminó (ok = 0 si falló); rest = bytes de su entrada que
+ * no se acreditaron por chunk (cabeceras, cifrado, delta16, errores). */
+void progress_file_done(uint64_t rest, int ok);
+
+/* Escribe el estado final y detiene el hilo (también al salir). */
+void progress_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PROGRESS_H */
@@ -16,47 +16,37 @@
 #include <stdlib.h>
 #include <string.h>
 
-/* emit_literal: escribe un bloque literal (n bytes crudos) con encabezado 'n'. */
-static void emit_literal(uint8_t** out, size_t* k, size_t* cap, const uint8_t* lit, size_t n) {
-    if (*k + 1 + n > *cap) {
-        size_t ncap = (*cap) * 2 + 1 + n;
-        uint8_t* tmp = (uint8_t*)realloc(*out, ncap);
-        if (!tmp) return;
-        *out = tmp; *cap = ncap;
-    }
-    (*out)[(*k)++] = (uint8_t)n;         // len (1..127)
-    memcpy(*out + *k, lit, n); *k += n;  // copia literales
+/* emit_literal: escribe un bloque literal (n bytes crudos) con encabezado 'n'.
+ * Devuelve -1 si no cabe en los 'cap' bytes del destino. */
+static int emit_literal(uint8_t* out, size_t* k, size_t cap, const uint8_t* lit, size_t n) {
+    if (*k + 1 + n > cap) return -1;
+    out[(*k)++] = (uint8_t)n;         // len (1..127)
+    memcpy(out + *k, lit, n); *k += n;  // copia literales
+    return 0;
 }
 
 /* emit_run: escribe un bloque de repetición (run) con marca 0x80 | len. */
-static void emit_run(uint8_t** out, size_t* k, size_t* cap, uint8_t val, size_t run_len) {
-    if (run_len < 3) return; // contrato del llamador
+static int emit_run(uint8_t* out, size_t* k, size_t cap, uint8_t val, size_t run_len) {
+    if (run_len < 3) return 0; // contrato del llamador
     if (run_len > 127) run_len = 127;
-    if (*k + 2 > *cap) {
-        size_t ncap = (*cap) * 2 + 2;
-        uint8_t* tmp = (uint8_t*)realloc(*out, ncap);
-        if (!tmp) return;
-        *out = tmp; *cap = ncap;
-    }
-    (*out)[(*k)++] = (uint8_t)(0x80 | (uint8_t)run_len); // marca de run
-    (*out)[(*k)++] = val;
+    if (*k + 2 > cap) return -1;
+    out[(*k)++] = (uint8_t)(0x80 | (uint8_t)run_len); // marca de run
+    out[(*k)++] = val;
+    return 0;
 }
 
-/* rle_var_compress:
+/* Peor caso: todo literal, 1 byte de encabezado por cada 127 de datos
+ * (un run nunca ocupa más que los bytes que reemplaza). */
+size_t rle_var_compress_bound(size_t in_len) {
+    return in_len + in_len / 127 + 1;
+}
+
+/* rle_var_compress_into:
  * Recorre la entrada detectando runs >=3; si no hay run largo, acumula
- * bytes en un bloque literal. Al final ajusta el buffer al tamaño exacto.
+ * bytes en un bloque literal. Escribe directo en out[0..cap).
  */
-int rle_var_compress(const uint8_t* in, size_t in_len, uint8_t** out, size_t* out_len) {
-    *out = NULL; *out_len = 0;
-    if (in_len == 0) {
-        *out = (uint8_t*)malloc(1); if (!*out) return -1;
-        *out_len = 0; return 0;
-    }
-
-    size_t cap = in_len + in_len/8 + 16; // heurística
-    uint8_t* buf = (uint8_t*)malloc(cap ? cap : 1);
-    if (!buf) return -1;
-
+int rle_var_compress_into(const uint8_t* in, size_t in_len, uint8_t* out, size_t cap, size_t* out_len) {
+    *out_len = 0;
     size_t i = 0, k = 0;
     while (i < in_len) {
         /* Detectar run a partir de posición 'i' */
@@ -64,7 +54,7 @@ int rle_var_compress(const uint8_t* in, size_t in_len, uint8_t** out, size_t* ou
         while (i + run < in_len && in[i + run] == in[i] && run < 127) run++;
 
         if (run >= 3) {
-            emit_run(&buf, &k, &cap, in[i], run);
+            if (emit_run(out, &k, cap, in[i], run) != 0) return -1;
             i += run;
         } else {
             /* Construir bloque literal hasta antes de un run largo o llegar a 127 */
@@ -79,9 +69,22 @@ int rle_var_compress(const uint8_t* in, size_t in_len, uint8_t** out, size_t* ou
                 if (r >= 3) break; // nos detenemos antes del run largo
                 lit[n++] = in[i++];
             }
-            emit_literal(&buf, &k, &cap, lit, n);
+            if (emit_literal(out, &k, cap, lit, n) != 0) return -1;
         }
     }
+    *out_len = k;
+    return 0;
+}
+
+/* rle_var_compress: reserva la cota, comprime y ajusta al tamaño exacto. */
+int rle_var_compress(const uint8_t* in, size_t in_len, uint8_t** out, size_t* out_len) {
+    *out = NULL; *out_len = 0;
+    size_t cap = rle_var_compress_bound(in_len);
+    uint8_t* buf = (uint8_t*)malloc(cap);
+    if (!buf) return -1;
+
+    size_t k = 0;
+    if (rle_var_compress_into(in, in_len, buf, cap, &k) != 0) { free(buf); return -1; }
 
     uint8_t* shrink = (uint8_t*)realloc(buf, k ? k : 1);
     if (shrink) buf = shrink;
@@ -142,3 +145,27 @@ int rle_var_decompress(const uint8_t* in, size_t in_len, uint8_t** out, size_t*
     *out = buf; *out_len = k;
     return 0;
 }
+
+/* rle_var_decompress_into: una sola pasada escribiendo en out[0..cap);
+ * -1 si la entrada está corrupta o no cabe. */
+int rle_var_decompress_into(const uint8_t* in, size_t in_len, uint8_t* out, size_t cap, size_t* out_len) {
+    *out_len = 0;
+    size_t k = 0, i = 0;
+    while (i < in_len) {
+        uint8_t hdr = in[i++];
+        if (hdr & 0x80) { /* run */
+            if (i >= in_len) return -1;
+            uint8_t run_len = (uint8_t)(hdr & 0x7F);
+            if (run_len > cap - k) return -1;
+            memset(out + k, in[i++], run_len);
+            k += run_len;
+        } else { /* literal */
+            uint8_t n = hdr;
+            if (i + n > in_len || n > cap - k) return -1;
+            memcpy(out + k, in + i, n);
+            k += n; i += n;
+        }
+    }
+    *out_len = k;
+    return 0;
+}
@@ -8,6 +8,13 @@
 // Bloque run:     [0x80 | run_len (3..127)] [byte]
 
 int rle_var_compress(const uint8_t* in, size_t in_len, uint8_t** out, size_t* out_len);
+/* Tamaño máximo de la salida de rle_var_compress para in_len bytes. */
+size_t rle_var_compress_bound(size_t in_len);
+/* Comprime directo en out[0..cap) (cap >= bound siempre alcanza).
+ * 0 = ok (*out_len = bytes escritos), -1 = no cabe. */
+int rle_var_compress_into(const uint8_t* in, size_t in_len, uint8_t* out, size_t cap, size_t* out_len);
 int rle_var_decompress(const uint8_t* in, size_t in_len, uint8_t** out, size_t* out_len);
+/* Descomprime directo en out[0..cap). 0 = ok, -1 = corrupto o no cabe. */
+int rle_var_decompress_into(const uint8_t* in, size_t in_len, uint8_t* out, size_t cap, size_t* out_len);
 
 #endif
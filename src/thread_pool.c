@@ -9,27 +9,41 @@
  *   tp_submit(fn,arg) -> mete tarea en cola y despierta un hilo.
  *   tp_wait()     -> bloquea hasta que cola vacía y nada ejecutándose.
  *   tp_destroy()  -> señala "stop", une hilos y libera memoria.
- * Cola: FIFO sencilla. Se reubica con memmove (óptimo suficiente
- * para cargas pequeñas/medianas). Para más rendimiento podría usarse
- * índice circular.
+ * Cola: heap binario por (prioridad, orden de llegada): sale primero la
+ * mayor prioridad y, entre iguales, la más antigua (FIFO). Encolar y
+ * sacar cuestan O(log n), así una cola profunda (millones de archivos
+ * descubiertos más rápido de lo que se procesan) no se vuelve
+ * cuadrática. Con tp_submit (prio 0) se comporta como FIFO sencilla.
+ * Estadísticas: cada pool cuenta tiempo en tareas, en espera del mutex
+ * y dormido sin trabajo (ver tp_get_stats); al destruirse suma sus
+ * contadores a un total de proceso. Con --trace cada tarea queda como
+ * un evento "task" (trace.c).
  * ============================================================= */
 #include "thread_pool.h"
+#include "trace.h"
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
-/* TPTask: representa una tarea pendiente (función + argumento). */
+/* TPTask: representa una tarea pendiente (función + argumento + prioridad).
+ * seq = orden de llegada, desempata prioridades iguales. */
 typedef struct {
     tp_work_fn fn;
     void* arg;
+    size_t prio;
+    unsigned long long seq;
 } TPTask;
 
 /* ThreadPool: estado interno del pool.
  * - threads: arreglo de hilos trabajadores.
- * - queue/q_count/q_cap: cola dinámica de tareas pendientes.
+ * - queue/q_count/q_cap: heap dinámico de tareas pendientes.
+ * - next_seq: contador de llegada para el desempate FIFO.
  * - active: cuántas tareas se están ejecutando ahora.
+ * - limit: máximo de tareas simultáneas (<= nthreads), ver tp_set_limit.
  * - stop: bandera para terminar el bucle de cada hilo.
  * - mtx + condiciones: sincronización para acceso a la cola y espera.
+ * - st: contadores de tp_get_stats (protegidos por mtx).
  */
 struct ThreadPool {
     pthread_t* threads;
@@ -38,43 +52,110 @@ struct ThreadPool {
     TPTask* queue;
     size_t q_cap;
     size_t q_count;
+    unsigned long long next_seq;
 
     int stop;
     size_t active;
+    size_t limit;
 
     pthread_mutex_t mtx;
     pthread_cond_t  cv_has_work;
     pthread_cond_t  cv_done;
+
+    ThreadPoolStats st;
 };
 
+/* Total de los pools ya destruidos (tp_get_stats(NULL, ...)). */
+static pthread_mutex_t g_stats_mtx = PTHREAD_MUTEX_INITIALIZER;
+static ThreadPoolStats g_stats;
+
+static unsigned long long tp_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+}
+
+/* tp_lock: toma el mutex; solo mide el reloj si hay contención, así el
+ * camino sin competencia cuesta lo mismo que antes. */
+static void tp_lock(ThreadPool* tp) {
+    if (pthread_mutex_trylock(&tp->mtx) == 0) return;
+    unsigned long long t0 = tp_now_ns();
+    pthread_mutex_lock(&tp->mtx);
+    tp->st.lock_wait_ns += tp_now_ns() - t0;
+}
+
+/* ---------- Heap de tareas (con el mutex tomado) ---------- */
+/* 1 si a debe salir antes que b */
+static int task_before(const TPTask* a, const TPTask* b) {
+    if (a->prio != b->prio) return a->prio > b->prio;
+    return a->seq < b->seq;
+}
+
+static void heap_push(ThreadPool* tp, TPTask t) {
+    size_t i = tp->q_count++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!task_before(&t, &tp->queue[parent])) break;
+        tp->queue[i] = tp->queue[parent];
+        i = parent;
+    }
+    tp->queue[i] = t;
+}
+
+static TPTask heap_pop(ThreadPool* tp) {
+    TPTask top = tp->queue[0];
+    TPTask last = tp->queue[--tp->q_count];
+    size_t n = tp->q_count, i = 0;
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= n) break;
+        if (c + 1 < n && task_before(&tp->queue[c + 1], &tp->queue[c])) c++;
+        if (!task_before(&tp->queue[c], &last)) break;
+        tp->queue[i] = tp->queue[c];
+        i = c;
+    }
+    if (n > 0) tp->queue[i] = last;
+    return top;
+}
+
 /* tp_worker_main: función que corre en cada hilo.
- * Espera trabajo; al recibirlo lo saca (FIFO), suelta el candado, ejecuta,
+ * Espera trabajo; al recibirlo saca el primero del heap, suelta el candado, ejecuta,
  * y al terminar actualiza 'active'. Si ya no queda nada (cola vacía y active=0)
  * avisa a quienes estén esperando en tp_wait().
  */
 static void* tp_worker_main(void* arg) {
     ThreadPool* tp = (ThreadPool*)arg;
     for (;;) {
-        pthread_mutex_lock(&tp->mtx);
-        while (!tp->stop && tp->q_count == 0) {
-            pthread_cond_wait(&tp->cv_has_work, &tp->mtx);
+        tp_lock(tp);
+        if (!tp->stop && (tp->q_count == 0 || tp->active >= tp->limit)) {
+            unsigned long long t0 = tp_now_ns();
+            while (!tp->stop && (tp->q_count == 0 || tp->active >= tp->limit)) {
+                pthread_cond_wait(&tp->cv_has_work, &tp->mtx);
+            }
+            tp->st.idle_ns += tp_now_ns() - t0;
         }
         if (tp->stop && tp->q_count == 0) {
             pthread_mutex_unlock(&tp->mtx);
             break; /* salir del bucle */
         }
-        TPTask task = tp->queue[0];
-        memmove(tp->queue, tp->queue + 1, (tp->q_count - 1) * sizeof(TPTask));
-        tp->q_count--;
+        TPTask task = heap_pop(tp);
         tp->active++;
         pthread_mutex_unlock(&tp->mtx);
 
+        unsigned long long t0 = tp_now_ns();
         if (task.fn) task.fn(task.arg);
+        unsigned long long t1 = tp_now_ns();
+        unsigned long long dt = t1 - t0;
+        trace_event("task", "pool", NULL, -1, t0, t1);
 
-        pthread_mutex_lock(&tp->mtx);
+        tp_lock(tp);
+        tp->st.tasks++;
+        tp->st.task_ns += dt;
         tp->active--;
         if (tp->q_count == 0 && tp->active == 0) {
             pthread_cond_broadcast(&tp->cv_done);
+        } else if (tp->q_count > 0) {
+            pthread_cond_signal(&tp->cv_has_work); /* por si otro hilo esperaba cupo */
         }
         pthread_mutex_unlock(&tp->mtx);
     }
@@ -89,6 +170,7 @@ ThreadPool* tp_create(size_t nthreads) {
     if (!tp) return NULL;
 
     tp->nthreads = nthreads;
+    tp->limit = nthreads;
     tp->q_cap = 16;
     tp->queue = (TPTask*)calloc(tp->q_cap, sizeof(TPTask));
     if (!tp->queue) {
@@ -117,11 +199,16 @@ ThreadPool* tp_create(size_t nthreads) {
     return tp;
 }
 
-/* tp_submit: agrega una tarea (fn,arg) a la cola y despierta un hilo. */
+/* tp_submit: agrega una tarea (fn,arg) al final de la cola y despierta un hilo. */
 int tp_submit(ThreadPool* tp, tp_work_fn fn, void* arg) {
+    return tp_submit_prio(tp, fn, arg, 0);
+}
+
+/* tp_submit_prio: inserta en el heap por (prio, orden de llegada). */
+int tp_submit_prio(ThreadPool* tp, tp_work_fn fn, void* arg, size_t prio) {
     if (!tp || !fn) return -1;
 
-    pthread_mutex_lock(&tp->mtx);
+    tp_lock(tp);
 
     if (tp->stop) {
         pthread_mutex_unlock(&tp->mtx);
@@ -139,25 +226,79 @@ int tp_submit(ThreadPool* tp, tp_work_fn fn, void* arg) {
         tp->q_cap = new_cap;
     }
 
-    tp->queue[tp->q_count].fn  = fn;
-    tp->queue[tp->q_count].arg = arg;
-    tp->q_count++;
+    TPTask t = { fn, arg, prio, tp->next_seq++ };
+    heap_push(tp, t);
+    if (tp->q_count > tp->st.queue_peak) tp->st.queue_peak = tp->q_count;
 
     pthread_cond_signal(&tp->cv_has_work);
     pthread_mutex_unlock(&tp->mtx);
     return 0;
 }
 
+/* tp_set_limit: ajusta el cupo de tareas simultáneas. Si sube, despierta
+ * a los hilos dormidos para que tomen trabajo pendiente. */
+void tp_set_limit(ThreadPool* tp, size_t limit) {
+    if (!tp) return;
+    if (limit < 1) limit = 1;
+    if (limit > tp->nthreads) limit = tp->nthreads;
+    pthread_mutex_lock(&tp->mtx);
+    if (limit != tp->limit) {
+        tp->limit = limit;
+        pthread_cond_broadcast(&tp->cv_has_work);
+    }
+    pthread_mutex_unlock(&tp->mtx);
+}
+
 /* tp_wait: bloquea hasta que no queden tareas pendientes ni en ejecución. */
 void tp_wait(ThreadPool* tp) {
     if (!tp) return;
-    pthread_mutex_lock(&tp->mtx);
+    tp_lock(tp);
     while (tp->q_count > 0 || tp->active > 0) {
         pthread_cond_wait(&tp->cv_done, &tp->mtx);
     }
     pthread_mutex_unlock(&tp->mtx);
 }
 
+/* tp_get_stats: copia los contadores del pool (o el total del proceso). */
+void tp_get_stats(ThreadPool* tp, ThreadPoolStats* out) {
+    if (!out) return;
+    if (!tp) {
+        pthread_mutex_lock(&g_stats_mtx);
+        *out = g_stats;
+        pthread_mutex_unlock(&g_stats_mtx);
+        return;
+    }
+    pthread_mutex_lock(&tp->mtx);
+    *out = tp->st;
+    pthread_mutex_unlock(&tp->mtx);
+}
+
+/* tp_reset_stats: pone a cero los contadores (o el total del proceso). */
+void tp_reset_stats(ThreadPool* tp) {
+    if (!tp) {
+        pthread_mutex_lock(&g_stats_mtx);
+        memset(&g_stats, 0, sizeof(g_stats));
+        pthread_mutex_unlock(&g_stats_mtx);
+        return;
+    }
+    pthread_mutex_lock(&tp->mtx);
+    memset(&tp->st, 0, sizeof(tp->st));
+    pthread_mutex_unlock(&tp->mtx);
+}
+
+/* tp_queue_depth: largo actual de la cola. */
+size_t tp_queue_depth(ThreadPool* tp) {
+    if (!tp) return 0;
+    pthread_mutex_lock(&tp->mtx);
+    size_t n = tp->q_count;
+    pthread_mutex_unlock(&tp->mtx);
+    return n;
+}
+
+size_t tp_thread_count(const ThreadPool* tp) {
+    return tp ? tp->nthreads : 0;
+}
+
 /* tp_destroy: señala parada, une hilos y libera toda la memoria. */
 void tp_destroy(ThreadPool* tp) {
     if (!tp) return;
@@ -171,6 +312,14 @@ void tp_destroy(ThreadPool* tp) {
         pthread_join(tp->threads[i], NULL);
     }
 
+    pthread_mutex_lock(&g_stats_mtx);
+    g_stats.tasks        += tp->st.tasks;
+    g_stats.task_ns      += tp->st.task_ns;
+    g_stats.lock_wait_ns += tp->st.lock_wait_ns;
+    g_stats.idle_ns      += tp->st.idle_ns;
+    if (tp->st.queue_peak > g_stats.queue_peak) g_stats.queue_peak = tp->st.queue_peak;
+    pthread_mutex_unlock(&g_stats_mtx);
+
     free(tp->threads);
     free(tp->queue);
     pthread_mutex_destroy(&tp->mtx);
@@ -11,15 +11,51 @@ typedef void (*tp_work_fn)(void *arg);
 
 typedef struct ThreadPool ThreadPool;
 
+/* Contadores acumulados del pool (nanosegundos sumados entre hilos).
+ * - lock_wait_ns: tiempo bloqueado esperando el mutex de la cola
+ *   (hilos trabajadores y quien encola); solo cuenta si hubo contención.
+ * - idle_ns: tiempo de los hilos dormidos esperando trabajo o cupo.
+ * - task_ns: tiempo dentro de las funciones de las tareas (codecs). */
+typedef struct {
+    unsigned long long tasks;
+    unsigned long long task_ns;
+    unsigned long long lock_wait_ns;
+    unsigned long long idle_ns;
+    unsigned long long queue_peak;   /* mayor largo de cola visto */
+} ThreadPoolStats;
+
 /* Crea un pool con nthreads hilos. */
 ThreadPool* tp_create(size_t nthreads);
 
 /* Encola una tarea. Devuelve 0 si ok, -1 si error. */
 int tp_submit(ThreadPool* tp, tp_work_fn fn, void* arg);
 
+/* Encola con prioridad: sale primero la mayor 'prio' (FIFO entre
+ * iguales); encolar y sacar son O(log n). tp_submit equivale a prio = 0. */
+int tp_submit_prio(ThreadPool* tp, tp_work_fn fn, void* arg, size_t prio);
+
 /* Espera a que se terminen TODAS las tareas encoladas. */
 void tp_wait(ThreadPool* tp);
 
+/* Limita cuántas tareas corren a la vez (1..nthreads). Los hilos que
+ * sobran quedan dormidos; permite seguir cambios de cuota de CPU sin
+ * recrear el pool. */
+void tp_set_limit(ThreadPool* tp, size_t limit);
+
+/* Copia los contadores del pool. Con tp = NULL devuelve el total de
+ * todos los pools ya destruidos en el proceso (útil para pools internos
+ * de vida corta, como los de chunked.c). */
+void tp_get_stats(ThreadPool* tp, ThreadPoolStats* out);
+
+/* Pone a cero los contadores (tp = NULL: el total del proceso). */
+void tp_reset_stats(ThreadPool* tp);
+
+/* Tareas en cola ahora mismo (sin contar las que se están ejecutando). */
+size_t tp_queue_depth(ThreadPool* tp);
+
+/* Cantidad de hilos del pool. */
+size_t tp_thread_count(const ThreadPool* tp);
+
 /* Apaga el pool y libera memoria. */
 void tp_destroy(ThreadPool* tp);
 
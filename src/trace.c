@@ -0,0 +1,129 @@
+/* =============================================================
+ * trace.c - Exportación de trazas (Chrome Trace Event / Perfetto)
+ * -------------------------------------------------------------
+ * Cada evento es una entrada "X" (ts + dur en µs) con el id de hilo
+ * del journal, así las líneas de Perfetto coinciden con el campo
+ * "tid" de --journal-json. Los eventos se acumulan en un arreglo
+ * protegido por un mutex (son de grano grueso: tareas, chunks,
+ * archivos) y se vuelcan una sola vez al final:
+ *   {"traceEvents": [ {"name":..,"cat":..,"ph":"X","ts":..,"dur":..,
+ *                      "pid":1,"tid":..,"args":{"file":..,"chunk":..}}, ...]}
+ * Los tiempos son relativos a trace_open.
+ * ============================================================= */
+#include "trace.h"
+#include "journal.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char* name;
+    const char* cat;
+    char* file;
+    long chunk;
+    unsigned tid;
+    uint64_t t0, t1;
+} TraceEvent;
+
+static pthread_mutex_t g_mtx = PTHREAD_MUTEX_INITIALIZER;
+static atomic_int g_on;      /* lectura sin candado en el camino rápido */
+static char* g_path;
+static uint64_t g_start;
+static TraceEvent* g_ev;
+static size_t g_n, g_cap;
+static unsigned g_max_tid;
+
+int trace_open(const char* path) {
+    if (!path) return -1;
+    FILE* f = fopen(path, "w");    /* falla temprano si no se puede escribir */
+    if (!f) return -1;
+    fclose(f);
+    journal_thread_id();           /* el hilo que abre la traza es el 1 */
+    char* p = strdup(path);
+    if (!p) return -1;
+    pthread_mutex_lock(&g_mtx);
+    free(g_path);
+    g_path = p;
+    g_start = journal_now_ns();
+    pthread_mutex_unlock(&g_mtx);
+    static int registered;
+    if (!registered) { registered = 1; atexit(trace_close); }
+    atomic_store(&g_on, 1);
+    return 0;
+}
+
+int trace_on(void) {
+    return atomic_load_explicit(&g_on, memory_order_relaxed);
+}
+
+void trace_event(const char* name, const char* cat, const char* file, long chunk,
+                 uint64_t t0_ns, uint64_t t1_ns) {
+    if (!trace_on()) return;
+    unsigned tid = journal_thread_id();
+    char* f = file ? strdup(file) : NULL;
+    pthread_mutex_lock(&g_mtx);
+    if (!g_path) { pthread_mutex_unlock(&g_mtx); free(f); return; }
+    if (g_n == g_cap) {
+        size_t nc = g_cap ? g_cap * 2 : 1024;
+        TraceEvent* t = realloc(g_ev, nc * sizeof(TraceEvent));
+        if (!t) { pthread_mutex_unlock(&g_mtx); free(f); return; }
+        g_ev = t;
+        g_cap = nc;
+    }
+    g_ev[g_n++] = (TraceEvent){ name, cat, f, chunk, tid, t0_ns, t1_ns };
+    if (tid > g_max_tid) g_max_tid = tid;
+    pthread_mutex_unlock(&g_mtx);
+}
+
+static void write_str(FILE* f, const char* s) {
+    fputc('"', f);
+    for (; s && *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') { fputc('\\', f); fputc(c, f); }
+        else if (c < 0x20) fprintf(f, "\\u%04x", c);
+        else fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+static double rel_us(uint64_t t) {
+    return t > g_start ? (double)(t - g_start) / 1000.0 : 0.0;
+}
+
+void trace_close(void) {
+    atomic_store(&g_on, 0);
+    pthread_mutex_lock(&g_mtx);
+    if (!g_path) { pthread_mutex_unlock(&g_mtx); return; }
+    FILE* f = fopen(g_path, "w");
+    if (f) {
+        fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+        fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"gsea\"}}");
+        for (unsigned t = 1; t <= g_max_tid; t++)
+            fprintf(f, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, "
+                       "\"args\": {\"name\": \"%s %u\"}}", t, t == 1 ? "main" : "hilo", t);
+        for (size_t i = 0; i < g_n; i++) {
+            const TraceEvent* e = &g_ev[i];
+            fprintf(f, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, "
+                       "\"dur\": %.3f, \"pid\": 1, \"tid\": %u, \"args\": {",
+                    e->name, e->cat, rel_us(e->t0),
+                    e->t1 > e->t0 ? (double)(e->t1 - e->t0) / 1000.0 : 0.0, e->tid);
+            int comma = 0;
+            if (e->file) { fprintf(f, "\"file\": "); write_str(f, e->file); comma = 1; }
+            if (e->chunk >= 0) fprintf(f, "%s\"chunk\": %ld", comma ? ", " : "", e->chunk);
+            fprintf(f, "}}");
+        }
+        fprintf(f, "\n]}\n");
+        fclose(f);
+    } else {
+        fprintf(stderr, "No se pudo escribir la traza %s\n", g_path);
+    }
+    for (size_t i = 0; i < g_n; i++) free(g_ev[i].file);
+    free(g_ev);
+    g_ev = NULL;
+    g_n = g_cap = 0;
+    free(g_path);
+    g_path = NULL;
+    pthread_mutex_unlock(&g_mtx);
+}
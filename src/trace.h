@@ -0,0 +1,35 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Traza en formato Chrome Trace Event (chrome://tracing, Perfetto):
+ * un evento "X" (inicio + duración) por tarea del pool, etapa del
+ * pipeline (lectura, chunk comprimido, cifrado, ...) y escritura, con
+ * el hilo que lo ejecutó. Los eventos se guardan en memoria y el JSON se
+ * escribe al salir del proceso (atexit). */
+
+/* Activa la traza hacia 'path'. 0 = ok, -1 = error. */
+int trace_open(const char* path);
+
+/* 1 si hay una traza activa. */
+int trace_on(void);
+
+/* Registra un evento [t0_ns, t1_ns) (CLOCK_MONOTONIC) en el hilo actual.
+ * name y cat deben ser cadenas estáticas; file se copia (puede ser NULL);
+ * chunk < 0 = sin chunk. */
+void trace_event(const char* name, const char* cat, const char* file, long chunk,
+                 uint64_t t0_ns, uint64_t t1_ns);
+
+/* Escribe el archivo y libera los eventos (también se llama al salir). */
+void trace_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRACE_H */
@@ -0,0 +1,314 @@
+/* =============================================================
+ * walk.c - Recorrido recursivo y paralelo de carpetas
+ * -------------------------------------------------------------
+ * Objetivo: listar árboles con millones de archivos sin pagar un
+ * malloc + dos stat() por entrada.
+ *   - Cada directorio es una tarea en un pool propio (o en el del
+ *     llamador, WalkOptions.pool): los subdirectorios se reparten
+ *     entre hilos. Un contador de directorios pendientes dice cuándo
+ *     terminó el listado sin esperar al resto de tareas del pool.
+ *   - Se abre cada directorio con openat() relativo al fd de su padre
+ *     (sin rutas largas ni tope PATH_MAX) y se lee con getdents64 en
+ *     bloques grandes (64 KB).
+ *   - d_type evita el stat de directorios; solo los archivos hacen
+ *     un fstatat() (relativo al fd del directorio) para el tamaño.
+ *   - Los archivos se entregan por callback apenas se descubren,
+ *     así el trabajo empieza antes de terminar el listado.
+ *   - La estructura de salida se replica con mkdirat() relativo al
+ *     fd de la carpeta de salida del padre.
+ *   - Lo que no se puede abrir, listar o leer no se pierde en silencio:
+ *     se avisa en stderr, se cuenta y walk_tree devuelve 1.
+ * Los enlaces simbólicos a archivos se siguen (igual que stat());
+ * los enlaces a directorios no se recorren para evitar ciclos.
+ * ============================================================= */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "walk.h"
+#include "thread_pool.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define WALK_DENTS_BUF (64 * 1024)
+
+/* Entrada cruda de getdents64 (no está en los headers de glibc antiguos) */
+struct linux_dirent64 {
+    uint64_t       d_ino;
+    int64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+};
+
+/* Estado compartido por todas las tareas de un recorrido */
+typedef struct {
+    const WalkOptions* opt;
+    ThreadPool* tp;
+    pthread_mutex_t mtx;
+    pthread_cond_t cv;
+    size_t pending;      /* directorios encolados o en curso */
+    int in_fd;           /* fd de la raíz de entrada */
+    int out_fd;          /* fd de la raíz de salida (-1 si no hay) */
+    atomic_size_t n_dirs;
+    atomic_size_t n_files;
+    atomic_size_t n_errors;
+} Walker;
+
+/* Directorio abierto, compartido con las tareas de sus hijos: cada hijo
+ * se abre con openat(fd, nombre) y suelta su referencia al empezar. Así
+ * no se vuelve a resolver la ruta desde la raíz y no hay tope PATH_MAX. */
+typedef struct {
+    int fd;
+    int out_fd;          /* -1 si no hay salida */
+    atomic_int refs;
+} DirRef;
+
+/* Tarea: un directorio (ruta relativa, "" = raíz) */
+typedef struct {
+    Walker* w;
+    DirRef* parent;      /* NULL = raíz */
+    char* rel;
+    const char* name;    /* último componente, dentro de rel */
+} DirTask;
+
+static void walk_dir(void* arg);
+
+static void dir_ref_put(DirRef* d) {
+    if (atomic_fetch_sub(&d->refs, 1) != 1) return;
+    close(d->fd);
+    if (d->out_fd >= 0) close(d->out_fd);
+    free(d);
+}
+
+/* Entrada que no se pudo recorrer: se avisa y se cuenta (walk_tree
+ * devuelve 1 si hubo alguna). */
+static void walk_error(Walker* w, const char* rel, const char* name, const char* what, int err) {
+    fprintf(stderr, "walk: %s%s%s: %s (%s)\n", rel[0] ? rel : ".", name ? "/" : "",
+            name ? name : "", what, strerror(err));
+    atomic_fetch_add(&w->n_errors, 1);
+}
+
+/* Une rel + "/" + name en un buffer nuevo (rel vacío = raíz) */
+static char* rel_join(const char* rel, const char* name) {
+    size_t nr = strlen(rel), nn = strlen(name);
+    char* r = malloc(nr + nn + 2);
+    if (!r) return NULL;
+    if (nr) { memcpy(r, rel, nr); r[nr++] = '/'; }
+    memcpy(r + nr, name, nn + 1);
+    return r;
+}
+
+/* Un directorio menos pendiente; el último despierta a walk_tree */
+static void dir_done(Walker* w) {
+    pthread_mutex_lock(&w->mtx);
+    if (--w->pending == 0) pthread_cond_broadcast(&w->cv);
+    pthread_mutex_unlock(&w->mtx);
+}
+
+/* Encola el hijo 'name' de parent (parent = NULL: la raíz, name = "") */
+static void submit_dir(Walker* w, DirRef* parent, const char* rel, const char* name) {
+    DirTask* t = malloc(sizeof(DirTask));
+    char* sub = parent ? rel_join(rel, name) : calloc(1, 1);
+    if (!t || !sub) {
+        free(t); free(sub);
+        walk_error(w, rel, parent ? name : NULL, "subcarpeta omitida", ENOMEM);
+        return;
+    }
+    t->w = w;
+    t->parent = parent;
+    t->rel = sub;
+    t->name = parent ? sub + strlen(sub) - strlen(name) : ".";
+    if (parent) atomic_fetch_add(&parent->refs, 1);
+    pthread_mutex_lock(&w->mtx);
+    w->pending++;
+    pthread_mutex_unlock(&w->mtx);
+    if (tp_submit(w->tp, walk_dir, t) != 0) {
+        walk_error(w, rel, parent ? name : NULL, "subcarpeta omitida", ENOMEM);
+        if (parent) dir_ref_put(parent);
+        free(sub); free(t);
+        dir_done(w);
+    }
+}
+
+static void list_dir(Walker* w, DirTask* t) {
+    const char* rel = t->rel;
+    int pfd  = t->parent ? t->parent->fd : w->in_fd;
+    int pofd = t->parent ? t->parent->out_fd : w->out_fd;
+
+    /* Replicar el directorio en la salida antes de emitir sus archivos */
+    int ofd = -1;
+    if (pofd >= 0) {
+        if (t->parent) mkdirat(pofd, t->name, 0755); /* EEXIST no es error */
+        ofd = openat(pofd, t->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (ofd < 0) walk_error(w, rel, NULL, "no se pudo crear en la salida", errno);
+    }
+    /* O_NOFOLLOW: un enlace a directorio puesto en lugar del original no se recorre */
+    int fd = openat(pfd, t->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC | (t->parent ? O_NOFOLLOW : 0));
+    int open_err = errno;
+    if (t->parent) dir_ref_put(t->parent);
+    t->parent = NULL;
+    if (fd < 0) {
+        walk_error(w, rel, NULL, "no se pudo abrir", open_err);
+        if (ofd >= 0) close(ofd);
+        return;
+    }
+    atomic_fetch_add(&w->n_dirs, 1);
+
+    DirRef* self = malloc(sizeof(DirRef));
+    char* buf = malloc(WALK_DENTS_BUF);
+    if (!self || !buf) {
+        walk_error(w, rel, NULL, "no se pudo listar", ENOMEM);
+        free(self); free(buf);
+        close(fd);
+        if (ofd >= 0) close(ofd);
+        return;
+    }
+    self->fd = fd;
+    self->out_fd = ofd;
+    atomic_init(&self->refs, 1);
+
+    /* Ruta relativa de cada archivo: el callback la copia si la necesita */
+    size_t nrel = strlen(rel);
+    size_t rcap = nrel + 256;
+    char* relbuf = malloc(rcap);
+
+    for (;;) {
+        long n = syscall(SYS_getdents64, fd, buf, WALK_DENTS_BUF);
+        if (n == 0) break;
+        if (n < 0) { walk_error(w, rel, NULL, "error al listar", errno); break; }
+
+        for (long off = 0; off < n; ) {
+            struct linux_dirent64* de = (struct linux_dirent64*)(buf + off);
+            off += de->d_reclen;
+
+            const char* name = de->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                continue;
+
+            unsigned char type = de->d_type;
+            size_t size = 0;
+
+            if (type == DT_DIR) {
+                submit_dir(w, self, rel, name);
+                continue;
+            }
+            if (type != DT_REG && type != DT_LNK && type != DT_UNKNOWN)
+                continue; /* sockets, fifos, dispositivos */
+
+            /* fstatat relativo al directorio abierto: sin construir rutas.
+             * Sin d_type primero se mira la entrada misma: un enlace se
+             * trata igual que con DT_LNK (no se recorre si es directorio). */
+            struct stat st;
+            int flags = (type == DT_LNK) ? 0 : AT_SYMLINK_NOFOLLOW;
+            int rc = fstatat(fd, name, &st, flags);
+            if (rc == 0 && type == DT_UNKNOWN && S_ISLNK(st.st_mode)) {
+                type = DT_LNK;
+                rc = fstatat(fd, name, &st, 0);
+            }
+            if (rc != 0) {
+                /* borrado durante el recorrido o enlace roto: no es un error */
+                if (errno != ENOENT) walk_error(w, rel, name, "no se pudo leer", errno);
+                continue;
+            }
+            if (S_ISDIR(st.st_mode)) {
+                if (type == DT_UNKNOWN) /* fs sin d_type: es un directorio real */
+                    submit_dir(w, self, rel, name);
+                continue;
+            }
+            if (!S_ISREG(st.st_mode)) continue;
+            size = (size_t)st.st_size;
+
+            size_t nn = strlen(name);
+            if (nrel + nn + 2 > rcap) {
+                char* r = realloc(relbuf, nrel + nn + 2);
+                if (r) { relbuf = r; rcap = nrel + nn + 2; }
+            }
+            if (!relbuf || nrel + nn + 2 > rcap) {
+                walk_error(w, rel, name, "archivo omitido", ENOMEM);
+                continue;
+            }
+            size_t k = 0;
+            if (nrel) { memcpy(relbuf, rel, nrel); k = nrel; relbuf[k++] = '/'; }
+            memcpy(relbuf + k, name, nn + 1);
+
+            atomic_fetch_add(&w->n_files, 1);
+            w->opt->on_file(relbuf, size, w->opt->ctx);
+        }
+    }
+
+    free(relbuf);
+    free(buf);
+    dir_ref_put(self);
+}
+
+static void walk_dir(void* arg) {
+    DirTask* t = (DirTask*)arg;
+    Walker* w = t->w;
+    list_dir(w, t);
+    free(t->rel);
+    free(t);
+    dir_done(w);
+}
+
+int walk_tree(const WalkOptions* opt, size_t* n_dirs, size_t* n_files) {
+    if (!opt || !opt->in_root || !opt->on_file) return -1;
+
+    Walker w;
+    w.opt = opt;
+    atomic_init(&w.n_dirs, 0);
+    atomic_init(&w.n_files, 0);
+    atomic_init(&w.n_errors, 0);
+
+    w.in_fd = open(opt->in_root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (w.in_fd < 0) return -1;
+
+    w.out_fd = -1;
+    if (opt->out_root) {
+        mkdir(opt->out_root, 0755);
+        w.out_fd = open(opt->out_root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (w.out_fd < 0) { close(w.in_fd); return -1; }
+    }
+
+    ThreadPool* own = opt->pool ? NULL : tp_create(opt->nthreads ? opt->nthreads : 1);
+    w.tp = opt->pool ? opt->pool : own;
+    if (!w.tp) {
+        close(w.in_fd);
+        if (w.out_fd >= 0) close(w.out_fd);
+        return -1;
+    }
+
+    pthread_mutex_init(&w.mtx, NULL);
+    pthread_cond_init(&w.cv, NULL);
+    w.pending = 0;
+
+    submit_dir(&w, NULL, "", "");
+
+    /* Las tareas encolan a sus hijos antes de terminar, así pending
+     * solo llega a 0 cuando no queda ningún directorio por listar. */
+    pthread_mutex_lock(&w.mtx);
+    while (w.pending) pthread_cond_wait(&w.cv, &w.mtx);
+    pthread_mutex_unlock(&w.mtx);
+    if (own) tp_destroy(own);
+    pthread_cond_destroy(&w.cv);
+    pthread_mutex_destroy(&w.mtx);
+
+    close(w.in_fd);
+    if (w.out_fd >= 0) close(w.out_fd);
+
+    if (n_dirs)  *n_dirs  = atomic_load(&w.n_dirs);
+    if (n_files) *n_files = atomic_load(&w.n_files);
+    size_t errs = atomic_load(&w.n_errors);
+    if (errs) fprintf(stderr, "walk: %zu entradas de %s no se pudieron recorrer\n", errs, opt->in_root);
+    return errs ? 1 : 0;
+}
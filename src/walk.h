@@ -0,0 +1,41 @@
+#ifndef WALK_H
+#define WALK_H
+
+#include <stddef.h>
+#include "thread_pool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Callback por cada archivo regular encontrado.
+ * - rel: ruta relativa a la raíz (ej: "sub/dir/a.txt"), válida solo durante la llamada.
+ * - size: tamaño en bytes.
+ * Se invoca desde los hilos del recorrido (puede ser concurrente).
+ */
+typedef void (*walk_file_fn)(const char* rel, size_t size, void* ctx);
+
+typedef struct {
+    const char* in_root;   /* carpeta a recorrer */
+    const char* out_root;  /* si no es NULL, se replica la estructura con mkdirat */
+    size_t nthreads;       /* hilos para listar subdirectorios en paralelo */
+    walk_file_fn on_file;
+    void* ctx;
+    ThreadPool* pool;      /* si no es NULL, los directorios se listan como
+                              tareas de prioridad 0 en este pool (nthreads
+                              no se usa): no suma hilos a los del llamador */
+} WalkOptions;
+
+/* Recorre in_root recursivamente y llama on_file por cada archivo apenas
+ * lo descubre. Bloquea hasta terminar el recorrido.
+ * Devuelve 0 si ok, 1 si se recorrió pero alguna carpeta o archivo no se
+ * pudo abrir, listar o leer (se avisa en stderr y no se entrega), -1 si
+ * no se pudo abrir la raíz (o la de salida).
+ * n_dirs / n_files (opcionales) reciben los totales encontrados. */
+int walk_tree(const WalkOptions* opt, size_t* n_dirs, size_t* n_files);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WALK_H */
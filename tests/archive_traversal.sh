@@ -0,0 +1,33 @@
+#!/bin/sh
+# Regresión: nombres de entrada peligrosos en un contenedor sólido.
+# Se arma un contenedor normal y se reescribe en el directorio el nombre
+# "zzzz.txt" por otro del mismo largo ("../z.txt", "/zzz.txt", ...).
+# La extracción debe fallar sin crear nada fuera de la carpeta de salida.
+# Uso: tests/archive_traversal.sh [ruta/a/gsea]
+set -eu
+GSEA=${1:-./gsea}
+T=$(mktemp -d)
+trap 'rm -rf "$T"' EXIT
+
+mkdir -p "$T/in" "$T/w"
+printf 'hola\n' > "$T/in/aaaa.txt"
+printf 'chau\n' > "$T/in/zzzz.txt"
+"$GSEA" -c --archive --comp-alg lzw -i "$T/in" -o "$T/ok.gsa" >/dev/null
+
+# Sin tocar, se extrae bien
+"$GSEA" -d -i "$T/ok.gsa" -o "$T/ok.out" >/dev/null
+cmp -s "$T/in/zzzz.txt" "$T/ok.out/zzzz.txt" || { echo "FALLO: contenedor intacto"; exit 1; }
+
+for bad in '../z.txt' 'zz/../zz' '/zzz.txt' 'zz//z.tx' 'zz\x00z.txt' './z.txt_'; do
+    LC_ALL=C sed "s#zzzz\.txt#$bad#" "$T/ok.gsa" > "$T/bad.gsa"
+    cmp -s "$T/ok.gsa" "$T/bad.gsa" && { echo "FALLO: no se pudo parchear '$bad'"; exit 1; }
+    if "$GSEA" -d -i "$T/bad.gsa" -o "$T/w/out" >/dev/null 2>&1; then
+        echo "FALLO: se aceptó la entrada '$bad'"; exit 1
+    fi
+    if "$GSEA" --extract "$bad" -i "$T/bad.gsa" -o "$T/w/one" >/dev/null 2>&1; then
+        echo "FALLO: --extract aceptó '$bad'"; exit 1
+    fi
+    [ ! -e "$T/w/z.txt" ] && [ ! -e "$T/z.txt" ] || { echo "FALLO: '$bad' escribió fuera de -o"; exit 1; }
+    rm -rf "$T/w/out" "$T/w/one"
+done
+echo "ok: nombres inseguros en contenedores"
@@ -0,0 +1,23 @@
+#!/bin/sh
+# Regresión: caso KwKwK del decodificador LZW.
+# "ab" x 50 hace que el codificador emita un código que el decodificador
+# todavía no tiene en su diccionario (code == next_code); antes la
+# secuencia salía con el byte repetido al principio y no al final.
+# Uso: tests/lzw_kwkwk.sh [ruta/a/gsea]
+set -eu
+GSEA=${1:-./gsea}
+T=$(mktemp -d)
+trap 'rm -rf "$T"' EXIT
+
+i=0
+while [ $i -lt 50 ]; do printf 'ab'; i=$((i + 1)); done > "$T/ab.txt"
+printf 'aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa' > "$T/aaa.txt"
+
+for f in ab aaa; do
+    for alg in lzw lzw-pred; do
+        "$GSEA" -c --comp-alg $alg -i "$T/$f.txt" -o "$T/$f.$alg" >/dev/null
+        "$GSEA" -d --comp-alg $alg -i "$T/$f.$alg" -o "$T/$f.$alg.out" >/dev/null
+        cmp -s "$T/$f.txt" "$T/$f.$alg.out" || { echo "FALLO: $f.txt con $alg"; exit 1; }
+    done
+done
+echo "ok: lzw KwKwK"